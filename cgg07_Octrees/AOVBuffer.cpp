@@ -0,0 +1,159 @@
+#include "AOVBuffer.h"
+#include "Surface3D.h"
+#include "Mathtools.h"
+
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+
+AOVBuffer::AOVBuffer(int width, int height, unsigned int passes) : width_(width), height_(height), passes_(passes)
+{
+	int pixels = width_ * height_;
+
+	if (hasPass(DEPTH))
+		depth_.resize(pixels);
+
+	if (hasPass(NORMAL))
+		normals_.resize(3 * pixels);
+
+	if (hasPass(OBJECT_ID))
+		objectIDs_.resize(pixels);
+
+	if (hasPass(TRIANGLE_ID))
+		triangleIDs_.resize(pixels);
+
+	if (hasPass(UV))
+		uvs_.resize(2 * pixels);
+
+	clear();
+}
+
+
+AOVBuffer::AOVBuffer(const AOVBuffer& src)
+{
+}
+
+
+AOVBuffer::~AOVBuffer()
+{
+}
+
+
+void AOVBuffer::clear()
+{
+	std::fill(depth_.begin(), depth_.end(), static_cast<float>(INFINITY));
+	std::fill(normals_.begin(), normals_.end(), 0.0f);
+	std::fill(objectIDs_.begin(), objectIDs_.end(), -1);
+	std::fill(triangleIDs_.begin(), triangleIDs_.end(), -1);
+	std::fill(uvs_.begin(), uvs_.end(), 0.0f);
+}
+
+
+void AOVBuffer::setHit(int x, int y, Surface3D* surface, Vector3D& point, double dist, int objectID, int triangleID)
+{
+	int pixel = Mathtools::pixelIndex(width_, y, x);
+
+	if (!depth_.empty())
+		depth_[pixel] = static_cast<float>(dist);
+
+	if (!normals_.empty())
+	{
+		Vector3D normal = surface->getVertexNormal(point);
+
+		normals_[3 * pixel] = static_cast<float>(normal.getX());
+		normals_[3 * pixel + 1] = static_cast<float>(normal.getY());
+		normals_[3 * pixel + 2] = static_cast<float>(normal.getZ());
+	}
+
+	if (!objectIDs_.empty())
+		objectIDs_[pixel] = objectID;
+
+	if (!triangleIDs_.empty())
+		triangleIDs_[pixel] = triangleID;
+
+	if (!uvs_.empty())
+	{
+		Vector2D uv = surface->getTexturePoint(point);
+
+		uvs_[2 * pixel] = static_cast<float>(uv.getX());
+		uvs_[2 * pixel + 1] = static_cast<float>(uv.getY());
+	}
+}
+
+
+unsigned int AOVBuffer::getPasses()
+{
+	return passes_;
+}
+
+
+bool AOVBuffer::hasPass(Pass pass)
+{
+	return (passes_ & pass) != 0;
+}
+
+
+int AOVBuffer::getWidth()
+{
+	return width_;
+}
+
+
+int AOVBuffer::getHeight()
+{
+	return height_;
+}
+
+
+float AOVBuffer::getDepth(int x, int y)
+{
+	return depth_.empty() ? static_cast<float>(INFINITY) : depth_[Mathtools::pixelIndex(width_, y, x)];
+}
+
+
+int AOVBuffer::getObjectID(int x, int y)
+{
+	return objectIDs_.empty() ? -1 : objectIDs_[Mathtools::pixelIndex(width_, y, x)];
+}
+
+
+int AOVBuffer::getTriangleID(int x, int y)
+{
+	return triangleIDs_.empty() ? -1 : triangleIDs_[Mathtools::pixelIndex(width_, y, x)];
+}
+
+
+unsigned long long AOVBuffer::getSize()
+{
+	return depth_.size() * sizeof(float) + normals_.size() * sizeof(float) + objectIDs_.size() * sizeof(int) +
+		triangleIDs_.size() * sizeof(int) + uvs_.size() * sizeof(float);
+}
+
+
+void AOVBuffer::save(const std::string& filename)
+{
+	std::ofstream of;
+	std::string name = filename + ".aov";
+
+	of.open(name.c_str(), std::ios::binary);
+
+	if (!of.is_open())
+	{
+		std::cout << "Error: Couldn't create file " << name << "\n";
+		return;
+	}
+
+	int header[3] = { width_, height_, static_cast<int>(passes_) };
+
+	of.write("AOV1", 4);
+	of.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	of.write(reinterpret_cast<const char*>(depth_.data()), depth_.size() * sizeof(float));
+	of.write(reinterpret_cast<const char*>(normals_.data()), normals_.size() * sizeof(float));
+	of.write(reinterpret_cast<const char*>(objectIDs_.data()), objectIDs_.size() * sizeof(int));
+	of.write(reinterpret_cast<const char*>(triangleIDs_.data()), triangleIDs_.size() * sizeof(int));
+	of.write(reinterpret_cast<const char*>(uvs_.data()), uvs_.size() * sizeof(float));
+
+	of.close();
+}
@@ -0,0 +1,70 @@
+#ifndef AOVBUFFER_H_
+#define AOVBUFFER_H_
+
+#include <string>
+#include <vector>
+
+class Surface3D;
+class Vector3D;
+
+/*
+AOVBuffer stores geometry passes (arbitrary output variables) of a rendering
+without any shading: depth, normals, object and triangle IDs and texture
+coordinates. Only the selected passes get memory.
+
+save() writes one binary file (little endian, row by row from the top):
+ - header: "AOV1", width and height (int32), selected passes (uint32)
+ - depth: float, distance along the primary ray (infinity = no hit)
+ - normal: 3 floats, interpolated vertex normal in view space (no normal map)
+ - object ID: int32, index in Scene3D::getObjectList() (-1 = no hit)
+ - triangle ID: int32, index in the object's triangle list (-1 = no hit)
+ - uv: 2 floats, texture coordinates
+Passes follow each other in this order, unselected ones are left out.
+*/
+
+class AOVBuffer
+{
+public:
+	enum Pass { DEPTH = 1, NORMAL = 2, OBJECT_ID = 4, TRIANGLE_ID = 8, UV = 16 };
+
+private:
+	int width_;
+	int height_;
+	unsigned int passes_;
+
+	std::vector<float> depth_;
+	std::vector<float> normals_;
+	std::vector<int> objectIDs_;
+	std::vector<int> triangleIDs_;
+	std::vector<float> uvs_;
+
+	AOVBuffer(const AOVBuffer& src);
+
+public:
+	AOVBuffer(int width, int height, unsigned int passes);
+	virtual ~AOVBuffer();
+
+	// no hit in every pixel
+	void clear();
+
+	// point: hit point on surface (view space), dist: along primary ray
+	void setHit(int x, int y, Surface3D* surface, Vector3D& point, double dist, int objectID, int triangleID);
+
+	unsigned int getPasses();
+	bool hasPass(Pass pass);
+
+	int getWidth();
+	int getHeight();
+
+	float getDepth(int x, int y);
+	int getObjectID(int x, int y);
+	int getTriangleID(int x, int y);
+
+	// bytes of all selected passes
+	unsigned long long getSize();
+
+	// automatically adds ".aov"
+	void save(const std::string& filename);
+};
+
+#endif
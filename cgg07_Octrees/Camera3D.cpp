@@ -202,6 +202,15 @@ TransformMatrix3D Camera3D::getProjectionMatrix()
 }
 
 
+ViewFrustum Camera3D::getViewFrustum(double margin)
+{
+	double aspect = static_cast<double>(sWidth_) / static_cast<double>(sHeight_);
+	double tanY = Mathtools::TAN(fov_ / 2.0);
+
+	return ViewFrustum(tanY * aspect, tanY, far_, margin);
+}
+
+
 TransformMatrix3D Camera3D::getScreenMatrix()
 {
 	TransformMatrix3D screen;
@@ -3,6 +3,7 @@
 
 #include "Vector3D.h"
 #include "TransformMatrix3D.h"
+#include "ViewFrustum.h"
 
 /*
 Camera with settings for 3D viewing
@@ -79,6 +80,10 @@ public:
 	TransformMatrix3D getLookatMatrix();
 	TransformMatrix3D getProjectionMatrix();
 	TransformMatrix3D getScreenMatrix();
+
+	// frustum of perspective rays starting at camera center (view space)
+	// margin widens the frustum in all directions (world units)
+	ViewFrustum getViewFrustum(double margin = 0.0);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,777 @@
+#include "CompressedMesh.h"
+#include "Object3D.h"
+#include "Surface3D.h"
+#include "Mathtools.h"
+#include "Ray.h"
+#include "MemoryBudget.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+unsigned int CompressedMesh::LEAF_SIZE = 8;
+unsigned int CompressedMesh::BLOCK_SIZE = 8;
+unsigned int CompressedMesh::CACHE_SIZE = 16384;
+
+
+CompressedMesh::CompressedMesh(Object3D* object, std::vector<Surface3D*>& triangles) : object_(object), pointCount_(0),
+triangleCount_(triangles.size()), blocks_((triangles.size() + BLOCK_SIZE - 1) / BLOCK_SIZE),
+blockUse_(blocks_.size()), frame_(0), decodedSize_(0), peakDecodedSize_(0)
+{
+	// shared points get one index
+	std::unordered_map<Vector3D*, unsigned int> pointIndex;
+	std::vector<Vector3D*> points;
+	std::vector<unsigned int> corners(3 * triangleCount_);
+
+	for (unsigned int t = 0; t < triangleCount_; t++)
+	{
+		Vector3D* p[3] = { triangles[t]->getP0(), triangles[t]->getP1(), triangles[t]->getP2() };
+
+		for (int c = 0; c < 3; c++)
+		{
+			auto it = pointIndex.find(p[c]);
+
+			if (it == pointIndex.end())
+			{
+				it = pointIndex.insert(std::make_pair(p[c], static_cast<unsigned int>(points.size()))).first;
+				points.push_back(p[c]);
+			}
+
+			corners[3 * t + c] = it->second;
+		}
+	}
+
+	pointCount_ = points.size();
+
+	// quantization box
+	double max[3];
+
+	for (int a = 0; a < 3; a++)
+	{
+		min_[a] = Mathtools::INF;
+		max[a] = -Mathtools::INF;
+	}
+
+	for (Vector3D* point : points)
+	{
+		double p[3] = { point->getX(), point->getY(), point->getZ() };
+
+		for (int a = 0; a < 3; a++)
+		{
+			min_[a] = Mathtools::min(min_[a], p[a]);
+			max[a] = Mathtools::max(max[a], p[a]);
+		}
+	}
+
+	for (int a = 0; a < 3; a++)
+		scale_[a] = pointCount_ > 0 ? (max[a] - min_[a]) / 65535.0 : 0.0;
+
+	// loaders often give each triangle its own points, merge equal positions
+	std::unordered_map<unsigned long long, unsigned int> positionIndex;
+	std::vector<unsigned int> merged(pointCount_);
+
+	for (unsigned int i = 0; i < pointCount_; i++)
+	{
+		double p[3] = { points[i]->getX(), points[i]->getY(), points[i]->getZ() };
+		unsigned short q[3];
+
+		for (int a = 0; a < 3; a++)
+		{
+			double value = scale_[a] > 0.0 ? floor((p[a] - min_[a]) / scale_[a] + 0.5) : 0.0;
+			q[a] = static_cast<unsigned short>(Mathtools::min(value, 65535.0));
+		}
+
+		unsigned long long key = (static_cast<unsigned long long>(q[0]) << 32) | (static_cast<unsigned long long>(q[1]) << 16) | q[2];
+		auto it = positionIndex.find(key);
+
+		if (it == positionIndex.end())
+		{
+			it = positionIndex.insert(std::make_pair(key, static_cast<unsigned int>(positions_.size() / 3))).first;
+			positions_.insert(positions_.end(), q, q + 3);
+		}
+
+		merged[i] = it->second;
+	}
+
+	positions_.shrink_to_fit();
+	pointCount_ = positions_.size() / 3;
+
+	for (unsigned int& corner : corners)
+		corner = merged[corner];
+
+	// range of texture coordinates
+	double uvMax[2] = { -Mathtools::INF, -Mathtools::INF };
+	uvMin_[0] = uvMin_[1] = Mathtools::INF;
+
+	for (Surface3D* triangle : triangles)
+	{
+		Vector2D* texturePoints[3] = { &triangle->getT0(), &triangle->getT1(), &triangle->getT2() };
+
+		for (int c = 0; c < 3; c++)
+		{
+			uvMin_[0] = Mathtools::min(uvMin_[0], texturePoints[c]->getX());
+			uvMin_[1] = Mathtools::min(uvMin_[1], texturePoints[c]->getY());
+			uvMax[0] = Mathtools::max(uvMax[0], texturePoints[c]->getX());
+			uvMax[1] = Mathtools::max(uvMax[1], texturePoints[c]->getY());
+		}
+	}
+
+	for (int a = 0; a < 2; a++)
+		uvScale_[a] = triangleCount_ > 0 ? (uvMax[a] - uvMin_[a]) / 65535.0 : 0.0;
+
+	// triangle boxes of decoded points, rounded outwards to float
+	std::vector<float> bounds(6 * triangleCount_);
+
+	for (unsigned int t = 0; t < triangleCount_; t++)
+	{
+		double p[3][3];
+
+		for (int c = 0; c < 3; c++)
+			decodePosition(corners[3 * t + c], p[c]);
+
+		for (int a = 0; a < 3; a++)
+		{
+			double low = Mathtools::min(p[0][a], Mathtools::min(p[1][a], p[2][a]));
+			double high = Mathtools::max(p[0][a], Mathtools::max(p[1][a], p[2][a]));
+
+			float lowF = static_cast<float>(low);
+			float highF = static_cast<float>(high);
+
+			bounds[6 * t + a] = lowF > low ? std::nextafter(lowF, -INFINITY) : lowF;
+			bounds[6 * t + 3 + a] = highF < high ? std::nextafter(highF, INFINITY) : highF;
+		}
+	}
+
+	std::vector<unsigned int> order(triangleCount_);
+
+	for (unsigned int t = 0; t < triangleCount_; t++)
+		order[t] = t;
+
+	if (triangleCount_ > 0)
+	{
+		buildNode(order, bounds, 0, triangleCount_);
+		nodes_.shrink_to_fit();
+	}
+
+	// triangle data in order of the hierarchy
+	if (pointCount_ <= 65536)
+		shortIndices_.resize(3 * triangleCount_);
+	else
+		indices_.resize(3 * triangleCount_);
+
+	normals_.resize(6 * triangleCount_);
+	texturePoints_.resize(6 * triangleCount_);
+	styleIndex_.resize(triangleCount_);
+
+	for (unsigned int t = 0; t < triangleCount_; t++)
+	{
+		Surface3D* triangle = triangles[order[t]];
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int index = corners[3 * order[t] + c];
+
+			if (shortIndices_.empty())
+				indices_[3 * t + c] = index;
+			else
+				shortIndices_[3 * t + c] = static_cast<unsigned short>(index);
+		}
+
+		Vector3D* normals[3] = { &triangle->getN0(), &triangle->getN1(), &triangle->getN2() };
+		Vector2D* texturePoints[3] = { &triangle->getT0(), &triangle->getT1(), &triangle->getT2() };
+
+		for (int c = 0; c < 3; c++)
+		{
+			Mathtools::octahedralEncode(*normals[c], &normals_[6 * t + 2 * c], &normals_[6 * t + 2 * c + 1]);
+
+			double uv[2] = { texturePoints[c]->getX(), texturePoints[c]->getY() };
+
+			for (int a = 0; a < 2; a++)
+			{
+				double q = uvScale_[a] > 0.0 ? floor((uv[a] - uvMin_[a]) / uvScale_[a] + 0.5) : 0.0;
+				texturePoints_[6 * t + 2 * c + a] = static_cast<unsigned short>(Mathtools::min(q, 65535.0));
+			}
+		}
+
+		// usually one style per object
+		Style style = { triangle->getMaterial(), triangle->getTexture(), triangle->getNormalMap() };
+		unsigned int s = 0;
+
+		while (s < styles_.size() && (styles_[s].material != style.material || styles_[s].texture != style.texture || styles_[s].normalMap != style.normalMap))
+			s++;
+
+		if (s == styles_.size())
+			styles_.push_back(style);
+
+		styleIndex_[t] = static_cast<unsigned short>(s);
+	}
+
+	for (unsigned int b = 0; b < blocks_.size(); b++)
+	{
+		blocks_[b].store(0);
+		blockUse_[b].store(0);
+	}
+}
+
+
+CompressedMesh::CompressedMesh(const CompressedMesh& src)
+{
+}
+
+
+CompressedMesh::~CompressedMesh()
+{
+	for (unsigned int b = 0; b < blocks_.size(); b++)
+		deleteBlock(b);
+
+	for (std::pair<const unsigned int, Vector3D*>& point : points_)
+		delete point.second;
+
+	addDecodedSize(-static_cast<long long>(points_.size() * (sizeof(Vector3D) + 2 * sizeof(void*) + sizeof(unsigned int))));
+}
+
+
+void CompressedMesh::setCacheSize(unsigned int triangles)
+{
+	CACHE_SIZE = triangles;
+}
+
+
+unsigned int CompressedMesh::buildNode(std::vector<unsigned int>& order, std::vector<float>& bounds, unsigned int first, unsigned int count)
+{
+	unsigned int index = nodes_.size();
+	nodes_.push_back(Node());
+
+	float low[3] = { INFINITY, INFINITY, INFINITY };
+	float high[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			low[a] = std::min(low[a], bounds[6 * order[i] + a]);
+			high[a] = std::max(high[a], bounds[6 * order[i] + 3 + a]);
+		}
+	}
+
+	for (int a = 0; a < 3; a++)
+	{
+		nodes_[index].min[a] = low[a];
+		nodes_[index].max[a] = high[a];
+	}
+
+	if (count <= LEAF_SIZE)
+	{
+		nodes_[index].first = first;
+		nodes_[index].count = count;
+		return index;
+	}
+
+	// split at median of triangle centers along longest axis
+	int axis = 0;
+
+	for (int a = 1; a < 3; a++)
+	{
+		if (high[a] - low[a] > high[axis] - low[axis])
+			axis = a;
+	}
+
+	unsigned int middle = first + count / 2;
+
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+		[&](unsigned int a, unsigned int b)
+		{
+			return bounds[6 * a + axis] + bounds[6 * a + 3 + axis] < bounds[6 * b + axis] + bounds[6 * b + 3 + axis];
+		});
+
+	buildNode(order, bounds, first, middle - first);
+	unsigned int second = buildNode(order, bounds, middle, first + count - middle);
+
+	nodes_[index].first = second;
+	nodes_[index].count = 0;
+
+	return index;
+}
+
+
+unsigned int CompressedMesh::getIndex(unsigned int triangle, int corner)
+{
+	if (shortIndices_.empty())
+		return indices_[3 * triangle + corner];
+
+	return shortIndices_[3 * triangle + corner];
+}
+
+
+void CompressedMesh::decodePosition(unsigned int point, double* p)
+{
+	for (int a = 0; a < 3; a++)
+		p[a] = min_[a] + positions_[3 * point + a] * scale_[a];
+}
+
+
+bool CompressedMesh::intersectTriangle(unsigned int triangle, double* start, double* dir, double* dist)
+{
+	double p0[3], p1[3], p2[3];
+
+	decodePosition(getIndex(triangle, 0), p0);
+	decodePosition(getIndex(triangle, 1), p1);
+	decodePosition(getIndex(triangle, 2), p2);
+
+	// same test as Surface3D::intersection (Moeller-Trumbore)
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+	double p[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+	double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+
+	if (det > -Mathtools::EPSILON && det < Mathtools::EPSILON)
+		return false;
+
+	double invDet = 1.0 / det;
+
+	double T[3] = { start[0] - p0[0], start[1] - p0[1], start[2] - p0[2] };
+	double u = (T[0] * p[0] + T[1] * p[1] + T[2] * p[2]) * invDet;
+
+	if (u < 0.0 || u > 1.0)
+		return false;
+
+	double Q[3] = { T[1] * e1[2] - T[2] * e1[1], T[2] * e1[0] - T[0] * e1[2], T[0] * e1[1] - T[1] * e1[0] };
+	double v = (dir[0] * Q[0] + dir[1] * Q[1] + dir[2] * Q[2]) * invDet;
+
+	if (v < 0.0 || (u + v) > 1.0)
+		return false;
+
+	double t = (e2[0] * Q[0] + e2[1] * Q[1] + e2[2] * Q[2]) * invDet;
+
+	if (t > Mathtools::EPSILON && t < *dist)
+	{
+		*dist = t;
+		return true;
+	}
+
+	return false;
+}
+
+
+// slab test, entry: distance where ray enters the box
+static bool rayNodeIntersection(const float* min, const float* max, double* start, double* invDir, double maxDist, double* entry)
+{
+	double near = 0.0;
+	double far = maxDist;
+
+	for (int a = 0; a < 3; a++)
+	{
+		double t1 = (min[a] - start[a]) * invDir[a];
+		double t2 = (max[a] - start[a]) * invDir[a];
+
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		near = t1 > near ? t1 : near;
+		far = t2 < far ? t2 : far;
+
+		if (near > far)
+			return false;
+	}
+
+	*entry = near;
+	return true;
+}
+
+
+Surface3D* CompressedMesh::intersect(Ray& ray, double* dist, bool anyHit)
+{
+	if (nodes_.empty())
+		return 0;
+
+	// ray into space of compression, direction without translation
+	Vector3D rayStart = ray.getStart();
+	Vector3D rayDir = ray.getDirection();
+
+	double start[3], dir[3], invDir[3];
+
+	for (int r = 0; r < 3; r++)
+	{
+		start[r] = inverse_.at(r, 0) * rayStart.getX() + inverse_.at(r, 1) * rayStart.getY() + inverse_.at(r, 2) * rayStart.getZ() + inverse_.at(r, 3);
+		dir[r] = inverse_.at(r, 0) * rayDir.getX() + inverse_.at(r, 1) * rayDir.getY() + inverse_.at(r, 2) * rayDir.getZ();
+		invDir[r] = 1.0 / dir[r];
+	}
+
+	// node and entry distance, closer child is taken first
+	unsigned int stack[64];
+	double stackEntry[64];
+	int top = 0;
+
+	double entry;
+
+	if (!rayNodeIntersection(nodes_[0].min, nodes_[0].max, start, invDir, *dist, &entry))
+		return 0;
+
+	stack[top] = 0;
+	stackEntry[top++] = entry;
+
+	unsigned int hit = triangleCount_;
+
+	while (top > 0)
+	{
+		top--;
+
+		// a closer hit was found after pushing this node
+		if (stackEntry[top] > *dist)
+			continue;
+
+		Node& node = nodes_[stack[top]];
+
+		if (node.count > 0)
+		{
+			for (unsigned int t = node.first; t < node.first + node.count; t++)
+			{
+				if (intersectTriangle(t, start, dir, dist))
+				{
+					hit = t;
+
+					if (anyHit)
+						return getSurface(hit);
+				}
+			}
+
+			continue;
+		}
+
+		unsigned int first = stack[top] + 1;
+		unsigned int second = node.first;
+
+		double firstEntry, secondEntry;
+		bool firstHit = rayNodeIntersection(nodes_[first].min, nodes_[first].max, start, invDir, *dist, &firstEntry);
+		bool secondHit = rayNodeIntersection(nodes_[second].min, nodes_[second].max, start, invDir, *dist, &secondEntry);
+
+		if (firstHit && secondHit && secondEntry < firstEntry)
+		{
+			std::swap(first, second);
+			std::swap(firstEntry, secondEntry);
+		}
+
+		// push farther child first
+		if (firstHit && secondHit)
+		{
+			stack[top] = second;
+			stackEntry[top++] = secondEntry;
+		}
+
+		if (firstHit || secondHit)
+		{
+			stack[top] = firstHit ? first : second;
+			stackEntry[top++] = firstHit ? firstEntry : secondEntry;
+		}
+	}
+
+	return hit < triangleCount_ ? getSurface(hit) : 0;
+}
+
+
+void CompressedMesh::decodePoint(unsigned int point, Vector3D& result)
+{
+	double p[3];
+	decodePosition(point, p);
+
+	Vector3D position(p[0], p[1], p[2]);
+	result.setVector(transform_ * position);
+}
+
+
+void CompressedMesh::decodeAttributes(unsigned int triangle, Surface3D* surface)
+{
+	Style& style = styles_[styleIndex_[triangle]];
+
+	Vector3D normals[3];
+	Vector2D texturePoints[3];
+
+	for (int c = 0; c < 3; c++)
+	{
+		normals[c] = Mathtools::octahedralDecode(normals_[6 * triangle + 2 * c], normals_[6 * triangle + 2 * c + 1]);
+
+		texturePoints[c].setVector(uvMin_[0] + texturePoints_[6 * triangle + 2 * c] * uvScale_[0],
+			uvMin_[1] + texturePoints_[6 * triangle + 2 * c + 1] * uvScale_[1]);
+	}
+
+	surface->setNormalVectors(normals[0], normals[1], normals[2]);
+	surface->transformNormals(transform_);
+	surface->setTextureAnchorPoints(texturePoints[0], texturePoints[1], texturePoints[2]);
+	surface->setObject(object_);
+	surface->setIndex(triangle);
+
+	if (style.normalMap)
+		surface->linkNormalMap(style.normalMap);
+}
+
+
+CompressedMesh::Block* CompressedMesh::decodeBlock(unsigned int block)
+{
+	unsigned int first = block * BLOCK_SIZE;
+	unsigned int count = std::min(BLOCK_SIZE, triangleCount_ - first);
+
+	// at most 3 points per triangle
+	MemoryBudget::makeRoom(sizeof(Block) + count * (sizeof(Surface3D) + sizeof(Surface3D*) + 3 * sizeof(Vector3D)), "decoding triangles");
+
+	// neighbours share most of their points, decode each once
+	std::vector<unsigned int> pointIndex;
+	std::vector<unsigned int> corners(3 * count);
+
+	for (unsigned int i = 0; i < 3 * count; i++)
+	{
+		unsigned int index = getIndex(first + i / 3, i % 3);
+		unsigned int p = 0;
+
+		while (p < pointIndex.size() && pointIndex[p] != index)
+			p++;
+
+		if (p == pointIndex.size())
+			pointIndex.push_back(index);
+
+		corners[i] = p;
+	}
+
+	Block* decoded = new Block();
+	decoded->points.resize(pointIndex.size());
+	decoded->surfaces.resize(count);
+
+	for (unsigned int p = 0; p < pointIndex.size(); p++)
+		decodePoint(pointIndex[p], decoded->points[p]);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Style& style = styles_[styleIndex_[first + i]];
+		Vector3D* points = decoded->points.data();
+
+		decoded->surfaces[i] = new Surface3D(&points[corners[3 * i]], &points[corners[3 * i + 1]], &points[corners[3 * i + 2]], style.material, style.texture);
+		decodeAttributes(first + i, decoded->surfaces[i]);
+	}
+
+	addDecodedSize(sizeof(Block) + count * (sizeof(Surface3D) + sizeof(Surface3D*)) + pointIndex.size() * sizeof(Vector3D));
+
+	return decoded;
+}
+
+
+void CompressedMesh::deleteBlock(unsigned int block)
+{
+	Block* decoded = blocks_[block].load();
+
+	if (!decoded)
+		return;
+
+	for (Surface3D* surface : decoded->surfaces)
+		delete surface;
+
+	addDecodedSize(-static_cast<long long>(sizeof(Block) + decoded->surfaces.size() * (sizeof(Surface3D) + sizeof(Surface3D*)) + decoded->points.size() * sizeof(Vector3D)));
+
+	delete decoded;
+	blocks_[block].store(0);
+}
+
+
+void CompressedMesh::addDecodedSize(long long bytes)
+{
+	unsigned long long size = decodedSize_ += bytes;
+
+	if (size > peakDecodedSize_)
+		peakDecodedSize_ = size;
+
+	if (bytes > 0)
+		MemoryBudget::allocate(MemoryBudget::GEOMETRY, bytes);
+	else
+		MemoryBudget::release(MemoryBudget::GEOMETRY, -bytes);
+}
+
+
+Surface3D* CompressedMesh::getSurface(unsigned int index)
+{
+	unsigned int b = index / BLOCK_SIZE;
+	Block* block = blocks_[b].load(std::memory_order_acquire);
+
+	if (!block)
+	{
+		// several threads may hit the same block, decode it only once
+		std::lock_guard<std::mutex> lock(decodeMutex_);
+
+		block = blocks_[b].load(std::memory_order_relaxed);
+
+		if (!block)
+		{
+			block = decodeBlock(b);
+			blocks_[b].store(block, std::memory_order_release);
+		}
+	}
+
+	// written once per frame, trim() keeps recently used blocks
+	if (blockUse_[b].load(std::memory_order_relaxed) != frame_)
+		blockUse_[b].store(frame_, std::memory_order_relaxed);
+
+	return block->surfaces[index - b * BLOCK_SIZE];
+}
+
+
+Vector3D* CompressedMesh::getPoint(unsigned int index)
+{
+	std::lock_guard<std::mutex> lock(decodeMutex_);
+
+	Vector3D*& decoded = points_[index];
+
+	if (!decoded)
+	{
+		decoded = new Vector3D();
+		decodePoint(index, *decoded);
+
+		// point and map entry (roughly)
+		addDecodedSize(sizeof(Vector3D) + 2 * sizeof(void*) + sizeof(unsigned int));
+	}
+
+	return decoded;
+}
+
+
+bool CompressedMesh::visit(std::function<bool(unsigned int, Surface3D*)> visitor)
+{
+	for (unsigned int t = 0; t < triangleCount_; t++)
+	{
+		Vector3D points[3];
+
+		for (int c = 0; c < 3; c++)
+			decodePoint(getIndex(t, c), points[c]);
+
+		Style& style = styles_[styleIndex_[t]];
+
+		Surface3D surface(&points[0], &points[1], &points[2], style.material, style.texture);
+		decodeAttributes(t, &surface);
+
+		if (!visitor(t, &surface))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool CompressedMesh::trim()
+{
+	bool evicted = !points_.empty();
+
+	for (std::pair<const unsigned int, Vector3D*>& point : points_)
+		delete point.second;
+
+	if (evicted)
+		addDecodedSize(-static_cast<long long>(points_.size() * (sizeof(Vector3D) + 2 * sizeof(void*) + sizeof(unsigned int))));
+
+	points_.clear();
+
+	// decoded blocks, least recently used first
+	std::vector< std::pair<unsigned int, unsigned int> > decoded;
+
+	for (unsigned int b = 0; b < blocks_.size(); b++)
+	{
+		if (blocks_[b].load())
+			decoded.push_back(std::make_pair(blockUse_[b].load(), b));
+	}
+
+	unsigned int maxBlocks = CACHE_SIZE / BLOCK_SIZE;
+
+	// over budget: evict all, the next frame decodes the blocks it needs again
+	bool overBudget = !decoded.empty() && MemoryBudget::isExceeded();
+
+	if (overBudget)
+		maxBlocks = 0;
+
+	if (decoded.size() > maxBlocks)
+	{
+		std::sort(decoded.begin(), decoded.end());
+
+		for (unsigned int i = 0; i < decoded.size() - maxBlocks; i++)
+			deleteBlock(decoded[i].second);
+
+		evicted = true;
+	}
+
+	if (overBudget)
+	{
+		std::ostringstream action;
+		action << "evicted " << decoded.size() << " blocks of decoded triangles";
+		MemoryBudget::log(action.str(), "trimming compressed meshes");
+	}
+
+	frame_++;
+
+	return evicted;
+}
+
+
+unsigned int CompressedMesh::getTriangleSize()
+{
+	return triangleCount_;
+}
+
+
+unsigned int CompressedMesh::getPointSize()
+{
+	return pointCount_;
+}
+
+
+void CompressedMesh::transform(TransformMatrix3D& matrix)
+{
+	transform_ = matrix * transform_;
+
+	inverse_ = transform_;
+	inverse_.inverse();
+
+	// decoded triangles move like the ones of an uncompressed object
+	for (std::pair<const unsigned int, Vector3D*>& point : points_)
+		point.second->setVector(matrix * (*point.second));
+
+	for (unsigned int b = 0; b < blocks_.size(); b++)
+	{
+		Block* block = blocks_[b].load();
+
+		if (!block)
+			continue;
+
+		for (Vector3D& point : block->points)
+			point.setVector(matrix * point);
+
+		for (Surface3D* surface : block->surfaces)
+			surface->transformNormals(matrix);
+	}
+}
+
+
+unsigned long long CompressedMesh::getMemorySize()
+{
+	unsigned long long size = sizeof(CompressedMesh);
+
+	size += positions_.capacity() * sizeof(unsigned short);
+	size += shortIndices_.capacity() * sizeof(unsigned short);
+	size += indices_.capacity() * sizeof(unsigned int);
+	size += normals_.capacity() * sizeof(short);
+	size += texturePoints_.capacity() * sizeof(unsigned short);
+	size += styleIndex_.capacity() * sizeof(unsigned short);
+	size += styles_.capacity() * sizeof(Style);
+	size += nodes_.capacity() * sizeof(Node);
+
+	// table of decoded blocks and their last use
+	size += blocks_.size() * (sizeof(Block*) + sizeof(unsigned int));
+
+	return size;
+}
+
+
+unsigned long long CompressedMesh::getDecodedMemorySize()
+{
+	return decodedSize_;
+}
+
+
+unsigned long long CompressedMesh::getPeakDecodedMemorySize()
+{
+	return peakDecodedSize_;
+}
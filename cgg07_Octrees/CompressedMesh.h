@@ -0,0 +1,196 @@
+#ifndef COMPRESSEDMESH_H_
+#define COMPRESSEDMESH_H_
+
+#include "TransformMatrix3D.h"
+
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+class Object3D;
+class Surface3D;
+class Vector3D;
+class Material;
+class Texture;
+class Ray;
+
+/*
+CompressedMesh is a compact, read only copy of an Object3D's triangles
+
+ - points: 16 bit per axis, relative to the bounding box at compression
+   (points with the same quantized position are stored once)
+ - indices: 16 bit per corner (32 bit if there are more than 65536 points)
+ - normals: octahedral encoding, 2 x 16 bit per corner
+ - texture coordinates: 16 bit per axis, relative to the range of all
+   texture coordinates (half floats are too coarse for large normal maps)
+ - material, texture and normal map: 16 bit index into a table of styles
+
+A bounding volume hierarchy with float boxes replaces the octree. Later
+transformations are collected in one matrix: rays are transformed into the
+space of compression and points are decoded inside of the triangle test.
+Distances along the transformed ray are used as they are, so transformations
+after compression must be rigid (rotations and translations, like the
+camera's lookat matrix). Scale an object before compressing it.
+
+Renderers work with Surface3D pointers. A triangle is decoded into a Surface3D
+(in current space) the first time it is requested, i.e. hit by a ray.
+Triangles are decoded in blocks of neighbours with their own points, only
+those blocks cost full memory. The cache of decoded blocks is bounded
+(setCacheSize): trim() evicts the blocks which were used longest ago. Pointers
+to evicted triangles become invalid, so trim() is only called at the start of
+a frame (Scene3D::trimDecoded), never while rendering.
+
+Decoded triangles count as geometry in the MemoryBudget. Decoding a block
+makes room first (evicts textures), trim() evicts all blocks if the budget is
+exceeded.
+
+visit() decodes one triangle after another into a temporary Surface3D, for
+callers which look at every triangle once (rasterizer, queries). Nothing is
+cached, so the pointer is only valid inside of the visitor.
+*/
+
+class CompressedMesh
+{
+private:
+	// max triangles per leaf of the hierarchy
+	static unsigned int LEAF_SIZE;
+
+	// triangles decoded together
+	static unsigned int BLOCK_SIZE;
+
+	// max decoded triangles kept by trim()
+	static unsigned int CACHE_SIZE;
+
+	// leaf (count > 0): triangles first to first + count - 1
+	// inner node: first child follows directly, second child at index "first"
+	struct Node
+	{
+		float min[3];
+		float max[3];
+		unsigned int first;
+		unsigned int count;
+	};
+
+	// material, texture and normal map shared by many triangles
+	struct Style
+	{
+		Material* material;
+		Texture* texture;
+		Texture* normalMap;
+	};
+
+	Object3D* object_;
+
+	// quantization: point = min + q * scale
+	double min_[3];
+	double scale_[3];
+
+	// texture coordinate = uvMin + q * uvScale
+	double uvMin_[2];
+	double uvScale_[2];
+
+	unsigned int pointCount_;
+	unsigned int triangleCount_;
+
+	std::vector<unsigned short> positions_;
+	std::vector<unsigned short> shortIndices_;
+	std::vector<unsigned int> indices_;
+	std::vector<short> normals_;
+	std::vector<unsigned short> texturePoints_;
+	std::vector<unsigned short> styleIndex_;
+	std::vector<Style> styles_;
+	std::vector<Node> nodes_;
+
+	// space of compression -> current space and back
+	TransformMatrix3D transform_;
+	TransformMatrix3D inverse_;
+
+	// decoded triangles and their points (shared inside of the block)
+	// points are reserved once, surfaces point into them
+	struct Block
+	{
+		std::vector<Surface3D*> surfaces;
+		std::vector<Vector3D> points;
+	};
+
+	// decoded on first request, frame of last request (see trim)
+	std::vector< std::atomic<Block*> > blocks_;
+	std::vector< std::atomic<unsigned int> > blockUse_;
+	unsigned int frame_;
+
+	// points requested by getPoint, kept until next trim()
+	std::unordered_map<unsigned int, Vector3D*> points_;
+	std::mutex decodeMutex_;
+
+	// bytes of decoded blocks and points, now and at most since construction
+	std::atomic<unsigned long long> decodedSize_;
+	unsigned long long peakDecodedSize_;
+
+	CompressedMesh(const CompressedMesh& src);
+
+	unsigned int getIndex(unsigned int triangle, int corner);
+
+	// point in space of compression
+	void decodePosition(unsigned int point, double* p);
+
+	// sort triangles (indices into order) into a subtree, returns node index
+	unsigned int buildNode(std::vector<unsigned int>& order, std::vector<float>& bounds, unsigned int first, unsigned int count);
+
+	// ray in space of compression
+	bool intersectTriangle(unsigned int triangle, double* start, double* dir, double* dist);
+
+	// point in current space
+	void decodePoint(unsigned int point, Vector3D& result);
+
+	// normals, texture coordinates, object and normal map of surface
+	void decodeAttributes(unsigned int triangle, Surface3D* surface);
+
+	// caller holds decodeMutex_
+	Block* decodeBlock(unsigned int block);
+	void deleteBlock(unsigned int block);
+
+	// decoded size and MemoryBudget
+	void addDecodedSize(long long bytes);
+
+public:
+	// triangles' points must belong to object (shared points are stored once)
+	CompressedMesh(Object3D* object, std::vector<Surface3D*>& triangles);
+	virtual ~CompressedMesh();
+
+	// triangles per mesh kept decoded after trim()
+	static void setCacheSize(unsigned int triangles);
+
+	unsigned int getTriangleSize();
+	unsigned int getPointSize();
+
+	// closest triangle hit closer than dist, saves new distance (NULL = no hit)
+	// anyHit: stop at first triangle closer than dist
+	Surface3D* intersect(Ray& ray, double* dist, bool anyHit = false);
+
+	// decoded triangle or point (order is not the one of the original object)
+	// valid until the next trim()
+	Surface3D* getSurface(unsigned int index);
+	Vector3D* getPoint(unsigned int index);
+
+	// visitor(index, triangle) for each triangle until it returns false
+	// triangle is temporary, getSurface(index) keeps it
+	bool visit(std::function<bool(unsigned int, Surface3D*)> visitor);
+
+	// evict blocks used longest ago until the cache fits, and all points of getPoint
+	// only call it while no decoded triangle is used, returns true if anything was evicted
+	bool trim();
+
+	// matrix must be rigid (rotation, translation), see above
+	void transform(TransformMatrix3D& matrix);
+
+	// bytes of compressed data and hierarchy (without decoded triangles)
+	unsigned long long getMemorySize();
+
+	// bytes of triangles and points decoded right now, and at most so far
+	unsigned long long getDecodedMemorySize();
+	unsigned long long getPeakDecodedMemorySize();
+};
+
+#endif
@@ -73,8 +73,8 @@ void Cube3D::initialize()
 	*/
 
 	// top---------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[0], points_[1], points_[2]));
-	triangles_.push_back(new Surface3D(points_[0], points_[2], points_[3]));
+	addTriangle(new Surface3D(points_[0], points_[1], points_[2]));
+	addTriangle(new Surface3D(points_[0], points_[2], points_[3]));
 
 	rect[0].setVector(0.25, 2.0 / 3.0);
 	rect[1].setVector(0.25, 1.0);
@@ -87,13 +87,11 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[1], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[2], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[3], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	// bottom------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[4], points_[6], points_[5]));
-	triangles_.push_back(new Surface3D(points_[4], points_[7], points_[6]));
+	addTriangle(new Surface3D(points_[4], points_[6], points_[5]));
+	addTriangle(new Surface3D(points_[4], points_[7], points_[6]));
 
 	rect[0].setVector(0.25, 0.0);
 	rect[1].setVector(0.25, 1.0 / 3.0);
@@ -106,13 +104,11 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[4], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[7], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[6], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	// front-------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[0], points_[3], points_[4]));
-	triangles_.push_back(new Surface3D(points_[3], points_[7], points_[4]));
+	addTriangle(new Surface3D(points_[0], points_[3], points_[4]));
+	addTriangle(new Surface3D(points_[3], points_[7], points_[4]));
 
 	rect[0].setVector(0.25, 1.0 / 3.0);
 	rect[1].setVector(0.25, 2.0 / 3.0);
@@ -125,13 +121,11 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[0], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[3], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[7], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	// back--------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[1], points_[5], points_[2]));
-	triangles_.push_back(new Surface3D(points_[5], points_[6], points_[2]));
+	addTriangle(new Surface3D(points_[1], points_[5], points_[2]));
+	addTriangle(new Surface3D(points_[5], points_[6], points_[2]));
 
 	rect[0].setVector(0.75, 1.0 / 3.0);
 	rect[1].setVector(0.75, 2.0 / 3.0);
@@ -144,13 +138,11 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[2], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[1], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[5], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	// left--------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[4], points_[5], points_[0]));
-	triangles_.push_back(new Surface3D(points_[5], points_[1], points_[0]));
+	addTriangle(new Surface3D(points_[4], points_[5], points_[0]));
+	addTriangle(new Surface3D(points_[5], points_[1], points_[0]));
 
 	rect[0].setVector(0.0, 1.0 / 3.0);
 	rect[1].setVector(0.0, 2.0 / 3.0);
@@ -163,13 +155,11 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[1], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[0], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[4], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	// right-------------------------------------------------------------------
-	triangles_.push_back(new Surface3D(points_[3], points_[6], points_[7]));
-	triangles_.push_back(new Surface3D(points_[3], points_[2], points_[6]));
+	addTriangle(new Surface3D(points_[3], points_[6], points_[7]));
+	addTriangle(new Surface3D(points_[3], points_[2], points_[6]));
 
 	rect[0].setVector(0.5, 1.0 / 3.0);
 	rect[1].setVector(0.5, 2.0 / 3.0);
@@ -182,8 +172,6 @@ void Cube3D::initialize()
 		triangles_[i]->assignTexturePointToObjectPoint(points_[3], rect[1]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[2], rect[2]);
 		triangles_[i]->assignTexturePointToObjectPoint(points_[6], rect[3]);
-
-		triangles_[i]->setObject(this);
 	}
 
 	assignMaterialToSurfaces();
@@ -0,0 +1,317 @@
+#include "Denoiser.h"
+#include "Vector3D.h"
+#include "Mathtools.h"
+#include "WorkerPool.h"
+
+#include <cmath>
+
+// albedo below this is treated as black (no division by 0)
+static const float ALBEDO_MIN = 0.01f;
+
+// variance of a noise free pixel, still allows a little blur
+static const float VARIANCE_MIN = 1e-4f;
+
+// rows per WorkerPool job
+static const int ROWS_PER_JOB = 8;
+
+// B3 spline: weights of the 5 taps in each direction
+static const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+
+// falloff like exp(-x) for small x, but without exp() call (x >= 0)
+static inline float falloff(float x)
+{
+	return 1.0f / (1.0f + x + 0.5f * x * x);
+}
+
+
+Denoiser::Denoiser(int width, int height) : width_(width), height_(height),
+iterations_(5), colorSigma_(8.0f), normalSigma_(0.3f), depthSigma_(0.02f)
+{
+	unsigned int size = width * height;
+
+	for (int c = 0; c < 3; c++)
+	{
+		color_[c].assign(size, 0.0f);
+		filtered_[c].assign(size, 0.0f);
+		albedo_[c].assign(size, 1.0f);
+		normal_[c].assign(size, 0.0f);
+	}
+
+	depth_.assign(size, 0.0f);
+	variance_.assign(size, 0.0f);
+	filteredVariance_.assign(size, 0.0f);
+}
+
+
+Denoiser::Denoiser(const Denoiser& src)
+{
+}
+
+
+Denoiser::~Denoiser()
+{
+}
+
+
+void Denoiser::setIterations(unsigned int iterations)
+{
+	iterations_ = iterations;
+}
+
+
+void Denoiser::setColorSigma(float sigma)
+{
+	colorSigma_ = sigma;
+}
+
+
+void Denoiser::setNormalSigma(float sigma)
+{
+	normalSigma_ = sigma;
+}
+
+
+void Denoiser::setDepthSigma(float sigma)
+{
+	depthSigma_ = sigma;
+}
+
+
+void Denoiser::setPixel(int x, int y, double rgb[3], double variance, double depth, Vector3D& normal, double albedo[3])
+{
+	int index = Mathtools::pixelIndex(width_, y, x);
+
+	for (int c = 0; c < 3; c++)
+	{
+		// filter lighting only, albedo is multiplied back in getPixel()
+		float a = static_cast<float>(albedo[c]);
+
+		albedo_[c][index] = a > ALBEDO_MIN ? a : 0.0f;
+		color_[c][index] = static_cast<float>(a > ALBEDO_MIN ? rgb[c] / a : rgb[c]);
+	}
+
+	// variance of lighting only
+	double luminance = 0.2126 * albedo_[0][index] + 0.7152 * albedo_[1][index] + 0.0722 * albedo_[2][index];
+
+	if (luminance > ALBEDO_MIN)
+		variance /= luminance * luminance;
+
+	variance_[index] = static_cast<float>(variance);
+
+	normal_[0][index] = static_cast<float>(normal.getX());
+	normal_[1][index] = static_cast<float>(normal.getY());
+	normal_[2][index] = static_cast<float>(normal.getZ());
+
+	depth_[index] = static_cast<float>(depth);
+}
+
+
+void Denoiser::getPixel(int x, int y, double rgb[3])
+{
+	int index = Mathtools::pixelIndex(width_, y, x);
+
+	for (int c = 0; c < 3; c++)
+	{
+		float a = albedo_[c][index];
+
+		rgb[c] = a > 0.0f ? color_[c][index] * a : color_[c][index];
+	}
+}
+
+
+// plain loop over float arrays, vectorized by the compiler
+void Denoiser::tapWeights(GuideRow p, GuideRow q, float* __restrict w, int n, float kernel, float colorSigma2, float normalScale, float depthScale)
+{
+	for (int x = 0; x < n; x++)
+	{
+		float dr = p.r[x] - q.r[x];
+		float dg = p.g[x] - q.g[x];
+		float db = p.b[x] - q.b[x];
+
+		float nx = p.nx[x] - q.nx[x];
+		float ny = p.ny[x] - q.ny[x];
+		float nz = p.nz[x] - q.nz[x];
+
+		float dz = std::fabs(p.z[x] - q.z[x]) / (p.z[x] + 1e-6f);
+
+		float colorDist = (dr * dr + dg * dg + db * db) / (colorSigma2 * p.variance[x] + VARIANCE_MIN);
+		float normalDist = (nx * nx + ny * ny + nz * nz) * normalScale;
+		float depthDist = dz * depthScale;
+
+		w[x] = kernel * falloff(colorDist + normalDist + depthDist);
+	}
+}
+
+
+// sum += weight * value (weight NULL: sum += value)
+void Denoiser::accumulate(float* __restrict sum, const float* value, const float* weight, int n)
+{
+	if (weight)
+	{
+		for (int x = 0; x < n; x++)
+			sum[x] += weight[x] * value[x];
+	}
+	else
+	{
+		for (int x = 0; x < n; x++)
+			sum[x] += value[x];
+	}
+}
+
+
+Denoiser::GuideRow Denoiser::guideRow(int index)
+{
+	GuideRow row;
+
+	row.r = &color_[0][index];
+	row.g = &color_[1][index];
+	row.b = &color_[2][index];
+	row.nx = &normal_[0][index];
+	row.ny = &normal_[1][index];
+	row.nz = &normal_[2][index];
+	row.z = &depth_[index];
+	row.variance = &variance_[index];
+
+	return row;
+}
+
+
+void Denoiser::filterRows(int y0, int y1, int step)
+{
+	// per row sums, one entry per pixel
+	std::vector<float> sum[3], weights(width_), weight(width_), weight2(width_), varianceSum(width_);
+
+	for (int c = 0; c < 3; c++)
+		sum[c].resize(width_);
+
+	float colorSigma2 = colorSigma_ * colorSigma_;
+	float normalScale = 1.0f / (normalSigma_ * normalSigma_);
+	float depthScale = 1.0f / (depthSigma_ * static_cast<float>(step));
+
+	for (int y = y0; y < y1; y++)
+	{
+		int row = y * width_;
+
+		for (int x = 0; x < width_; x++)
+		{
+			sum[0][x] = sum[1][x] = sum[2][x] = 0.0f;
+			weights[x] = varianceSum[x] = 0.0f;
+		}
+
+		for (int j = 0; j < 5; j++)
+		{
+			int qy = y + (j - 2) * step;
+
+			if (qy < 0 || qy >= height_)
+				continue;
+
+			for (int i = 0; i < 5; i++)
+			{
+				int dx = (i - 2) * step;
+				float kernel = KERNEL[i] * KERNEL[j];
+
+				// pixels of this row whose tap is inside of image
+				int x0 = dx < 0 ? -dx : 0;
+				int x1 = dx > 0 ? width_ - dx : width_;
+
+				if (x0 >= x1)
+					continue;
+
+				// this row and tap row
+				int p = row + x0;
+				int q = qy * width_ + x0 + dx;
+				int n = x1 - x0;
+
+				GuideRow pRow = guideRow(p);
+				GuideRow qRow = guideRow(q);
+
+				float* w = &weight[x0];
+
+				tapWeights(pRow, qRow, w, n, kernel, colorSigma2, normalScale, depthScale);
+
+				accumulate(&sum[0][x0], qRow.r, w, n);
+				accumulate(&sum[1][x0], qRow.g, w, n);
+				accumulate(&sum[2][x0], qRow.b, w, n);
+				accumulate(&weights[x0], w, 0, n);
+
+				// variance of weighted mean: sum of w^2 * variance
+				float* w2 = &weight2[x0];
+
+				for (int x = 0; x < n; x++)
+					w2[x] = w[x] * w[x];
+
+				accumulate(&varianceSum[x0], qRow.variance, w2, n);
+			}
+		}
+
+		// center tap always has weight > 0
+		for (int c = 0; c < 3; c++)
+		{
+			float* out = &filtered_[c][row];
+
+			for (int x = 0; x < width_; x++)
+				out[x] = sum[c][x] / weights[x];
+		}
+
+		float* outVariance = &filteredVariance_[row];
+
+		for (int x = 0; x < width_; x++)
+			outVariance[x] = varianceSum[x] / (weights[x] * weights[x]);
+	}
+}
+
+
+void Denoiser::denoise()
+{
+	unsigned int jobs = (height_ + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+	int step = 1;
+
+	// variance of a few samples is noisy itself: 3x3 blur
+	for (int y = 0; y < height_; y++)
+	{
+		for (int x = 0; x < width_; x++)
+		{
+			float sum = 0.0f, weights = 0.0f;
+
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int qx = x + dx, qy = y + dy;
+
+					if (qx < 0 || qy < 0 || qx >= width_ || qy >= height_)
+						continue;
+
+					float w = KERNEL[dx + 2] * KERNEL[dy + 2];
+
+					sum += w * variance_[qy * width_ + qx];
+					weights += w;
+				}
+			}
+
+			filteredVariance_[y * width_ + x] = sum / weights;
+		}
+	}
+
+	variance_.swap(filteredVariance_);
+
+	for (unsigned int iteration = 0; iteration < iterations_; iteration++)
+	{
+		WorkerPool::run(jobs, [&](unsigned int index, unsigned int worker)
+		{
+			int y0 = index * ROWS_PER_JOB;
+			int y1 = y0 + ROWS_PER_JOB < height_ ? y0 + ROWS_PER_JOB : height_;
+
+			filterRows(y0, y1, step);
+		});
+
+		for (int c = 0; c < 3; c++)
+			color_[c].swap(filtered_[c]);
+
+		variance_.swap(filteredVariance_);
+
+		// larger holes
+		step *= 2;
+	}
+}
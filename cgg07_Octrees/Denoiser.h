@@ -0,0 +1,101 @@
+#ifndef DENOISER_H_
+#define DENOISER_H_
+
+#include <vector>
+
+class Vector3D;
+
+/*
+Edge-aware denoiser for noisy renderings (path tracing, ambient occlusion)
+
+The filter is an "a-trous" wavelet: a 5x5 blur which is repeated with
+growing holes between its taps (step 1, 2, 4, 8, ...), so a few iterations
+cover a large area. Each tap is weighted by how similar the neighbour is:
+ - depth: relative difference of view distance
+ - normal: difference of surface normals
+ - color: difference of colors, relative to the pixel's noise (standard
+   deviation of its mean). Noisy pixels are blurred more, converged pixels
+   keep their details. The noise estimate is filtered along with the color.
+so edges between objects, creases and shadows stay sharp.
+
+Textures are protected by dividing the color by the albedo (surface color)
+before filtering and multiplying it back afterwards: only lighting is blurred.
+
+Buffers are stored per channel (structure of arrays) and rows are filtered
+tap by tap, so the inner loops run over plain float arrays and can be
+vectorized by the compiler. Rows are filtered in parallel by the WorkerPool.
+*/
+
+class Denoiser
+{
+private:
+	int width_, height_;
+
+	// color and guides of consecutive pixels
+	struct GuideRow
+	{
+		const float* r;
+		const float* g;
+		const float* b;
+		const float* nx;
+		const float* ny;
+		const float* nz;
+		const float* z;
+		const float* variance;
+	};
+
+	// number of a-trous iterations (5 = 61x61 pixels)
+	unsigned int iterations_;
+
+	// edge stopping: larger sigma = more blur
+	float colorSigma_;
+	float normalSigma_;
+	float depthSigma_;
+
+	// color (lighting only) and its variance, ping pong buffers for iterations
+	std::vector<float> color_[3];
+	std::vector<float> filtered_[3];
+	std::vector<float> variance_;
+	std::vector<float> filteredVariance_;
+
+	// guides
+	std::vector<float> albedo_[3];
+	std::vector<float> normal_[3];
+	std::vector<float> depth_;
+
+	// pointers to color and guides, starting at a pixel
+	GuideRow guideRow(int index);
+
+	// edge stopping weights of n pixels p against their taps q
+	static void tapWeights(GuideRow p, GuideRow q, float* __restrict w, int n, float kernel, float colorSigma2, float normalScale, float depthScale);
+
+	// sum += weight * value for n pixels
+	static void accumulate(float* __restrict sum, const float* value, const float* weight, int n);
+
+	// filter rows [y0, y1) of color_ into filtered_ with distance step between taps
+	void filterRows(int y0, int y1, int step);
+
+	Denoiser(const Denoiser& src);
+
+public:
+	Denoiser(int width, int height);
+	virtual ~Denoiser();
+
+	void setIterations(unsigned int iterations);
+	void setColorSigma(float sigma);
+	void setNormalSigma(float sigma);
+	void setDepthSigma(float sigma);
+
+	// noisy color and guides of a pixel
+	// variance: of the color's luminance (i.e. sample variance / samples)
+	// normal: unit length, albedo: color without lighting
+	void setPixel(int x, int y, double rgb[3], double variance, double depth, Vector3D& normal, double albedo[3]);
+
+	// filter whole image
+	void denoise();
+
+	// filtered color of a pixel
+	void getPixel(int x, int y, double rgb[3]);
+};
+
+#endif
@@ -49,4 +49,52 @@ void Ellipse2D::initialize()
 	{
 		triangles_.push_back(new Surface2D(points_[0], points_[t], points_[t+1], &fillColor_));
 	}
-}
\ No newline at end of file
+}
+
+
+// analytic shape -------------------------------------------------------------
+
+bool Ellipse2D::isAnalytic()
+{
+	return true;
+}
+
+
+void Ellipse2D::getLocalBounds(double* minX, double* minY, double* maxX, double* maxY)
+{
+	*minX = -rx_;
+	*minY = -ry_;
+	*maxX = rx_;
+	*maxY = ry_;
+}
+
+
+// insert x = ox + t * dx and y = oy + t * dy into ellipse equation:
+// a * t^2 + b * t + c <= 0
+
+bool Ellipse2D::getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax)
+{
+	double ox = origin.getX() / rx_;
+	double oy = origin.getY() / ry_;
+	double dx = step.getX() / rx_;
+	double dy = step.getY() / ry_;
+
+	double a = dx * dx + dy * dy;
+	double b = 2.0 * (ox * dx + oy * dy);
+	double c = ox * ox + oy * oy - 1.0;
+
+	if (a == 0.0)
+		return false;
+
+	double discriminant = b * b - 4.0 * a * c;
+
+	if (discriminant < 0.0)
+		return false;
+
+	double root = sqrt(discriminant);
+
+	*tMin = (-b - root) / (2.0 * a);
+	*tMax = (-b + root) / (2.0 * a);
+
+	return true;
+}
@@ -10,6 +10,9 @@ x = rx * cos(phi)
 y = ry * sin(phi)
 
 accuracy determines how many points shall be created (at least 10, default = 100)
+points are only used for border lines, filling uses the analytic shape:
+
+(x / rx)^2 + (y / ry)^2 <= 1
 */
 
 class Ellipse2D : public Object2D
@@ -26,6 +29,11 @@ public:
 	Ellipse2D();
 	Ellipse2D(double rx, double ry, int accuracy = 100);
 	virtual ~Ellipse2D();
+
+	// analytic shape description
+	virtual bool isAnalytic();
+	virtual void getLocalBounds(double* minX, double* minY, double* maxX, double* maxY);
+	virtual bool getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax);
 };
 
 #endif
\ No newline at end of file
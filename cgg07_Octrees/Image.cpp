@@ -1,15 +1,20 @@
 #include "Image.h"
 #include "Color.h"
 #include "Mathtools.h"
+#include "MemoryBudget.h"
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
 
 Image::Image(int width, int height) : width_(width), height_(height)
 {
 	int pixels = width_*height_;
 	pixel_ = new Color[pixels];
+
+	MemoryBudget::allocate(MemoryBudget::IMAGE, pixels * sizeof(Color));
 }
 
 
@@ -18,6 +23,8 @@ Image::Image(int width, int height, Color* buffer) : width_(width), height_(heig
 	int pixels = width_*height_;
 	pixel_ = new Color[pixels];
 
+	MemoryBudget::allocate(MemoryBudget::IMAGE, pixels * sizeof(Color));
+
 	for (int p = 0; p < pixels; p++)
 	{
 		pixel_[p].setColor(buffer[p]);
@@ -30,6 +37,8 @@ Image::Image(const Image& src) : width_(src.width_), height_(src.height_)
 	int pixels = width_*height_;
 	pixel_ = new Color[pixels];
 
+	MemoryBudget::allocate(MemoryBudget::IMAGE, pixels * sizeof(Color));
+
 	for (int p = 0; p < pixels; p++)
 	{
 		pixel_[p].setColor(src.pixel_[p]);
@@ -41,6 +50,8 @@ Image::~Image()
 {
 	// delete pixels
 	delete[] pixel_;
+
+	MemoryBudget::release(MemoryBudget::IMAGE, width_ * height_ * sizeof(Color));
 }
 
 void Image::eat_comment(std::ifstream& f)
@@ -67,22 +78,32 @@ void Image::initialize(int width, int height)
 	if (pixel_)
 		delete[] pixel_;
 
+	MemoryBudget::release(MemoryBudget::IMAGE, width_ * height_ * sizeof(Color));
+
 	width_ = width;
 	height_ = height;
 	
 	int pixels = width * height;
 	pixel_ = new Color[pixels];
+
+	MemoryBudget::allocate(MemoryBudget::IMAGE, pixels * sizeof(Color));
 }
 
 
 void Image::copy(Image& src)
 {
+	delete[] pixel_;
+
+	MemoryBudget::release(MemoryBudget::IMAGE, width_ * height_ * sizeof(Color));
+
 	width_ = src.width_;
 	height_ = src.height_;
 
 	int pixels = width_*height_;
 	pixel_ = new Color[pixels];
 
+	MemoryBudget::allocate(MemoryBudget::IMAGE, pixels * sizeof(Color));
+
 	for (int p = 0; p < pixels; p++)
 	{
 		pixel_[p].setColor(src.pixel_[p]);
@@ -98,6 +119,39 @@ Color Image::getPixel(const int row, const int col)
 }
 
 
+int Image::compare(Image& other, int* maxDelta, int tolerance)
+{
+	if (maxDelta)
+		*maxDelta = 0;
+
+	if (width_ != other.width_ || height_ != other.height_)
+		return -1;
+
+	int count = 0;
+
+	for (int p = 0; p < width_ * height_; p++)
+	{
+		Color& a = pixel_[p];
+		Color& b = other.pixel_[p];
+
+		int delta[3] = {
+			std::abs(a.getRed8B() - b.getRed8B()),
+			std::abs(a.getGreen8B() - b.getGreen8B()),
+			std::abs(a.getBlue8B() - b.getBlue8B()) };
+
+		int d = std::max(delta[0], std::max(delta[1], delta[2]));
+
+		if (maxDelta && d > *maxDelta)
+			*maxDelta = d;
+
+		if (d > tolerance)
+			count++;
+	}
+
+	return count;
+}
+
+
 int Image::getWidth()
 {
 	return width_;
@@ -161,15 +215,39 @@ void Image::load(const std::string& filename)
 
 	std::cout << "Reading file header of \"" << filename << "\"" << std::endl;
 
+	ANYMAP map = PPM;
+	bool ascii = false;
+	int width = 1, height = 1, color_depth = 1;
+
+	if (!readHeader(ifs, map, ascii, width, height, color_depth))
+	{
+		ifs.close();
+		return;
+	}
+
+	std::cout << "Loading content file \"" << filename << "\"" << std::endl;
+
+	initialize(width, height);
+	
+	if (ascii)
+		getColorsFromAscii(ifs, map, color_depth);
+	else
+		getColorsFromBinary(ifs, map, color_depth);
+
+	ifs.close();
+}
+
+
+// magic number, size and color depth, stream is moved to the first pixel
+
+bool Image::readHeader(std::ifstream& ifs, ANYMAP& map, bool& ascii, int& width, int& height, int& color_depth)
+{
 	eat_comment(ifs);
 
 	// read and evaluate magic number
 	std::string magic_number;
 	ifs >> magic_number;
 
-	ANYMAP map = PPM;
-	bool ascii = false;
-
 	if (magic_number.compare("P1") == 0)
 	{
 		// P1 = PBM in ASCII
@@ -209,14 +287,11 @@ void Image::load(const std::string& filename)
 	else
 	{
 		std::cout << "Error, Magic number doesn't fit in anymap format!" << std::endl;
-		ifs.close();
-		return;
+		return false;
 	}
 
 	// read width and height
 
-	int width = 1, height = 1;
-
 	eat_comment(ifs);
 	ifs >> width;
 
@@ -227,12 +302,11 @@ void Image::load(const std::string& filename)
 	if (width < 1 || height < 1)
 	{
 		std::cout << "Error: Unsupported size " << width << "/" << height << std::endl;
-		ifs.close();
-		return;
+		return false;
 	}
 
 	// read color depth if not PBM
-	int color_depth = 1;
+	color_depth = 1;
 
 	if (magic_number.compare("P1") != 0 && magic_number.compare("P4") != 0)
 	{
@@ -242,34 +316,47 @@ void Image::load(const std::string& filename)
 		if (color_depth < 1 || color_depth > 255)
 		{
 			std::cout << "Error: Unsupported color depth " << color_depth << std::endl;
-			ifs.close();
-			return;
+			return false;
 		}
 	}
 
 	// stringstream is currently at a ' ' or '\n', move it by 1
 	ifs.get();
 
-	std::cout << "Loading content file \"" << filename << "\"" << std::endl;
+	return true;
+}
 
-	initialize(width, height);
-	
-	if (ascii)
-		getColorsFromAscii(ifs, map, color_depth);
-	else
-		getColorsFromBinary(ifs, map, color_depth);
 
+bool Image::readSize(const std::string& filename, int& width, int& height)
+{
+	std::ifstream ifs(filename.c_str(), std::ios::binary);
+
+	if (!ifs.is_open())
+	{
+		std::cout << "Error: Unable to open file \"" << filename << "\"" << std::endl;
+		return false;
+	}
+
+	ANYMAP map = PPM;
+	bool ascii = false;
+	int color_depth = 1;
+
+	bool result = readHeader(ifs, map, ascii, width, height, color_depth);
 	ifs.close();
+
+	return result;
 }
 
 
 void Image::getColorsFromAscii(std::ifstream& ss, ANYMAP mode, unsigned int color_depth)
 {
+	int pixels = width_ * height_;
+
 	if (mode == PBM)
 	{
 		int color = 0;
 		int index = 0;
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			ss >> color;
 
@@ -280,7 +367,7 @@ void Image::getColorsFromAscii(std::ifstream& ss, ANYMAP mode, unsigned int colo
 	{
 		int color = 0;
 		int index = 0;
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			ss >> color;
 
@@ -295,7 +382,7 @@ void Image::getColorsFromAscii(std::ifstream& ss, ANYMAP mode, unsigned int colo
 	{
 		int r = 0, g = 0, b = 0;
 		int index = 0;
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			ss >> r >> g >> b;
 			
@@ -311,12 +398,14 @@ void Image::getColorsFromAscii(std::ifstream& ss, ANYMAP mode, unsigned int colo
 
 void Image::getColorsFromBinary(std::ifstream& ss, ANYMAP mode, unsigned int color_depth)
 {
+	int pixels = width_ * height_;
+
 	if (mode == PBM)
 	{
 		int index = 0;
 		int row = 0;
 
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			int color = ss.get();
 
@@ -332,7 +421,7 @@ void Image::getColorsFromBinary(std::ifstream& ss, ANYMAP mode, unsigned int col
 	else if (mode == PGM)
 	{
 		int index = 0;
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			int color = ss.get();
 
@@ -347,7 +436,7 @@ void Image::getColorsFromBinary(std::ifstream& ss, ANYMAP mode, unsigned int col
 	{
 		int index = 0;
 
-		while (!ss.eof())
+		while (!ss.eof() && index < pixels)
 		{
 			int color = ss.get();
 			float red = static_cast<float>(color) / static_cast<float>(color_depth);
@@ -29,7 +29,10 @@ private:
 
 	// removes comments of PNM files starting with '#'
 	// source: http://josiahmanson.com/prose/optimize_ppm/
-	void eat_comment(std::ifstream& f);
+	static void eat_comment(std::ifstream& f);
+
+	// read PNM header, stream is moved to the first pixel
+	static bool readHeader(std::ifstream& ifs, ANYMAP& map, bool& ascii, int& width, int& height, int& color_depth);
 
 	// load informations from stringstream
 	void getColorsFromAscii(std::ifstream& ss, ANYMAP mode, unsigned int color_depth = 255);
@@ -49,6 +52,10 @@ public:
 	int getWidth();
 	int getHeight();
 
+	// number of pixels whose 8 bit colors differ by more than tolerance, -1 if sizes differ
+	// maxDelta: largest difference of a channel (optional)
+	int compare(Image& other, int* maxDelta = 0, int tolerance = 0);
+
 	// save Image as PPM
 	// automatically adds ".ppm"
 	void save(const std::string& filename);
@@ -57,6 +64,9 @@ public:
 	// Possible in both ASCII and Bit code
 	// inspired source: http://josiahmanson.com/prose/optimize_ppm/
 	void load(const std::string& filename);
+
+	// size of an anymap without loading its pixels (header only)
+	static bool readSize(const std::string& filename, int& width, int& height);
 };
 
 #endif
\ No newline at end of file
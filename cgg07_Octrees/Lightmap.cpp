@@ -0,0 +1,339 @@
+#include "Lightmap.h"
+#include "Scene3D.h"
+#include "Object3D.h"
+#include "Surface3D.h"
+#include "Material.h"
+#include "Texture.h"
+#include "Image.h"
+#include "Light.h"
+#include "Ray.h"
+#include "Random.h"
+#include "Mathtools.h"
+#include "WorkerPool.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+int Lightmap::CELL_SIZE = 8;
+double Lightmap::TEXEL_DENSITY = 4.0;
+
+// gap between triangles and cell border in texels
+// (bilinear filtering reads up to 1.5 texels away)
+static const double PADDING = 2.0;
+
+// distance to move ray start away from the surface
+static const double OFFSET = 0.0001;
+
+
+// barycentric coordinates of (px, py) in 2D triangle, clamped to the triangle
+static void texelBarycentric(double px, double py, double x[3], double y[3], double bary[3])
+{
+	double det = (y[1] - y[2]) * (x[0] - x[2]) + (x[2] - x[1]) * (y[0] - y[2]);
+
+	bary[0] = ((y[1] - y[2]) * (px - x[2]) + (x[2] - x[1]) * (py - y[2])) / det;
+	bary[1] = ((y[2] - y[0]) * (px - x[2]) + (x[0] - x[2]) * (py - y[2])) / det;
+	bary[2] = 1.0 - bary[0] - bary[1];
+
+	// texels outside of triangle (gap) use the closest point on it
+	double sum = 0.0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		bary[i] = Mathtools::max(bary[i], 0.0);
+		sum += bary[i];
+	}
+
+	for (int i = 0; i < 3; i++)
+		bary[i] /= sum;
+}
+
+
+Lightmap::Lightmap(Scene3D& scene) : scene_(&scene), shadows_(true), occlusionSamples_(0), occlusionDistance_(1.0)
+{
+}
+
+
+Lightmap::Lightmap(const Lightmap& src)
+{
+}
+
+
+Lightmap::~Lightmap()
+{
+}
+
+
+void Lightmap::setCellSize(int size)
+{
+	CELL_SIZE = size < 8 ? 8 : size;
+}
+
+
+void Lightmap::setTexelDensity(double density)
+{
+	TEXEL_DENSITY = density > 0.0 ? density : 0.0;
+}
+
+
+void Lightmap::setShadows(bool shadows)
+{
+	shadows_ = shadows;
+}
+
+
+void Lightmap::setAmbientOcclusion(unsigned int samples, double distance)
+{
+	occlusionSamples_ = samples;
+	occlusionDistance_ = distance;
+}
+
+
+void Lightmap::bakeTexel(Surface3D* triangle, Vector3D& point, Random& random, float* light)
+{
+	light[0] = light[1] = light[2] = 0.0f;
+
+	Material* material = triangle->getMaterial();
+
+	if (!material)
+		return;
+
+	Vector3D normal = triangle->getNormal(point);
+	Vector3D start = point + normal * OFFSET;
+
+	// part of hemisphere without close surfaces
+	double visibility = 1.0;
+
+	if (occlusionSamples_ > 0)
+	{
+		unsigned int occluded = 0;
+
+		for (unsigned int i = 0; i < occlusionSamples_; i++)
+		{
+			Vector3D dir = Mathtools::cosineHemisphereDirection(normal, random.nextDouble(), random.nextDouble());
+			Ray ray(start, dir);
+			double dist = occlusionDistance_;
+
+			if (scene_->getAnySurfaceAtRay(ray, &dist))
+				occluded++;
+		}
+
+		visibility = 1.0 - static_cast<double>(occluded) / static_cast<double>(occlusionSamples_);
+	}
+
+	// sum without clamping
+	for (Light* source : scene_->getLightList())
+	{
+		Color ambient = material->getAmbientColor() * source->getAmbientColor() * visibility;
+
+		light[0] += ambient.getRed();
+		light[1] += ambient.getGreen();
+		light[2] += ambient.getBlue();
+
+		Vector3D lightDir = source->getPosition() - point;
+		double distance = lightDir.length();
+		lightDir.normalize();
+
+		double coeff = Mathtools::dot(normal, lightDir);
+
+		if (coeff <= 0.0)
+			continue;
+
+		if (shadows_)
+		{
+			Ray shadowRay(start, lightDir);
+			double dist = distance - OFFSET;
+
+			if (scene_->getAnySurfaceAtRay(shadowRay, &dist))
+				continue;
+		}
+
+		double attenuation = 1.0 / (source->getConstantAttenuation() + source->getLinearAttenuation() * distance + source->getQuadraticAttenuation() * distance * distance);
+
+		Color diffuse = material->getDiffuseColor() * source->getDiffuseColor() * coeff * attenuation;
+
+		light[0] += diffuse.getRed();
+		light[1] += diffuse.getGreen();
+		light[2] += diffuse.getBlue();
+	}
+}
+
+
+Texture* Lightmap::bake(Object3D* object)
+{
+	std::vector<Surface3D*> triangles = object->getTriangleList();
+	unsigned int count = triangles.size();
+
+	if (count == 0)
+		return 0;
+
+	// cells of 2 triangles each: a triangle's legs (edge - 3 * PADDING) have
+	// as many texels as a square of its area has at the texel density
+	unsigned int cells = (count + 1) / 2;
+
+	std::vector<int> cellSize(cells);
+	std::vector<unsigned int> order(cells);
+	long long cellTexels = 0;
+
+	for (unsigned int cell = 0; cell < cells; cell++)
+	{
+		double area = triangles[2 * cell]->getArea();
+
+		if (2 * cell + 1 < count)
+			area = Mathtools::max(area, triangles[2 * cell + 1]->getArea());
+
+		double edge = ceil(sqrt(2.0 * area) * TEXEL_DENSITY + 3.0 * PADDING);
+
+		cellSize[cell] = static_cast<int>(Mathtools::min(Mathtools::max(edge, static_cast<double>(CELL_SIZE)), static_cast<double>(MAX_CELL_SIZE)));
+		order[cell] = cell;
+		cellTexels += static_cast<long long>(cellSize[cell]) * cellSize[cell];
+	}
+
+	// rows of cells, largest first, about as wide as high
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return cellSize[a] > cellSize[b]; });
+
+	int width = std::max(cellSize[order[0]], static_cast<int>(ceil(sqrt(static_cast<double>(cellTexels)))));
+	int height = 0;
+
+	std::vector<int> cellX(cells), cellY(cells);
+	int x = 0, rowHeight = 0;
+
+	for (unsigned int cell : order)
+	{
+		if (x + cellSize[cell] > width)
+		{
+			height += rowHeight;
+			x = 0;
+			rowHeight = 0;
+		}
+
+		cellX[cell] = x;
+		cellY[cell] = height;
+
+		x += cellSize[cell];
+		rowHeight = std::max(rowHeight, cellSize[cell]);
+	}
+
+	height += rowHeight;
+
+	// red, green and blue of each texel
+	std::vector<float> light(3 * width * height, 0.0f);
+
+	WorkerPool::run(cells, [&](unsigned int cell, unsigned int worker)
+	{
+		int x0 = cellX[cell];
+		int y0 = cellY[cell];
+		int size = cellSize[cell];
+
+		// triangle corners in texel coordinates: lower left and upper right half
+		double left = x0, top = y0, edge = size;
+
+		double x[2][3] = { { left + PADDING, left + edge - 2.0 * PADDING, left + PADDING },
+		                   { left + edge - PADDING, left + 2.0 * PADDING, left + edge - PADDING } };
+		double y[2][3] = { { top + PADDING, top + PADDING, top + edge - 2.0 * PADDING },
+		                   { top + edge - PADDING, top + edge - PADDING, top + 2.0 * PADDING } };
+
+		Surface3D* halves[2] = { triangles[2 * cell], 2 * cell + 1 < count ? triangles[2 * cell + 1] : 0 };
+
+		for (int half = 0; half < 2; half++)
+		{
+			if (!halves[half])
+				continue;
+
+			// texture coordinates: v = 0 is the bottom row
+			Vector2D t[3];
+
+			for (int i = 0; i < 3; i++)
+				t[i] = Vector2D(x[half][i] / width, 1.0 - y[half][i] / height);
+
+			halves[half]->setLightmapAnchorPoints(t[0], t[1], t[2]);
+		}
+
+		for (int row = y0; row < y0 + size; row++)
+		{
+			for (int col = x0; col < x0 + size; col++)
+			{
+				double px = col + 0.5;
+				double py = row + 0.5;
+
+				// texel belongs to the closer half
+				int half = (px - x0) + (py - y0) < size ? 0 : 1;
+
+				if (!halves[half])
+					half = 0;
+
+				Surface3D* triangle = halves[half];
+
+				double bary[3];
+				texelBarycentric(px, py, x[half], y[half], bary);
+
+				Vector3D point = *triangle->getP0() * bary[0] + *triangle->getP1() * bary[1] + *triangle->getP2() * bary[2];
+
+				// own random sequence per texel, same result for any thread count
+				Random random(0, row * width + col);
+
+				bakeTexel(triangle, point, random, &light[3 * (row * width + col)]);
+			}
+		}
+	});
+
+	// brightest texel is stored as 1, light up to 1 stays as it is
+	float scale = 1.0f;
+
+	for (float value : light)
+		scale = value > scale ? value : scale;
+
+	Color* texels = new Color[width * height];
+
+	for (int i = 0; i < width * height; i++)
+		texels[i] = Color(light[3 * i] / scale, light[3 * i + 1] / scale, light[3 * i + 2] / scale);
+
+	Image image(width, height, texels);
+	delete[] texels;
+
+	Texture* lightmap = new Texture(image);
+
+	for (Surface3D* triangle : triangles)
+		triangle->linkLightmap(lightmap, scale);
+
+	return lightmap;
+}
+
+
+void Lightmap::bake()
+{
+	// shadow and occlusion rays
+	scene_->buildOctrees();
+
+	for (Object3D* object : scene_->getObjectList())
+	{
+		// normal map details are smaller than texels, keep per pixel lighting
+		if (object->getTriangleSize() > 0 && object->getTriangle(0)->getNormalMap())
+		{
+			std::cout << "Lightmap " << object->getID() << ": skipped (normal map)" << std::endl;
+			continue;
+		}
+
+		// decoded triangles are evicted again, the link to the lightmap with them
+		if (object->isCompressed())
+		{
+			std::cout << "Lightmap " << object->getID() << ": skipped (compressed)" << std::endl;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		Texture* lightmap = bake(object);
+
+		if (!lightmap)
+			continue;
+
+		std::string key = "lightmap_" + object->getID();
+		scene_->addNewTexture(key, lightmap);
+
+		std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Lightmap " << object->getID() << ": " << lightmap->getImageWidth() << "x" << lightmap->getImageHeight();
+		std::cout << " texels in " << time.count() << " seconds" << std::endl;
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef LIGHTMAP_H_
+#define LIGHTMAP_H_
+
+#include <vector>
+
+class Scene3D;
+class Object3D;
+class Surface3D;
+class Texture;
+class Vector3D;
+class Color;
+class Random;
+
+/*
+Lightmap bakes static light into textures
+
+As long as objects and lights don't move, ambient and diffuse light of a
+point never change, only the camera does. Baking computes them once for
+every texel of a lightmap (a Texture per Object3D), Shader::phong then needs
+one texture lookup instead of looping over all lights. Specular light
+depends on the view direction and is still computed.
+
+Lightmap coordinates: each object gets its own texture, split into square
+cells. Each cell holds 2 triangles (lower left and upper right half), with a
+gap between them and at the border, so bilinear filtering never mixes
+neighbours. A cell's edge follows the area of its larger triangle
+(setTexelDensity, texels per unit of length) and has at least CELL_SIZE and
+at most MAX_CELL_SIZE texels. Cells are packed in rows, largest first.
+Texels in the gap are filled with the closest point of their triangle.
+
+Each texel stores light without surface color (texture colors keep their own
+resolution): ambient light of all lights (optionally darkened by ambient
+occlusion) plus diffuse light of all lights (optionally with shadow rays).
+Several or strong lights add up to more than 1, which a Color can't store:
+texels are divided by the brightest texel of the lightmap (its scale) and
+Shader::phong multiplies the scale back in.
+Cells are baked in parallel by the WorkerPool. Objects with a normal map
+are not baked, its details are much smaller than a texel. Compressed objects
+are not baked either, their decoded triangles don't last (bake before
+compressing, baked objects then stay uncompressed).
+*/
+
+class Lightmap
+{
+private:
+	// texels per cell edge, at least and at most
+	static int CELL_SIZE;
+	static const int MAX_CELL_SIZE = 512;
+
+	// texels per unit of length in world space
+	static double TEXEL_DENSITY;
+
+	Scene3D* scene_;
+
+	// shadow rays to each light
+	bool shadows_;
+
+	// ambient occlusion rays per texel (0 = off) and their length
+	unsigned int occlusionSamples_;
+	double occlusionDistance_;
+
+	// ambient and diffuse light of all lights at point of triangle (not clamped)
+	void bakeTexel(Surface3D* triangle, Vector3D& point, Random& random, float* light);
+
+	Lightmap(const Lightmap& src);
+
+public:
+	Lightmap(Scene3D& scene);
+	virtual ~Lightmap();
+
+	// smallest cells (at least 8)
+	static void setCellSize(int size);
+
+	// texels per unit of length, cells of large triangles grow with it
+	static void setTexelDensity(double density);
+
+	void setShadows(bool shadows);
+	void setAmbientOcclusion(unsigned int samples, double distance);
+
+	// bake all objects of the scene, lightmaps are added to scene's textures
+	void bake();
+
+	// bake and link a new lightmap for one object, caller owns it
+	// octrees of scene should be built (shadows and ambient occlusion)
+	Texture* bake(Object3D* object);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "Mailbox.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+bool Mailbox::ENABLED = true;
+
+// totals of mailboxes whose threads have ended
+static unsigned long long testCount = 0;
+static unsigned long long skippedCount = 0;
+
+// mailboxes of running threads
+static std::mutex mailboxMutex;
+static std::vector<Mailbox*> mailboxes;
+
+
+Mailbox::Mailbox() : ray_(0), tests_(0), skipped_(0), testTotal_(0), skippedTotal_(0)
+{
+	clearTable();
+
+	std::lock_guard<std::mutex> lock(mailboxMutex);
+	mailboxes.push_back(this);
+}
+
+
+Mailbox::~Mailbox()
+{
+	std::lock_guard<std::mutex> lock(mailboxMutex);
+
+	testCount += testTotal_;
+	skippedCount += skippedTotal_;
+
+	mailboxes.erase(std::remove(mailboxes.begin(), mailboxes.end(), this), mailboxes.end());
+}
+
+
+void Mailbox::clearTable()
+{
+	for (unsigned int i = 0; i < SLOTS; i++)
+	{
+		table_[i].surface = 0;
+		table_[i].ray = 0;
+	}
+}
+
+
+Mailbox& Mailbox::getMailbox()
+{
+	static thread_local Mailbox mailbox;
+	return mailbox;
+}
+
+
+void Mailbox::setEnabled(bool enabled)
+{
+	ENABLED = enabled;
+}
+
+
+bool Mailbox::isEnabled()
+{
+	return ENABLED;
+}
+
+
+void Mailbox::beginRay()
+{
+	ray_++;
+
+	// ray ID overflow: old entries could look like entries of the new ray
+	if (ray_ == 0)
+	{
+		clearTable();
+		ray_ = 1;
+	}
+
+	tests_ = 0;
+	skipped_ = 0;
+}
+
+
+bool Mailbox::wasTested(Surface3D* surface)
+{
+	if (ENABLED)
+	{
+		// surfaces are heap objects, lowest bits of their address are always 0
+		std::uintptr_t address = reinterpret_cast<std::uintptr_t>(surface);
+		Entry& entry = table_[((address >> 4) ^ (address >> 12)) % SLOTS];
+
+		if (entry.ray == ray_ && entry.surface == surface)
+		{
+			skipped_++;
+			return true;
+		}
+
+		entry.surface = surface;
+		entry.ray = ray_;
+	}
+
+	tests_++;
+	return false;
+}
+
+
+void Mailbox::endRay()
+{
+	// only this thread writes its totals: plain load and store, no locked add
+	testTotal_.store(testTotal_.load(std::memory_order_relaxed) + tests_, std::memory_order_relaxed);
+	skippedTotal_.store(skippedTotal_.load(std::memory_order_relaxed) + skipped_, std::memory_order_relaxed);
+
+	tests_ = 0;
+	skipped_ = 0;
+}
+
+
+unsigned long long Mailbox::getTestCount()
+{
+	std::lock_guard<std::mutex> lock(mailboxMutex);
+
+	unsigned long long count = testCount;
+
+	for (Mailbox* mailbox : mailboxes)
+		count += mailbox->testTotal_.load(std::memory_order_relaxed);
+
+	return count;
+}
+
+
+unsigned long long Mailbox::getSkippedCount()
+{
+	std::lock_guard<std::mutex> lock(mailboxMutex);
+
+	unsigned long long count = skippedCount;
+
+	for (Mailbox* mailbox : mailboxes)
+		count += mailbox->skippedTotal_.load(std::memory_order_relaxed);
+
+	return count;
+}
+
+
+void Mailbox::resetStatistics()
+{
+	std::lock_guard<std::mutex> lock(mailboxMutex);
+
+	testCount = 0;
+	skippedCount = 0;
+
+	for (Mailbox* mailbox : mailboxes)
+	{
+		mailbox->testTotal_ = 0;
+		mailbox->skippedTotal_ = 0;
+	}
+}
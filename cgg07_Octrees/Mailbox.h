@@ -0,0 +1,88 @@
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <cstddef>
+#include <atomic>
+
+class Surface3D;
+
+/*
+A mailbox remembers which triangles have already been tested against a ray
+
+OctreeNode stores a triangle in every child it overlaps, so a ray going through
+several leaves may test the same triangle more than once. Each octree query
+gets a new ray ID from beginRay(), and wasTested() returns true if the triangle
+has already been tested with this ray ID (the result can't change, because the
+distance only gets smaller during a query).
+
+The mailbox is a small hash table with one entry per slot. Two triangles in
+the same slot just replace each other, then a triangle is tested twice again,
+which costs time but never changes the result.
+
+Each thread uses its own mailbox (getMailbox()), so no locking is needed.
+endRay() adds the counts of a ray to the totals of the thread's own mailbox,
+nothing is shared in the hot path. The statistics add up the totals of all
+mailboxes, a mailbox's totals go to global counters when its thread ends
+(i.e. the workers at the end of WorkerPool::run()).
+*/
+
+class Mailbox
+{
+private:
+	static const unsigned int SLOTS = 256;
+
+	static bool ENABLED;
+
+	struct Entry
+	{
+		Surface3D* surface;
+		unsigned int ray;
+	};
+
+	Entry table_[SLOTS];
+
+	// ID of current ray, 0 is never used (empty slots)
+	unsigned int ray_;
+
+	// tests of current ray
+	unsigned long long tests_;
+	unsigned long long skipped_;
+
+	// tests of all rays of this thread, only written by it
+	std::atomic<unsigned long long> testTotal_;
+	std::atomic<unsigned long long> skippedTotal_;
+
+	void clearTable();
+
+public:
+	Mailbox();
+	virtual ~Mailbox();
+
+	// mailbox of calling thread
+	static Mailbox& getMailbox();
+
+	// turn mailboxing on/off (i.e. to compare), statistics are still counted
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// start a new ray query
+	void beginRay();
+
+	// returns true if surface has already been tested with current ray
+	// otherwise surface is marked as tested
+	bool wasTested(Surface3D* surface);
+
+	// finish ray query, add counts to the totals of this mailbox
+	void endRay();
+
+	// statistics of all threads since last reset
+	// tests: triangle intersections actually computed
+	// skipped: duplicated triangle tests skipped by mailboxing
+	static unsigned long long getTestCount();
+	static unsigned long long getSkippedCount();
+
+	// call while no rays are traced
+	static void resetStatistics();
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include "Material.h"
 
 
-Material::Material() : shining_(1.0f)
+Material::Material() : shining_(1.0f), reflection_(0.0f), transparency_(0.0f), refractiveIndex_(1.0f)
 {
 	ambient_.setColor(0xdddddd);
 	diffuse_.setColor(0xdddddd);
@@ -27,6 +27,10 @@ void Material::copyMaterial(const Material& material)
 	specular_.setColor(material.specular_);
 
 	shining_ = material.shining_;
+
+	reflection_ = material.reflection_;
+	transparency_ = material.transparency_;
+	refractiveIndex_ = material.refractiveIndex_;
 }
 
 
@@ -114,6 +118,31 @@ void Material::setShining(float shining)
 }
 
 
+// reflection and transparency share the light, together at most 1
+void Material::setReflection(float reflection)
+{
+	reflection_ = reflection < 0.0f ? 0.0f : (reflection > 1.0f ? 1.0f : reflection);
+
+	if (reflection_ + transparency_ > 1.0f)
+		transparency_ = 1.0f - reflection_;
+}
+
+
+void Material::setTransparency(float transparency)
+{
+	transparency_ = transparency < 0.0f ? 0.0f : (transparency > 1.0f ? 1.0f : transparency);
+
+	if (reflection_ + transparency_ > 1.0f)
+		reflection_ = 1.0f - transparency_;
+}
+
+
+void Material::setRefractiveIndex(float index)
+{
+	refractiveIndex_ = index > 0.0f ? index : 1.0f;
+}
+
+
 Color Material::getAmbientColor()
 {
 	return ambient_;
@@ -133,4 +162,22 @@ Color Material::getSpecularColor()
 float Material::getShining()
 {
 	return shining_;
+}
+
+
+float Material::getReflection()
+{
+	return reflection_;
+}
+
+
+float Material::getTransparency()
+{
+	return transparency_;
+}
+
+
+float Material::getRefractiveIndex()
+{
+	return refractiveIndex_;
 }
\ No newline at end of file
@@ -10,6 +10,11 @@ Material contains information we need for shading
  - diffuse color
  - specular color
  - shining exponent
+ - reflection: part of light coming from mirror direction (0 to 1)
+ - transparency: part of light coming through the surface (0 to 1)
+ - refractive index for transparent surfaces (air = 1.0, glass = 1.5)
+
+The Phong color gets the rest: 1 - reflection - transparency
 */
 
 class Material
@@ -20,6 +25,10 @@ private:
 	Color specular_;
 
 	float shining_;
+
+	float reflection_;
+	float transparency_;
+	float refractiveIndex_;
 public:
 	Material();
 	Material(const Material& src);
@@ -45,10 +54,18 @@ public:
 
 	void setShining(float shining);
 
+	void setReflection(float reflection);
+	void setTransparency(float transparency);
+	void setRefractiveIndex(float index);
+
 	Color getAmbientColor();
 	Color getDiffuseColor();
 	Color getSpecularColor();
 	float getShining();
+
+	float getReflection();
+	float getTransparency();
+	float getRefractiveIndex();
 };
 
 #endif
\ No newline at end of file
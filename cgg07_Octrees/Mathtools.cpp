@@ -130,6 +130,30 @@ Vector3D Mathtools::barycentricCoordinates(Vector3D& point, Vector3D& p0, Vector
 	return Vector3D(alpha, beta, gamma);
 }
 
+// Ericson, Real-Time Collision Detection, 3.4
+Vector3D Mathtools::planeBarycentricCoordinates(Vector3D& point, Vector3D& p0, Vector3D& p1, Vector3D& p2)
+{
+	Vector3D v0 = p1 - p0;
+	Vector3D v1 = p2 - p0;
+	Vector3D v2 = point - p0;
+
+	double d00 = dot(v0, v0);
+	double d01 = dot(v0, v1);
+	double d11 = dot(v1, v1);
+	double d20 = dot(v2, v0);
+	double d21 = dot(v2, v1);
+
+	double denom = d00 * d11 - d01 * d01;
+
+	if (denom == 0.0)
+		return Vector3D(1.0, 0.0, 0.0);
+
+	double beta = (d11 * d20 - d01 * d21) / denom;
+	double gamma = (d00 * d21 - d01 * d20) / denom;
+
+	return Vector3D(1.0 - beta - gamma, beta, gamma);
+}
+
 // reflect --------------------------------------------------------------------
 
 Vector3D Mathtools::reflect(Vector3D& v, Vector3D& normal)
@@ -137,6 +161,22 @@ Vector3D Mathtools::reflect(Vector3D& v, Vector3D& normal)
 	return v - (2 * dot(v, normal) * normal);
 }
 
+// Snell's law: eta * sin(incoming angle) = sin(outgoing angle)
+bool Mathtools::refract(Vector3D& v, Vector3D& normal, double eta, Vector3D* result)
+{
+	double cosIn = -dot(v, normal);
+	double sin2Out = eta * eta * (1.0 - cosIn * cosIn);
+
+	if (sin2Out > 1.0)
+		return false;
+
+	double cosOut = sqrt(1.0 - sin2Out);
+	*result = v * eta + normal * (eta * cosIn - cosOut);
+	result->normalize();
+
+	return true;
+}
+
 
 // AABB tests -----------------------------------------------------------------
 
@@ -150,6 +190,156 @@ bool Mathtools::pointInsideAABB(Vector3D& point, Vector3D& center, Vector3D& siz
 		point.getZ() >= min.getZ() && point.getZ() <= max.getZ();
 }
 
+bool Mathtools::AABBOverlap(Vector3D& center1, Vector3D& size1, Vector3D& center2, Vector3D& size2)
+{
+	Vector3D d = center1 - center2;
+	Vector3D s = size1 + size2;
+
+	return fabs(d.getX()) <= s.getX() && fabs(d.getY()) <= s.getY() && fabs(d.getZ()) <= s.getZ();
+}
+
+double Mathtools::pointAABBSquaredDistance(Vector3D& point, Vector3D& center, Vector3D& size)
+{
+	// distance to box along each axis, 0 if point is between both planes
+	double dx = Mathtools::max(fabs(point.getX() - center.getX()) - size.getX(), 0.0);
+	double dy = Mathtools::max(fabs(point.getY() - center.getY()) - size.getY(), 0.0);
+	double dz = Mathtools::max(fabs(point.getZ() - center.getZ()) - size.getZ(), 0.0);
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// projects both triangles onto axis, true if there is a gap between them
+static bool separatedOnAxis(Vector3D& axis, Vector3D p[3], Vector3D q[3])
+{
+	// axis from parallel edges, no information
+	if (Mathtools::dot(axis, axis) < Mathtools::EPSILON * Mathtools::EPSILON)
+		return false;
+
+	double pMin = Mathtools::INF, pMax = -Mathtools::INF;
+	double qMin = Mathtools::INF, qMax = -Mathtools::INF;
+
+	for (int i = 0; i < 3; i++)
+	{
+		double a = Mathtools::dot(axis, p[i]);
+		double b = Mathtools::dot(axis, q[i]);
+
+		pMin = Mathtools::min(pMin, a);
+		pMax = Mathtools::max(pMax, a);
+		qMin = Mathtools::min(qMin, b);
+		qMax = Mathtools::max(qMax, b);
+	}
+
+	return pMax < qMin || qMax < pMin;
+}
+
+// two convex shapes don't intersect if there is an axis separating them
+// for triangles: both normals and the cross products of all edge pairs,
+// coplanar or degenerated (zero area) triangles also need the edge normals
+// inside of the triangle planes. Testing more axes than needed is always
+// correct, so all of them are tested
+bool Mathtools::triangleTriangleIntersection(Vector3D& p0, Vector3D& p1, Vector3D& p2, Vector3D& q0, Vector3D& q1, Vector3D& q2)
+{
+	Vector3D p[3] = { p0, p1, p2 };
+	Vector3D q[3] = { q0, q1, q2 };
+
+	Vector3D pEdge[3] = { p1 - p0, p2 - p1, p0 - p2 };
+	Vector3D qEdge[3] = { q1 - q0, q2 - q1, q0 - q2 };
+
+	Vector3D pNormal = Mathtools::cross(pEdge[0], pEdge[1]);
+	Vector3D qNormal = Mathtools::cross(qEdge[0], qEdge[1]);
+
+	if (separatedOnAxis(pNormal, p, q) || separatedOnAxis(qNormal, p, q))
+		return false;
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			Vector3D axis = Mathtools::cross(pEdge[i], qEdge[j]);
+
+			if (separatedOnAxis(axis, p, q))
+				return false;
+		}
+	}
+
+	// edge normals inside of both planes
+	Vector3D* normals[2] = { &pNormal, &qNormal };
+	Vector3D* edges[2] = { pEdge, qEdge };
+
+	for (Vector3D* normal : normals)
+	{
+		for (Vector3D* edge : edges)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				Vector3D axis = Mathtools::cross(*normal, edge[i]);
+
+				if (separatedOnAxis(axis, p, q))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// closest point on triangle by testing the Voronoi regions of corners, edges and face
+// from "Real-Time Collision Detection" by Christer Ericson
+Vector3D Mathtools::closestPointOnTriangle(Vector3D& point, Vector3D& p0, Vector3D& p1, Vector3D& p2)
+{
+	Vector3D ab = p1 - p0;
+	Vector3D ac = p2 - p0;
+
+	// corner p0
+	Vector3D ap = point - p0;
+	double d1 = Mathtools::dot(ab, ap);
+	double d2 = Mathtools::dot(ac, ap);
+
+	if (d1 <= 0.0 && d2 <= 0.0)
+		return p0;
+
+	// corner p1
+	Vector3D bp = point - p1;
+	double d3 = Mathtools::dot(ab, bp);
+	double d4 = Mathtools::dot(ac, bp);
+
+	if (d3 >= 0.0 && d4 <= d3)
+		return p1;
+
+	// edge p0-p1
+	double vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		return p0 + ab * (d1 / (d1 - d3));
+
+	// corner p2
+	Vector3D cp = point - p2;
+	double d5 = Mathtools::dot(ab, cp);
+	double d6 = Mathtools::dot(ac, cp);
+
+	if (d6 >= 0.0 && d5 <= d6)
+		return p2;
+
+	// edge p0-p2
+	double vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		return p0 + ac * (d2 / (d2 - d6));
+
+	// edge p1-p2
+	double va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+		return p1 + (p2 - p1) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	// inside face
+	double denom = 1.0 / (va + vb + vc);
+	double v = vb * denom;
+	double w = vc * denom;
+
+	return p0 + ab * v + ac * w;
+}
+
 bool Mathtools::rayAABBIntersection(Ray& ray, Vector3D& center, Vector3D& size, double maxDist)
 {
 	return Mathtools::rayAABBIntersection(ray, center, size, &maxDist);
@@ -313,7 +503,28 @@ bool Mathtools::triangleInsideAABB(Vector3D& t0, Vector3D& t1, Vector3D& t2, Vec
 				return false;
 		}
 	}
-	
+
+	// AABB's normals: triangle's bounding box has to overlap AABB
+	double s[3] = { size.getX(), size.getY(), size.getZ() };
+
+	for (int i = 0; i < 3; i++)
+	{
+		double p0 = Mathtools::dot(e[i], v[0]);
+		double p1 = Mathtools::dot(e[i], v[1]);
+		double p2 = Mathtools::dot(e[i], v[2]);
+
+		if (Mathtools::min(Mathtools::min(p0, p1), p2) > s[i] || Mathtools::max(Mathtools::max(p0, p1), p2) < -s[i])
+			return false;
+	}
+
+	// triangle's normal: AABB has to touch triangle's plane
+	Vector3D normal = Mathtools::cross(f[0], f[1]);
+	double d = Mathtools::dot(normal, v[0]);
+	Vector3D absNormal(fabs(normal.getX()), fabs(normal.getY()), fabs(normal.getZ()));
+
+	if (fabs(d) > Mathtools::dot(size, absNormal))
+		return false;
+
 	return true;
 }
 
@@ -447,6 +658,43 @@ void Mathtools::pointsMinMaxValues2D(std::vector<Vector2D*>& points, double* min
 	}
 }
 
+// spread 10 bits, 2 zero bits between each of them
+static unsigned int spreadBits(unsigned int x)
+{
+	x &= 0x3FF;
+	x = (x | (x << 16)) & 0x030000FF;
+	x = (x | (x << 8)) & 0x0300F00F;
+	x = (x | (x << 4)) & 0x030C30C3;
+	x = (x | (x << 2)) & 0x09249249;
+
+	return x;
+}
+
+unsigned int Mathtools::mortonCode(unsigned int x, unsigned int y, unsigned int z)
+{
+	return (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+}
+
+// point on unit disc (polar) lifted up to hemisphere
+// gives directions with probability proportional to cos(angle to normal)
+Vector3D Mathtools::cosineHemisphereDirection(Vector3D& normal, double u, double v)
+{
+	double r = sqrt(u);
+	double phi = 2.0 * PI * v;
+
+	double x = r * cos(phi);
+	double y = r * sin(phi);
+	double z = sqrt(Mathtools::max(0.0, 1.0 - u));
+
+	// tangent space around normal
+	Vector3D helper = fabs(normal.getX()) < 0.9 ? Vector3D(1.0, 0.0, 0.0) : Vector3D(0.0, 1.0, 0.0);
+	Vector3D tangent = Mathtools::cross(helper, normal);
+	tangent.normalize();
+	Vector3D bitangent = Mathtools::cross(normal, tangent);
+
+	return tangent * x + bitangent * y + normal * z;
+}
+
 // max value from 2 numbers
 
 double Mathtools::max(double a, double b)
@@ -459,4 +707,53 @@ double Mathtools::max(double a, double b)
 double Mathtools::min(double a, double b)
 {
 	return a < b ? a : b;
-}
\ No newline at end of file
+}
+
+
+// project onto octahedron |x| + |y| + |z| = 1, fold lower half over the upper one
+
+void Mathtools::octahedralEncode(Vector3D& normal, short* u, short* v)
+{
+	double sum = fabs(normal.getX()) + fabs(normal.getY()) + fabs(normal.getZ());
+
+	if (sum == 0.0)
+	{
+		*u = 0;
+		*v = 0;
+		return;
+	}
+
+	double x = normal.getX() / sum;
+	double y = normal.getY() / sum;
+
+	if (normal.getZ() < 0.0)
+	{
+		double fx = (1.0 - fabs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+		double fy = (1.0 - fabs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+		x = fx;
+		y = fy;
+	}
+
+	*u = static_cast<short>(floor(x * 32767.0 + 0.5));
+	*v = static_cast<short>(floor(y * 32767.0 + 0.5));
+}
+
+Vector3D Mathtools::octahedralDecode(short u, short v)
+{
+	double x = static_cast<double>(u) / 32767.0;
+	double y = static_cast<double>(v) / 32767.0;
+	double z = 1.0 - fabs(x) - fabs(y);
+
+	if (z < 0.0)
+	{
+		double fx = (1.0 - fabs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+		double fy = (1.0 - fabs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+		x = fx;
+		y = fy;
+	}
+
+	Vector3D normal(x, y, z);
+	normal.normalize();
+
+	return normal;
+}
@@ -61,6 +61,9 @@ namespace Mathtools
 	Vector3D sphericalDirectionRadian(const double phi, const double theta);
 	Vector3D sphericalDirectionDegree(const double phi, const double theta);
 
+	// cosine weighted direction around normal (hemisphere), u and v in [0, 1)
+	Vector3D cosineHemisphereDirection(Vector3D& normal, double u, double v);
+
 	// get s and t for triangle parameter form from Point
 	// s = Vector2D::getX()
 	// t = Vector2D::getY()
@@ -69,14 +72,33 @@ namespace Mathtools
 	// get barycentric coordinates
 	Vector3D barycentricCoordinates(Vector3D& point, Vector3D& p0, Vector3D& p1, Vector3D& p2);
 
+	// same for a point in the triangle's plane, with dot products only (no square roots)
+	// coordinates can be negative outside of triangle
+	Vector3D planeBarycentricCoordinates(Vector3D& point, Vector3D& p0, Vector3D& p1, Vector3D& p2);
+
 	// reflect Vector according to normal
 	Vector3D reflect(Vector3D& v, Vector3D& normal);
 
+	// refract normalized v at surface with normal facing against v
+	// eta = refractive index before / after surface
+	// returns false for total internal reflection
+	bool refract(Vector3D& v, Vector3D& normal, double eta, Vector3D* result);
+
 	// AABB tests
 	bool rayAABBIntersection(Ray& ray, Vector3D& center, Vector3D& size, double *dist);
 	bool rayAABBIntersection(Ray& ray, Vector3D& center, Vector3D& size, double maxDist);
 	bool pointInsideAABB(Vector3D& point, Vector3D& center, Vector3D& size);
 	bool triangleInsideAABB(Vector3D& t0, Vector3D& t1, Vector3D& t2, Vector3D& center, Vector3D& size);
+	bool AABBOverlap(Vector3D& center1, Vector3D& size1, Vector3D& center2, Vector3D& size2);
+
+	// squared distance between point and AABB (0 if point is inside)
+	double pointAABBSquaredDistance(Vector3D& point, Vector3D& center, Vector3D& size);
+
+	// triangle/triangle test with separating axes, touching triangles intersect
+	bool triangleTriangleIntersection(Vector3D& p0, Vector3D& p1, Vector3D& p2, Vector3D& q0, Vector3D& q1, Vector3D& q2);
+
+	// point on triangle closest to "point"
+	Vector3D closestPointOnTriangle(Vector3D& point, Vector3D& p0, Vector3D& p1, Vector3D& p2);
 
 	// integral part of floating point number
 	double trunc(double x);
@@ -90,6 +112,14 @@ namespace Mathtools
 	// min/max range of a set of points (values set in parameter)
 	void pointsMinMaxValues2D(std::vector<Vector2D*>& points, double* minX, double* minY, double* maxX, double* maxY);
 
+	// Morton code (z-order curve): interleaves the lowest 10 bits of x, y and z
+	// points close to each other in 3D get close codes
+	unsigned int mortonCode(unsigned int x, unsigned int y, unsigned int z);
+
+	// unit vector as 2 x 16 bit: octahedron folded onto a square
+	void octahedralEncode(Vector3D& normal, short* u, short* v);
+	Vector3D octahedralDecode(short u, short v);
+
 	// get max from 2 doubles
 	double max(double a, double b);
 	double min(double a, double b);
@@ -0,0 +1,169 @@
+#include "MemoryBudget.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+std::atomic<unsigned long long> MemoryBudget::BUDGET(0);
+std::atomic<long long> MemoryBudget::USED[CATEGORIES];
+std::mutex MemoryBudget::TEXTURE_MUTEX;
+std::vector<Texture*> MemoryBudget::TEXTURES;
+std::atomic<unsigned int> MemoryBudget::FRAME(1);
+std::atomic<unsigned int> MemoryBudget::STEPS(0);
+
+
+// bytes as megabytes for the log
+static double megabytes(unsigned long long bytes)
+{
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+
+void MemoryBudget::setBudget(unsigned long long bytes)
+{
+	BUDGET = bytes;
+}
+
+
+unsigned long long MemoryBudget::getBudget()
+{
+	return BUDGET;
+}
+
+
+void MemoryBudget::allocate(Category category, unsigned long long bytes)
+{
+	USED[category] += static_cast<long long>(bytes);
+}
+
+
+void MemoryBudget::release(Category category, unsigned long long bytes)
+{
+	USED[category] -= static_cast<long long>(bytes);
+}
+
+
+void MemoryBudget::update(Category category, unsigned long long& reported, unsigned long long bytes)
+{
+	USED[category] += static_cast<long long>(bytes) - static_cast<long long>(reported);
+	reported = bytes;
+}
+
+
+unsigned long long MemoryBudget::getUsed()
+{
+	long long used = 0;
+
+	for (int c = 0; c < CATEGORIES; c++)
+		used += USED[c];
+
+	return used > 0 ? used : 0;
+}
+
+
+unsigned long long MemoryBudget::getUsed(Category category)
+{
+	long long used = USED[category];
+
+	return used > 0 ? used : 0;
+}
+
+
+bool MemoryBudget::isExceeded(unsigned long long extra)
+{
+	unsigned long long budget = BUDGET;
+
+	return budget > 0 && getUsed() + extra > budget;
+}
+
+
+void MemoryBudget::addTexture(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(TEXTURE_MUTEX);
+	TEXTURES.push_back(texture);
+}
+
+
+void MemoryBudget::removeTexture(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(TEXTURE_MUTEX);
+	TEXTURES.erase(std::remove(TEXTURES.begin(), TEXTURES.end(), texture), TEXTURES.end());
+}
+
+
+bool MemoryBudget::makeRoom(unsigned long long extra, const std::string& reason)
+{
+	if (!isExceeded(extra))
+		return true;
+
+	std::lock_guard<std::mutex> lock(TEXTURE_MUTEX);
+
+	// largest first, fewest textures have to be decoded again
+	std::vector< std::pair<unsigned long long, Texture*> > decoded;
+
+	for (Texture* texture : TEXTURES)
+	{
+		if (texture->isDecoded())
+			decoded.push_back(std::pair<unsigned long long, Texture*>(texture->getMemorySize(), texture));
+	}
+
+	std::sort(decoded.rbegin(), decoded.rend());
+
+	for (unsigned int i = 0; i < decoded.size() && isExceeded(extra); i++)
+	{
+		unsigned long long freed = decoded[i].second->evict();
+
+		if (freed > 0)
+		{
+			std::ostringstream action;
+			action << "evicted texture " << decoded[i].second->getFilename() << " (" << megabytes(freed) << " MB)";
+			log(action.str(), reason);
+		}
+	}
+
+	return !isExceeded(extra);
+}
+
+
+void MemoryBudget::nextFrame()
+{
+	FRAME++;
+}
+
+
+unsigned int MemoryBudget::getFrame()
+{
+	return FRAME.load(std::memory_order_relaxed);
+}
+
+
+void MemoryBudget::log(const std::string& action, const std::string& reason)
+{
+	STEPS++;
+	std::cout << "MemoryBudget: " << action << ", " << megabytes(getUsed()) << " of " << megabytes(BUDGET) << " MB used (" << reason << ")" << std::endl;
+}
+
+
+unsigned int MemoryBudget::getStepCount()
+{
+	return STEPS;
+}
+
+
+void MemoryBudget::printUsage()
+{
+	const char* names[CATEGORIES] = { "images", "textures", "geometry", "octrees" };
+
+	std::cout << "MemoryBudget: " << megabytes(getUsed()) << " MB used";
+
+	if (BUDGET > 0)
+		std::cout << " of " << megabytes(BUDGET) << " MB";
+
+	std::cout << " (";
+
+	for (int c = 0; c < CATEGORIES; c++)
+		std::cout << (c > 0 ? ", " : "") << names[c] << " " << megabytes(getUsed(static_cast<Category>(c))) << " MB";
+
+	std::cout << ")" << std::endl;
+}
@@ -0,0 +1,95 @@
+#ifndef MEMORYBUDGET_H_
+#define MEMORYBUDGET_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Texture;
+
+/*
+MemoryBudget keeps track of the large allocations and compares them with a
+budget (setBudget, 0 = no limit):
+ - images: pixel buffers
+ - textures: packed texels
+ - geometry: points and triangles of objects (or their compressed meshes and
+   the triangles decoded from them)
+ - octrees: nodes, voxel proxies and packed nodes
+
+Images, textures and decoded triangles report every allocation, objects and
+octrees report their size whenever they change (transforming, building,
+compressing).
+
+The budget is enforced at safe points (building octrees, trimming decoded
+triangles of compressed meshes) and before a lazy texture or a block of
+triangles is decoded, also while rendering. If it is exceeded, memory is
+given back in this order:
+ - decoded lazy textures are evicted, largest first (decoded again at their
+   next sample)
+ - at safe points: decoded triangles of compressed meshes are evicted
+ - voxel proxies, the octree's level of detail, are left out
+ - the octree is rebuilt with fewer levels until it fits
+Every step is logged together with the reason.
+
+Renderers call nextFrame() before a frame starts. A texture sampled in the
+current frame is never evicted: a sample marks the texture with the frame
+before it reads texels, eviction gives up on marked textures.
+*/
+
+class MemoryBudget
+{
+public:
+	enum Category { IMAGE, TEXTURE, GEOMETRY, OCTREE, CATEGORIES };
+
+private:
+	// bytes, 0 = no limit
+	static std::atomic<unsigned long long> BUDGET;
+	static std::atomic<long long> USED[CATEGORIES];
+
+	// lazy textures which can be evicted
+	static std::mutex TEXTURE_MUTEX;
+	static std::vector<Texture*> TEXTURES;
+
+	// current frame, textures sampled in it stay
+	static std::atomic<unsigned int> FRAME;
+
+	// logged steps (evictions, smaller octrees)
+	static std::atomic<unsigned int> STEPS;
+
+public:
+	static void setBudget(unsigned long long bytes);
+	static unsigned long long getBudget();
+
+	static void allocate(Category category, unsigned long long bytes);
+	static void release(Category category, unsigned long long bytes);
+
+	// changes a reported size to "bytes" (i.e. after rebuilding)
+	static void update(Category category, unsigned long long& reported, unsigned long long bytes);
+
+	static unsigned long long getUsed();
+	static unsigned long long getUsed(Category category);
+
+	// true if used memory plus "extra" bytes doesn't fit into the budget
+	static bool isExceeded(unsigned long long extra = 0);
+
+	static void addTexture(Texture* texture);
+	static void removeTexture(Texture* texture);
+
+	// evict textures (not sampled in this frame) until "extra" bytes fit
+	// returns false if they still don't
+	static bool makeRoom(unsigned long long extra, const std::string& reason);
+
+	// a new frame starts, nothing of the last frame is sampled anymore
+	static void nextFrame();
+	static unsigned int getFrame();
+
+	// log a step taken to stay within the budget
+	static void log(const std::string& action, const std::string& reason);
+	static unsigned int getStepCount();
+
+	// used memory of each category
+	static void printUsage();
+};
+
+#endif
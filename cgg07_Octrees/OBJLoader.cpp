@@ -120,6 +120,10 @@ void OBJLoader::loadOBJ(const std::string& filename)
 		}
 		else if (command[0].compare("o") == 0)
 		{
+			// previous object is complete
+			if (object)
+				object->reportMemory();
+
 			object = new Polygon3D();
 			object->setID(command[1]);
 			scene_->addNewObject(command[1], object);
@@ -257,6 +261,9 @@ void OBJLoader::loadOBJ(const std::string& filename)
 		}
 	}
 
+	if (object)
+		object->reportMemory();
+
 	is.close();
 }
 
@@ -324,6 +331,21 @@ void OBJLoader::loadMTL(const std::string& filename)
 				material->setSpecularColor(color);
 			}
 		}
+		else if (command[0].compare("Ni") == 0)
+		{
+			if (material)
+			{
+				material->setRefractiveIndex(std::stof(command[1]));
+			}
+		}
+		else if (command[0].compare("d") == 0)
+		{
+			// dissolve: 1 = opaque
+			if (material)
+			{
+				material->setTransparency(1.0f - std::stof(command[1]));
+			}
+		}
 	}
 
 	is.close();
@@ -3,7 +3,7 @@
 #include "Mathtools.h"
 
 
-Object2D::Object2D() : line_(true), fill_(false)
+Object2D::Object2D() : texture_(0), line_(true), fill_(false)
 {
 	lineColor_.setColor(0.0, 0.0, 0.0);   // set to black
 	fillColor_.setColor(1.0, 1.0, 1.0);   // set to white
@@ -106,6 +106,23 @@ Color Object2D::getFillColor()
 	return fillColor_;
 }
 
+Texture* Object2D::getTexture()
+{
+	return texture_;
+}
+
+
+TransformMatrix2D Object2D::getTransformMatrix()
+{
+	return transform_;
+}
+
+
+TransformMatrix2D Object2D::getTextureMatrix()
+{
+	return textureMatrix_;
+}
+
 bool Object2D::isLined()
 {
 	return line_;
@@ -190,12 +207,16 @@ void Object2D::transform(TransformMatrix2D& matrix)
 	{
 		point->setVector(matrix * (*point));
 	}
+
+	transform_ = matrix * transform_;
 }
 
 
 
 void Object2D::linkTexture(Texture* texture)
 {
+	texture_ = texture;
+
 	if (!texture)
 	{
 		for (Surface2D* triangle : triangles_)
@@ -246,5 +267,35 @@ void Object2D::linkTexture(Texture* texture)
 		triangle->setTextureAnchorPoints(t0, t1, t2);
 	}
 
+	// same mapping for analytic shapes: u and v depend linear on the current
+	// scene position, which is transform_ * (object space position)
+	TransformMatrix2D normalize;
+	normalize.at(0, 0) = 1.0 / (maxX - minX);
+	normalize.at(0, 2) = -minX / (maxX - minX);
+	normalize.at(1, 1) = 1.0 / (maxY - minY);
+	normalize.at(1, 2) = -minY / (maxY - minY);
+
+	textureMatrix_ = normalize * transform_;
+
 	fill_ = true;
+}
+
+
+// analytic shape (none by default) -------------------------------------------
+
+bool Object2D::isAnalytic()
+{
+	return false;
+}
+
+
+void Object2D::getLocalBounds(double* minX, double* minY, double* maxX, double* maxY)
+{
+	*minX = *minY = *maxX = *maxY = 0.0;
+}
+
+
+bool Object2D::getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax)
+{
+	return false;
 }
\ No newline at end of file
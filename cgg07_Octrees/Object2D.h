@@ -18,6 +18,10 @@ Contains a list of points, triangles (surfaces) and lines
 
 Can contain reference pointing to a Texture and assigns texture coordinates
 for each point parallel to x- and y-axis, ignoring rotations etc.
+
+Shapes with an analytic description (i.e. rectangle and ellipse) can be filled
+directly by Renderer2D: it intersects each pixel row with the shape in object
+space (getLocalSpan) instead of rasterizing the triangles
 */
 
 class Object2D
@@ -31,6 +35,12 @@ protected:
 	// Texture
 	Texture* texture_;
 
+	// all transformations since creation (object space -> scene space)
+	TransformMatrix2D transform_;
+
+	// object space -> texture coordinates (u, v), set when linking a texture
+	TransformMatrix2D textureMatrix_;
+
 	// boundary and rotation value
 
 	// lineColor_ always needed, we want to draw lines (incl. Polylines)
@@ -77,6 +87,9 @@ public:
 
 	Texture* getTexture();
 
+	TransformMatrix2D getTransformMatrix();
+	TransformMatrix2D getTextureMatrix();
+
 	// setter methods
 
 	void setLineColor(const Color& color);
@@ -102,6 +115,17 @@ public:
 	// abstract query for a point being inside of this object
 
 	bool pointIsInside(Vector2D& point);
+
+	// analytic shape description in object space, override in derived classes
+	// returns false if this object can only be drawn by its triangles
+	virtual bool isAnalytic();
+
+	// bounding box in object space
+	virtual void getLocalBounds(double* minX, double* minY, double* maxX, double* maxY);
+
+	// intersect line "origin + t * step" (object space) with the filled area
+	// returns false if line misses it, otherwise the range [tMin, tMax]
+	virtual bool getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax);
 };
 
 #endif
\ No newline at end of file
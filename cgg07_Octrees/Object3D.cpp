@@ -2,15 +2,18 @@
 #include "Mathtools.h"
 #include "Ray.h"
 #include "Octree.h"
+#include "ViewFrustum.h"
+#include "CompressedMesh.h"
+#include "MemoryBudget.h"
 
 #include <iostream>
 
-Object3D::Object3D() : texture_(0), octree_(0)
+Object3D::Object3D() : texture_(0), octree_(0), mesh_(0), frustum_(0), memorySize_(0)
 {
 	material_ = new Material();
 }
 
-Object3D::Object3D(const std::string& id) : texture_(0), octree_(0), id_(id)
+Object3D::Object3D(const std::string& id) : texture_(0), octree_(0), mesh_(0), frustum_(0), id_(id), memorySize_(0)
 {
 	material_ = new Material();
 }
@@ -38,8 +41,16 @@ Object3D::~Object3D()
 	if (octree_)
 		delete octree_;
 
+	if (mesh_)
+		delete mesh_;
+
+	if (frustum_)
+		delete frustum_;
+
 	if (material_)
 		delete material_;
+
+	MemoryBudget::update(MemoryBudget::GEOMETRY, memorySize_, 0);
 }
 
 
@@ -52,10 +63,13 @@ void Object3D::assignMaterialToSurfaces()
 }
 
 
-Surface3D* Object3D::intersect(Ray& ray, double* dist)
+Surface3D* Object3D::intersect(Ray& ray, double* dist, bool anyHit)
 {
+	if (mesh_)
+		return mesh_->intersect(ray, dist, anyHit);
+
 	if (octree_)
-		return octree_->intersection(ray, dist);
+		return octree_->intersection(ray, dist, anyHit);
 
 	Surface3D* foundSurface = 0;
 
@@ -66,6 +80,9 @@ Surface3D* Object3D::intersect(Ray& ray, double* dist)
 		{
 			*dist = temp;
 			foundSurface = tri;
+
+			if (anyHit)
+				break;
 		}
 	}
 
@@ -73,6 +90,114 @@ Surface3D* Object3D::intersect(Ray& ray, double* dist)
 }
 
 
+Surface3D* Object3D::nearestSurface(Vector3D& point, double* dist, Vector3D* closest)
+{
+	if (octree_)
+		return octree_->nearestSurface(point, dist, closest);
+
+	int found = -1;
+
+	visitTriangles([&](unsigned int index, Surface3D* tri)
+	{
+		Vector3D p = Mathtools::closestPointOnTriangle(point, *tri->getP0(), *tri->getP1(), *tri->getP2());
+		double temp = Mathtools::distance(point, p);
+
+		if (temp < *dist)
+		{
+			*dist = temp;
+			found = index;
+
+			if (closest)
+				closest->setVector(p);
+		}
+
+		return true;
+	});
+
+	return found >= 0 ? getTriangle(found) : 0;
+}
+
+
+void Object3D::surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result)
+{
+	if (octree_)
+	{
+		octree_->surfacesInBox(center, size, result);
+		return;
+	}
+
+	// matches only are kept decoded
+	std::vector<unsigned int> found;
+
+	visitTriangles([&](unsigned int index, Surface3D* tri)
+	{
+		if (Mathtools::triangleInsideAABB(*tri->getP0(), *tri->getP1(), *tri->getP2(), center, size))
+			found.push_back(index);
+
+		return true;
+	});
+
+	for (unsigned int index : found)
+		result.push_back(getTriangle(index));
+}
+
+
+void Object3D::surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result)
+{
+	if (octree_)
+	{
+		octree_->surfacesInSphere(center, radius, result);
+		return;
+	}
+
+	std::vector<unsigned int> found;
+
+	visitTriangles([&](unsigned int index, Surface3D* tri)
+	{
+		Vector3D p = Mathtools::closestPointOnTriangle(center, *tri->getP0(), *tri->getP1(), *tri->getP2());
+
+		if (Mathtools::distance(center, p) <= radius)
+			found.push_back(index);
+
+		return true;
+	});
+
+	for (unsigned int index : found)
+		result.push_back(getTriangle(index));
+}
+
+
+bool Object3D::collide(Object3D& other, std::vector<SurfacePair>& contacts, bool anyContact)
+{
+	if (octree_ && other.octree_)
+		return octree_->collide(*other.octree_, contacts, anyContact);
+
+	// indices of contacts, only those are kept decoded
+	std::vector< std::pair<unsigned int, unsigned int> > found;
+
+	visitTriangles([&](unsigned int indexA, Surface3D* a)
+	{
+		return other.visitTriangles([&](unsigned int indexB, Surface3D* b)
+		{
+			if (Mathtools::triangleTriangleIntersection(*a->getP0(), *a->getP1(), *a->getP2(), *b->getP0(), *b->getP1(), *b->getP2()))
+			{
+				found.push_back(std::make_pair(indexA, indexB));
+
+				if (anyContact)
+					return false;
+			}
+
+			return true;
+		});
+	});
+
+	for (std::pair<unsigned int, unsigned int>& pair : found)
+		contacts.push_back(SurfacePair(getTriangle(pair.first), other.getTriangle(pair.second)));
+
+	return !found.empty();
+}
+
+
 void Object3D::setID(const std::string& id)
 {
 	id_ = id;
@@ -90,24 +215,36 @@ void Object3D::setMaterial(Material* material)
 
 Vector3D* Object3D::getPoint(int index)
 {
+	if (mesh_)
+		return mesh_->getPoint(index);
+
 	return points_[index];
 }
 
 
 Surface3D* Object3D::getTriangle(int index)
 {
+	if (mesh_)
+		return mesh_->getSurface(index);
+
 	return triangles_[index];
 }
 
 
 unsigned int Object3D::getPointSize()
 {
+	if (mesh_)
+		return mesh_->getPointSize();
+
 	return points_.size();
 }
 
 
 unsigned int Object3D::getTriangleSize()
 {
+	if (mesh_)
+		return mesh_->getTriangleSize();
+
 	return triangles_.size();
 }
 
@@ -119,7 +256,40 @@ Material* Object3D::getMaterial()
 
 std::vector<Surface3D*> Object3D::getTriangleList()
 {
-	return triangles_;
+	if (!mesh_)
+		return triangles_;
+
+	// decodes every triangle
+	std::vector<Surface3D*> list(mesh_->getTriangleSize());
+
+	for (unsigned int i = 0; i < list.size(); i++)
+		list[i] = mesh_->getSurface(i);
+
+	return list;
+}
+
+
+void Object3D::addTriangle(Surface3D* triangle)
+{
+	triangle->setObject(this);
+	triangle->setIndex(triangles_.size());
+
+	triangles_.push_back(triangle);
+}
+
+
+bool Object3D::visitTriangles(std::function<bool(unsigned int, Surface3D*)> visitor)
+{
+	if (mesh_)
+		return mesh_->visit(visitor);
+
+	for (unsigned int i = 0; i < triangles_.size(); i++)
+	{
+		if (!visitor(i, triangles_[i]))
+			return false;
+	}
+
+	return true;
 }
 
 
@@ -208,6 +378,12 @@ void Object3D::scale(const double sx, const double sy, const double sz)
 
 void Object3D::transform(TransformMatrix3D& matrix)
 {
+	if (mesh_)
+	{
+		mesh_->transform(matrix);
+		return;
+	}
+
 	for (Vector3D* point : points_)
 	{
 		point->setVector(matrix * (*point));
@@ -224,23 +400,119 @@ void Object3D::transform(TransformMatrix3D& matrix)
 
 void Object3D::update()
 {
+	reportMemory();
+
 	if (!octree_)
 		return;
 
-	octree_->clear();
-	int max = triangles_.size();
+	std::vector<Surface3D*> list;
 
-	std::cout << id_ << ": Adding " << max << " triangles to Octree...";
 	for (Surface3D* tri : triangles_)
 	{
-		octree_->addSurface(tri);
+		if (!frustum_ || frustum_->isTriangleVisible(*tri->getP0(), *tri->getP1(), *tri->getP2()))
+			list.push_back(tri);
 	}
+
+	std::cout << id_ << ": Adding " << list.size() << " triangles to Octree...";
+
+	if (frustum_)
+		std::cout << " (" << triangles_.size() - list.size() << " outside of view frustum)";
+
+	octree_->build(list);
+
 	std::cout << " finished!" << std::endl;
 }
 
 
-void Object3D::buildOctree()
+void Object3D::buildOctree(ViewFrustum* frustum)
 {
+	// compressed meshes have their own hierarchy
+	if (mesh_)
+		return;
+
+	if (frustum_)
+		delete frustum_;
+
+	frustum_ = frustum ? new ViewFrustum(*frustum) : 0;
+
+	if (octree_)
+		delete octree_;
+
 	octree_ = new Octree(this);
 	update();
 }
+
+
+void Object3D::reportMemory()
+{
+	unsigned long long size = triangles_.size() * (sizeof(Surface3D) + sizeof(Surface3D*)) + points_.size() * (sizeof(Vector3D) + sizeof(Vector3D*));
+
+	// decoded triangles of the mesh report themselves while they are decoded
+	if (mesh_)
+		size += mesh_->getMemorySize();
+
+	MemoryBudget::update(MemoryBudget::GEOMETRY, memorySize_, size);
+}
+
+
+void Object3D::compress()
+{
+	if (mesh_ || triangles_.empty())
+		return;
+
+	for (Surface3D* tri : triangles_)
+	{
+		if (tri->getLightmap())
+		{
+			std::cout << id_ << ": has a lightmap, not compressed" << std::endl;
+			return;
+		}
+	}
+
+	// triangles and points only, without octree
+	unsigned long long size = triangles_.size() * (sizeof(Surface3D) + sizeof(Surface3D*)) + points_.size() * (sizeof(Vector3D) + sizeof(Vector3D*));
+
+	mesh_ = new CompressedMesh(this, triangles_);
+
+	std::cout << id_ << ": compressed " << triangles_.size() << " triangles, " << size << " -> " << mesh_->getMemorySize() << " bytes" << std::endl;
+
+	for (Surface3D* tri : triangles_)
+		delete tri;
+
+	for (Vector3D* point : points_)
+		delete point;
+
+	triangles_.clear();
+	points_.clear();
+
+	if (octree_)
+		delete octree_;
+
+	octree_ = 0;
+
+	reportMemory();
+}
+
+
+bool Object3D::isCompressed()
+{
+	return mesh_ != 0;
+}
+
+
+bool Object3D::trimDecoded()
+{
+	return mesh_ ? mesh_->trim() : false;
+}
+
+
+unsigned long long Object3D::getDecodedMemorySize()
+{
+	return mesh_ ? mesh_->getDecodedMemorySize() : 0;
+}
+
+
+unsigned long long Object3D::getPeakDecodedMemorySize()
+{
+	return mesh_ ? mesh_->getPeakDecodedMemorySize() : 0;
+}
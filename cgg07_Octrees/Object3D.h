@@ -8,10 +8,13 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 
 class Texture;
 class Ray;
 class Octree;
+class ViewFrustum;
+class CompressedMesh;
 
 /*
 Abstract class for drawable 2D objects
@@ -21,6 +24,14 @@ Contains a list of points, triangles (surfaces) and lines
 
 Can contain reference pointing to a Texture and assigns texture coordinates
 for each point parallel to x- and y-axis, ignoring rotations etc.
+
+compress() replaces points, triangles and octree by a CompressedMesh (about
+a tenth of the memory). Call it after materials and textures are linked,
+getters then return triangles decoded on demand (valid until trimDecoded).
+visitTriangles() looks at every triangle without keeping decoded ones.
+
+Points and triangles are reported to MemoryBudget whenever the object is
+loaded, transformed, compressed or gets a new octree.
 */
 
 class Object3D
@@ -36,11 +47,20 @@ protected:
 	// Octree object which surrounds whole object in an AABB
 	Octree* octree_;
 
+	// compressed triangles, replace points_, triangles_ and octree_ (optional)
+	CompressedMesh* mesh_;
+
+	// optional: only triangles inside of this frustum are added to octree
+	ViewFrustum* frustum_;
+
 	// Texture
 	Texture* texture_;
 
 	Material* material_;
 
+	// bytes of points and triangles (or mesh) reported to MemoryBudget
+	unsigned long long memorySize_;
+
 	// no copy constructor allowed
 
 	Object3D(const Object3D& src);
@@ -56,13 +76,25 @@ protected:
 	// update octree anytime the object gets transformed
 	void update();
 
+	// append triangle, it knows its object and index (i.e. for AOV IDs)
+	void addTriangle(Surface3D* triangle);
+
 public:
 	Object3D();
 	Object3D(const std::string& id);
 	virtual ~Object3D();
 
 	// intersect function
-	Surface3D* intersect(Ray& ray, double* dist);
+	// anyHit: stop at first surface closer than dist (i.e. shadow rays)
+	Surface3D* intersect(Ray& ray, double* dist, bool anyHit = false);
+
+	// proximity queries, same as in Octree (without octree: test all triangles)
+	Surface3D* nearestSurface(Vector3D& point, double* dist, Vector3D* closest = 0);
+	void surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result);
+	void surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result);
+
+	// collision detection, see Octree::collide (without octrees: test all triangle pairs)
+	bool collide(Object3D& other, std::vector<SurfacePair>& contacts, bool anyContact = false);
 
 	// getter methods (no setters for points and lines)
 
@@ -72,8 +104,13 @@ public:
 	unsigned int getPointSize();
 	unsigned int getTriangleSize();
 
+	// compressed objects: decodes and keeps all triangles, prefer visitTriangles
 	std::vector<Surface3D*> getTriangleList();
 
+	// visitor(index, triangle) for each triangle until it returns false
+	// compressed objects: triangle is temporary, getTriangle(index) keeps it
+	bool visitTriangles(std::function<bool(unsigned int, Surface3D*)> visitor);
+
 	Material* getMaterial();
 
 	Texture* getTexture();
@@ -102,7 +139,25 @@ public:
 	void transform(TransformMatrix3D& matrix);
 
 	// Octree's are optional, it should be built if user wants to
-	void buildOctree();
+	// with a view frustum, triangles outside of it are left out (they can't be hit anymore)
+	void buildOctree(ViewFrustum* frustum = 0);
+
+	// quantize triangles into a CompressedMesh, objects with lightmaps stay uncompressed
+	// later transformations must be rigid (no scale), see CompressedMesh
+	void compress();
+	bool isCompressed();
+
+	// evict decoded triangles of a compressed object beyond its cache (see CompressedMesh::trim)
+	// returns true if triangles or points were evicted
+	bool trimDecoded();
+
+	// bytes of decoded triangles of a compressed object, now and at most
+	unsigned long long getDecodedMemorySize();
+	unsigned long long getPeakDecodedMemorySize();
+
+	// report current size of points and triangles (or compressed mesh) to MemoryBudget
+	// (i.e. after a loader added them)
+	void reportMemory();
 };
 
 #endif
@@ -1,8 +1,21 @@
 #include "Octree.h"
 #include "OctreeNode.h"
 #include "Object3D.h"
+#include "Mailbox.h"
+#include "WorkerPool.h"
+#include "MemoryBudget.h"
 
-Octree::Octree(Object3D* object) : object_(object)
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+bool Octree::PROXIES = false;
+bool Octree::REPLICATION = true;
+unsigned int Octree::COLLISION_PAIRS = 16;
+
+Octree::Octree(Object3D* object) : root_(0), object_(object), proxies_(PROXIES), replication_(REPLICATION), memorySize_(0), packed_(0), packedSize_(0)
 {
 	setRootCenterAndSize();
 }
@@ -16,6 +29,9 @@ Octree::Octree(const Octree& src)
 Octree::~Octree()
 {
 	delete root_;
+	clearPacked();
+
+	MemoryBudget::update(MemoryBudget::OCTREE, memorySize_, 0);
 }
 
 
@@ -59,15 +75,503 @@ void Octree::setRootCenterAndSize()
 	root_ = new OctreeNode(center, size, 0);
 }
 
-Surface3D* Octree::intersection(Ray& ray, double* dist)
+void Octree::setRootCenterAndSize(std::vector<Surface3D*>& surfaces)
+{
+	root_ = 0;
+
+	// no surfaces, no root node (nothing can be hit)
+	if (surfaces.empty())
+		return;
+
+	double inf = static_cast<double>(INFINITY);
+	double eps = Mathtools::EPSILON;
+
+	double xmin = inf, ymin = inf, zmin = inf;
+	double xmax = -inf, ymax = -inf, zmax = -inf;
+
+	for (Surface3D* surface : surfaces)
+	{
+		Vector3D* points[3] = { surface->getP0(), surface->getP1(), surface->getP2() };
+
+		for (Vector3D* p : points)
+		{
+			xmin = Mathtools::min(xmin, p->getX());
+			ymin = Mathtools::min(ymin, p->getY());
+			zmin = Mathtools::min(zmin, p->getZ());
+
+			xmax = Mathtools::max(xmax, p->getX());
+			ymax = Mathtools::max(ymax, p->getY());
+			zmax = Mathtools::max(zmax, p->getZ());
+		}
+	}
+
+	Vector3D center((xmax + xmin) / 2.0, (ymax + ymin) / 2.0, (zmax + zmin) / 2.0);
+	Vector3D size((xmax - xmin) / 2.0 + eps, (ymax - ymin) / 2.0 + eps, (zmax - zmin) / 2.0 + eps);
+	root_ = new OctreeNode(center, size, 0);
+}
+
+Surface3D* Octree::intersection(Ray& ray, double* dist, bool anyHit)
+{
+	if (!root_)
+		return 0;
+
+	// every query is a new ray for the mailbox
+	Mailbox& mailbox = Mailbox::getMailbox();
+	mailbox.beginRay();
+
+	Surface3D* result = 0;
+
+	// proxies are only stored in the octree nodes
+	if (packed_ && !proxies_)
+		result = packedIntersection(ray, dist, mailbox, anyHit);
+	else
+		result = root_->intersection(ray, dist, &mailbox, anyHit);
+
+	mailbox.endRay();
+
+	return result;
+}
+
+
+Surface3D* Octree::nearestSurface(Vector3D& point, double* dist, Vector3D* closest)
 {
-	return root_->intersection(ray, dist);
+	if (!root_)
+		return 0;
+
+	// skip duplicated triangles, no statistics (they are for rays only)
+	Mailbox& mailbox = Mailbox::getMailbox();
+	mailbox.beginRay();
+
+	double distSq = *dist * *dist;
+	Surface3D* result = root_->nearestSurface(point, &distSq, closest, &mailbox);
+
+	if (result)
+		*dist = sqrt(distSq);
+
+	return result;
+}
+
+
+void Octree::surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result)
+{
+	if (!root_)
+		return;
+
+	std::vector<Surface3D*> candidates;
+	root_->surfacesInBox(center, size, candidates);
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// leaves can be larger than the box, test each triangle
+	for (Surface3D* surface : candidates)
+	{
+		if (Mathtools::triangleInsideAABB(*surface->getP0(), *surface->getP1(), *surface->getP2(), center, size))
+			result.push_back(surface);
+	}
+}
+
+
+void Octree::surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result)
+{
+	if (!root_)
+		return;
+
+	std::vector<Surface3D*> candidates;
+	root_->surfacesInSphere(center, radius, candidates);
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	for (Surface3D* surface : candidates)
+	{
+		Vector3D p = Mathtools::closestPointOnTriangle(center, *surface->getP0(), *surface->getP1(), *surface->getP2());
+		Vector3D d = p - center;
+
+		if (Mathtools::dot(d, d) <= radius * radius)
+			result.push_back(surface);
+	}
+}
+
+
+bool Octree::collide(Octree& other, std::vector<SurfacePair>& contacts, bool anyContact)
+{
+	if (!root_ || !other.root_ || !OctreeNode::overlap(root_, other.root_))
+		return false;
+
+	unsigned int threads = WorkerPool::getThreadCount();
+
+	// split node pairs until there are enough jobs for all worker threads
+	std::vector<OctreeNode::NodePair> pairs;
+	pairs.push_back(OctreeNode::NodePair(root_, other.root_));
+
+	bool split = true;
+
+	while (split && pairs.size() < threads * COLLISION_PAIRS)
+	{
+		std::vector<OctreeNode::NodePair> next;
+		split = false;
+
+		for (OctreeNode::NodePair& pair : pairs)
+		{
+			if (OctreeNode::splitPair(pair.first, pair.second, next))
+				split = true;
+			else
+				next.push_back(pair);
+		}
+
+		pairs.swap(next);
+	}
+
+	std::vector< std::vector<SurfacePair> > workerContacts(threads);
+	std::atomic<bool> found(false);
+
+	WorkerPool::run(pairs.size(), [&](unsigned int index, unsigned int worker)
+	{
+		OctreeNode::collide(pairs[index].first, pairs[index].second, workerContacts[worker], anyContact, found);
+	});
+
+	// triangles in several leaves give the same pair more than once
+	std::vector<SurfacePair> result;
+
+	for (std::vector<SurfacePair>& list : workerContacts)
+		result.insert(result.end(), list.begin(), list.end());
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+
+	contacts.insert(contacts.end(), result.begin(), result.end());
+
+	return !result.empty();
 }
 
 
 void Octree::addSurface(Surface3D* surface)
 {
-	root_->addSurface(surface);
+	if (root_)
+		root_->addSurface(surface);
+}
+
+
+void Octree::build(std::vector<Surface3D*>& surfaces)
+{
+	proxies_ = PROXIES;
+	replication_ = REPLICATION;
+	unsigned int levelMax = OctreeNode::getLevelMax();
+
+	buildNodes(surfaces, levelMax);
+
+	if (!MemoryBudget::isExceeded())
+		return;
+
+	std::string reason = "building octree of " + (object_ ? object_->getID() : std::string("surfaces"));
+
+	// textures can be decoded again, so they go first
+	if (MemoryBudget::makeRoom(0, reason))
+		return;
+
+	// even without this octree the budget is exceeded, a smaller one only costs time
+	if (MemoryBudget::getUsed() - memorySize_ > MemoryBudget::getBudget())
+	{
+		MemoryBudget::log("octree kept, budget too small for the rest of the scene", reason);
+		return;
+	}
+
+	if (!packedReplicas_.empty())
+	{
+		replication_ = false;
+		pack();
+
+		MemoryBudget::update(MemoryBudget::OCTREE, memorySize_, getMemorySize());
+		MemoryBudget::log("dropped copies of packed nodes per NUMA node", reason);
+	}
+
+	if (MemoryBudget::isExceeded() && proxies_)
+	{
+		proxies_ = false;
+		buildNodes(surfaces, levelMax);
+
+		MemoryBudget::log("dropped voxel proxies (level of detail)", reason);
+	}
+
+	unsigned long long size = memorySize_ + 1;
+
+	// stop as soon as fewer levels don't save memory anymore
+	while (MemoryBudget::isExceeded() && levelMax > 1 && memorySize_ < size)
+	{
+		size = memorySize_;
+
+		levelMax--;
+		buildNodes(surfaces, levelMax);
+
+		std::ostringstream action;
+		action << "capped octree at " << levelMax << " levels";
+		MemoryBudget::log(action.str(), reason);
+	}
+}
+
+
+void Octree::buildNodes(std::vector<Surface3D*>& surfaces, unsigned int levelMax)
+{
+	delete root_;
+	setRootCenterAndSize(surfaces);
+
+	if (root_)
+		root_->capLevels(levelMax);
+
+	for (Surface3D* surface : surfaces)
+		addSurface(surface);
+
+	if (root_ && proxies_)
+	{
+		std::vector<Surface3D*> proxySurfaces;
+		root_->buildProxies(proxySurfaces);
+	}
+
+	pack();
+
+	MemoryBudget::update(MemoryBudget::OCTREE, memorySize_, getMemorySize());
+}
+
+
+void Octree::pack()
+{
+	clearPacked();
+
+	if (!root_)
+		return;
+
+	std::vector<OctreeNode::Packed> nodes(1);
+
+	root_->tightBounds(packedMin_, packedMax_);
+	root_->pack(nodes, 0, packedMin_, packedMax_, packedSurfaces_);
+
+	// 64 byte nodes, each one in its own cache line
+	packedSize_ = nodes.size();
+	packed_ = static_cast<OctreeNode::Packed*>(aligned_alloc(64, packedSize_ * sizeof(OctreeNode::Packed)));
+	memcpy(packed_, nodes.data(), packedSize_ * sizeof(OctreeNode::Packed));
+
+	// copies are only used by pinned workers
+	if (replication_ && WorkerPool::getAffinity() && WorkerPool::getNodeCount() > 1)
+		replicate();
+}
+
+
+void Octree::replicate()
+{
+	unsigned int nodes = WorkerPool::getNodeCount();
+
+	packedReplicas_.assign(nodes, 0);
+	surfaceReplicas_.assign(nodes, 0);
+
+	unsigned int surfaces = packedSurfaces_.size();
+
+	// allocated and written on a thread of each node, so the pages are local there
+	WorkerPool::runPerNode([&](unsigned int node)
+	{
+		OctreeNode::Packed* packed = static_cast<OctreeNode::Packed*>(aligned_alloc(64, packedSize_ * sizeof(OctreeNode::Packed)));
+		memcpy(packed, packed_, packedSize_ * sizeof(OctreeNode::Packed));
+
+		Surface3D** list = new Surface3D*[surfaces > 0 ? surfaces : 1];
+		std::copy(packedSurfaces_.begin(), packedSurfaces_.end(), list);
+
+		packedReplicas_[node] = packed;
+		surfaceReplicas_[node] = list;
+	});
+}
+
+
+void Octree::clearPacked()
+{
+	free(packed_);
+
+	for (OctreeNode::Packed* packed : packedReplicas_)
+		free(packed);
+
+	for (Surface3D** list : surfaceReplicas_)
+		delete[] list;
+
+	packed_ = 0;
+	packedSize_ = 0;
+	packedSurfaces_.clear();
+	packedReplicas_.clear();
+	surfaceReplicas_.clear();
+}
+
+
+unsigned long long Octree::getPackedSize()
+{
+	unsigned long long size = packedSize_ * sizeof(OctreeNode::Packed) + packedSurfaces_.capacity() * sizeof(Surface3D*);
+	unsigned long long replicas = packedReplicas_.size() * (packedSize_ * sizeof(OctreeNode::Packed) + packedSurfaces_.size() * sizeof(Surface3D*));
+
+	return size + replicas;
+}
+
+
+unsigned long long Octree::getMemorySize()
+{
+	return (root_ ? root_->getMemorySize() : 0) + getPackedSize();
+}
+
+
+// slab test, entry: distance where ray enters the box
+static bool rayBoxIntersection(double* min, double* max, double* start, double* invDir, double maxDist, double* entry)
+{
+	double near = 0.0;
+	double far = maxDist;
+
+	for (int a = 0; a < 3; a++)
+	{
+		double t1 = (min[a] - start[a]) * invDir[a];
+		double t2 = (max[a] - start[a]) * invDir[a];
+
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		near = t1 > near ? t1 : near;
+		far = t2 < far ? t2 : far;
+
+		if (near > far)
+			return false;
+	}
+
+	*entry = near;
+	return true;
+}
+
+
+Surface3D* Octree::packedIntersection(Ray& ray, double* dist, Mailbox& mailbox, bool anyHit)
+{
+	struct Entry
+	{
+		unsigned int node;
+		double entry;
+		double min[3];
+		double max[3];
+	};
+
+	Vector3D rayStart = ray.getStart();
+	Vector3D rayDir = ray.getDirection();
+
+	double start[3] = { rayStart.getX(), rayStart.getY(), rayStart.getZ() };
+	double invDir[3] = { 1.0 / rayDir.getX(), 1.0 / rayDir.getY(), 1.0 / rayDir.getZ() };
+
+	// at most 7 siblings wait on each level
+	Entry stack[7 * OctreeNode::LEVEL_MAX_LIMIT + 1];
+	int top = 0;
+
+	double entry;
+
+	if (!rayBoxIntersection(packedMin_, packedMax_, start, invDir, *dist, &entry))
+		return 0;
+
+	stack[0].node = 0;
+	stack[0].entry = entry;
+	std::copy(packedMin_, packedMin_ + 3, stack[0].min);
+	std::copy(packedMax_, packedMax_ + 3, stack[0].max);
+	top = 1;
+
+	// copy of the node we are pinned to
+	OctreeNode::Packed* packed = packed_;
+	Surface3D** surfaces = packedSurfaces_.data();
+
+	// pinned after the topology or the replication changed: no copy for that node
+	int node = WorkerPool::getCurrentNode();
+
+	if (node >= 0 && node < static_cast<int>(packedReplicas_.size()))
+	{
+		packed = packedReplicas_[node];
+		surfaces = surfaceReplicas_[node];
+	}
+
+	Surface3D* result = 0;
+
+	while (top > 0)
+	{
+		Entry current = stack[--top];
+
+		// a closer hit was found after pushing this node
+		if (current.entry > *dist)
+			continue;
+
+		OctreeNode::Packed& node = packed[current.node];
+
+		if (node.childCount == 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				Surface3D* surface = surfaces[i];
+
+				// already tested in another leaf
+				if (mailbox.wasTested(surface))
+					continue;
+
+				double temp = *dist;
+
+				if (surface->intersection(ray, &temp))
+				{
+					result = surface;
+					*dist = temp;
+
+					if (anyHit)
+						return result;
+				}
+			}
+
+			continue;
+		}
+
+		double step[3];
+
+		for (int a = 0; a < 3; a++)
+			step[a] = (current.max[a] - current.min[a]) / 255.0;
+
+		// children which are hit, sorted by distance (farthest first)
+		Entry hits[8];
+		int count = 0;
+
+		for (unsigned int c = 0; c < node.childCount; c++)
+		{
+			Entry child;
+			child.node = node.children + c;
+
+			for (int a = 0; a < 3; a++)
+			{
+				child.min[a] = current.min[a] + node.bounds[c][a] * step[a];
+				child.max[a] = current.min[a] + node.bounds[c][3 + a] * step[a];
+			}
+
+			if (!rayBoxIntersection(child.min, child.max, start, invDir, *dist, &child.entry))
+				continue;
+
+			int i = count++;
+
+			while (i > 0 && hits[i - 1].entry < child.entry)
+			{
+				hits[i] = hits[i - 1];
+				i--;
+			}
+
+			hits[i] = child;
+		}
+
+		for (int i = 0; i < count; i++)
+			stack[top++] = hits[i];
+	}
+
+	return result;
+}
+
+
+void Octree::setProxies(bool proxies)
+{
+	PROXIES = proxies;
+}
+
+
+void Octree::setReplication(bool replication)
+{
+	REPLICATION = replication;
 }
 
 
@@ -75,5 +579,8 @@ void Octree::clear()
 {
 	delete root_;
 	root_ = 0;
+	clearPacked();
 	setRootCenterAndSize();
+
+	MemoryBudget::update(MemoryBudget::OCTREE, memorySize_, getMemorySize());
 }
@@ -1,33 +1,129 @@
 #ifndef OCTREE_H_
 #define OCTREE_H_
 
-class OctreeNode;
-class Surface3D;
+#include <vector>
+#include <string>
+
+#include "Surface3D.h"
+#include "OctreeNode.h"
+
 class Ray;
 class Object3D;
+class Vector3D;
+class Mailbox;
 
 /*
 An octree consists of 8 sub octrees, stored within an octree node
 Octree only saves root node, getting an Object3D to figure out the bouncing values
+
+build() can also be used with a part of the object's triangles (i.e. only the
+visible ones), then the root node only surrounds these triangles
+
+If proxies are enabled (setProxies), build() also creates a VoxelProxy in each
+node, so rays with a cone can stop at nodes smaller than a pixel
+
+build() also packs the tree (see OctreeNode::pack) into one aligned array.
+Rays traverse the packed nodes, children in order of distance. Proxies
+and the proximity and collision queries use the octree nodes.
+
+On more than one NUMA node (see WorkerPool), the packed nodes and their
+triangle lists are copied to every node (setReplication, on by default) and
+rays of pinned workers traverse the copy of their node. Threads which aren't
+pinned (i.e. the raycaster's) use the original. Without affinity there are
+no copies. The triangles themselves stay where they are.
+
+build() reports the octree's memory to MemoryBudget. Over budget, it evicts
+textures first, then drops the copies per node, then leaves out the proxies
+and then removes levels.
 */
 
 class Octree
 {
 private:
+	static bool PROXIES;
+
+	// copy packed nodes to each NUMA node
+	static bool REPLICATION;
+
+	// node pairs per worker thread before collision tests start
+	static unsigned int COLLISION_PAIRS;
+
 	OctreeNode* root_;
 	Object3D* object_;
 
+	// proxies of this tree (PROXIES unless dropped by the memory budget)
+	bool proxies_;
+
+	// copies per node of this tree (REPLICATION unless dropped by the memory budget)
+	bool replication_;
+
+	// bytes reported to MemoryBudget
+	unsigned long long memorySize_;
+
+	// packed nodes (cache line aligned) and triangles of their leaves
+	OctreeNode::Packed* packed_;
+	unsigned int packedSize_;
+	std::vector<Surface3D*> packedSurfaces_;
+
+	// packed nodes and triangle lists of each NUMA node (empty on one node)
+	std::vector<OctreeNode::Packed*> packedReplicas_;
+	std::vector<Surface3D**> surfaceReplicas_;
+
+	// decoded bounds of packed root
+	double packedMin_[3];
+	double packedMax_[3];
+
 	Octree(const Octree& src);
 
 	void setRootCenterAndSize();
+	void setRootCenterAndSize(std::vector<Surface3D*>& surfaces);
+
+	// build nodes with at most levelMax levels, proxies and packed nodes
+	void buildNodes(std::vector<Surface3D*>& surfaces, unsigned int levelMax);
+
+	void pack();
+	void replicate();
+	void clearPacked();
+
+	Surface3D* packedIntersection(Ray& ray, double* dist, Mailbox& mailbox, bool anyHit);
 public:
 	Octree(Object3D* object);
 	virtual ~Octree();
 
-	Surface3D* intersection(Ray& ray, double* dist);
+	// closest surface (or any surface if anyHit is true) closer than dist
+	Surface3D* intersection(Ray& ray, double* dist, bool anyHit = false);
 	void addSurface(Surface3D* surface);
 
+	// closest surface to point within dist, saves new distance
+	// closest: point on surface (optional)
+	Surface3D* nearestSurface(Vector3D& point, double* dist, Vector3D* closest = 0);
+
+	// adds all surfaces touching the box (center, size = half edge length) or sphere
+	// to "result", each surface only once
+	void surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result);
+	void surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result);
+
+	// collision detection with another octree (dual traversal, parallel over node pairs)
+	// contacts: pairs of touching surfaces (this octree's surface first), each pair once
+	// anyContact: stop at first contact
+	// returns true if at least one pair of surfaces touches
+	bool collide(Octree& other, std::vector<SurfacePair>& contacts, bool anyContact = false);
+
+	// clear octree and add all surfaces, root node only surrounds "surfaces"
+	void build(std::vector<Surface3D*>& surfaces);
+
 	void clear();
+
+	// bytes of packed nodes and their triangle lists (with all copies)
+	unsigned long long getPackedSize();
+
+	// bytes of nodes, proxies and packed nodes
+	unsigned long long getMemorySize();
+
+	static void setProxies(bool proxies);
+
+	// for octrees built afterwards
+	static void setReplication(bool replication);
 };
 
 #endif
\ No newline at end of file
@@ -1,15 +1,23 @@
 #include "OctreeNode.h"
 #include "Surface3D.h"
+#include "Mailbox.h"
+#include "VoxelProxy.h"
+#include "Ray.h"
 
 #include <map>
+#include <queue>
+#include <functional>
+#include <algorithm>
 #include <iostream>
 
 unsigned int OctreeNode::LEVEL_MAX = 4;
 unsigned int OctreeNode::LIMIT_MAX = 10;
 
 OctreeNode::OctreeNode(Vector3D& center, Vector3D& size, unsigned int level, OctreeNode* parent) :
-center_(center), size_(size), level_(level), parent_(parent)
+center_(center), size_(size), level_(level), parent_(parent), limitReached_(false), proxy_(0)
 {
+	levelMax_ = parent_ ? parent_->levelMax_ : LEVEL_MAX;
+
 	double x = center_.getX();
 	double y = center_.getY();
 	double z = center_.getZ();
@@ -37,25 +45,56 @@ OctreeNode::~OctreeNode()
 		if (child_[i])
 			delete child_[i];
 	}
+
+	if (proxy_)
+		delete proxy_;
 }
 
 
-Surface3D* OctreeNode::intersection(Ray& ray, double* dist)
+Surface3D* OctreeNode::intersection(Ray& ray, double* dist, Mailbox* mailbox, bool anyHit)
 {
 	Surface3D* result = 0;
 	Vector3D halfSize = size_ / 2.0;
 
 	if (Mathtools::rayAABBIntersection(ray, center_, size_, *dist))
 	{
-		if (!limitReached_ || level_ == LEVEL_MAX)
+		// node smaller than ray cone: proxy is enough
+		if (proxy_ && ray.getSpread() > 0.0 && proxy_->isSolid())
+		{
+			Vector3D toCenter = center_ - ray.getStart();
+			Vector3D dir = ray.getDirection();
+			double t = Mathtools::dot(toCenter, dir);
+
+			if (t > 0.0 && 2.0 * size_.length() < ray.getFootprint(t))
+			{
+				// proxy triangle is parallel to ray, use triangles
+				double temp = *dist;
+				Surface3D* proxySurface = proxy_->intersection(ray, &temp);
+
+				if (proxySurface)
+				{
+					*dist = temp;
+					return proxySurface;
+				}
+			}
+		}
+
+		if (!limitReached_ || level_ == levelMax_)
 		{
 			for (Surface3D* surface : list_)
 			{
+				// already tested in another leaf
+				if (mailbox && mailbox->wasTested(surface))
+					continue;
+
 				double temp = *dist;
 				if (surface->intersection(ray, &temp))
 				{
 					result = surface;
 					*dist = temp;
+
+					if (anyHit)
+						return result;
 				}
 			}
 		}
@@ -78,10 +117,13 @@ Surface3D* OctreeNode::intersection(Ray& ray, double* dist)
 
 				if (child_[index])
 				{
-					Surface3D* tempResult = child_[index]->intersection(ray, dist);
+					Surface3D* tempResult = child_[index]->intersection(ray, dist, mailbox, anyHit);
 					if (tempResult)
 					{
 						result = tempResult;
+
+						if (anyHit)
+							return result;
 					}
 				}
 			}
@@ -95,11 +137,11 @@ void OctreeNode::addSurface(Surface3D* surface)
 {
 	Vector3D halfSize = size_ / 2.0;
 
-	if (!limitReached_ || level_ == LEVEL_MAX)
+	if (!limitReached_ || level_ == levelMax_)
 	{
 		list_.push_back(surface);
 
-		if (list_.size() >= LIMIT_MAX && level_ < LEVEL_MAX)
+		if (list_.size() >= LIMIT_MAX && level_ < levelMax_)
 		{
 			limitReached_ = true;
 			for (Surface3D* tri : list_)
@@ -144,9 +186,429 @@ void OctreeNode::addSurface(Surface3D* surface)
 }
 
 
+bool OctreeNode::isLeaf()
+{
+	return !limitReached_ || level_ == levelMax_;
+}
+
+
+Surface3D* OctreeNode::nearestSurface(Vector3D& point, double* distSq, Vector3D* closest, Mailbox* mailbox)
+{
+	Surface3D* result = 0;
+
+	// nodes ordered by distance to point, closest first
+	typedef std::pair<double, OctreeNode*> NodeDistance;
+	std::priority_queue<NodeDistance, std::vector<NodeDistance>, std::greater<NodeDistance> > queue;
+
+	queue.push(NodeDistance(Mathtools::pointAABBSquaredDistance(point, center_, size_), this));
+
+	while (!queue.empty())
+	{
+		NodeDistance next = queue.top();
+		queue.pop();
+
+		// every node left is farther away than closest triangle
+		// (triangles parts outside of a leaf are stored in the neighbour leaves)
+		if (next.first >= *distSq)
+			break;
+
+		OctreeNode* node = next.second;
+
+		if (node->isLeaf())
+		{
+			for (Surface3D* surface : node->list_)
+			{
+				if (mailbox && mailbox->wasTested(surface))
+					continue;
+
+				Vector3D p = Mathtools::closestPointOnTriangle(point, *surface->getP0(), *surface->getP1(), *surface->getP2());
+				Vector3D d = p - point;
+				double temp = Mathtools::dot(d, d);
+
+				if (temp < *distSq)
+				{
+					*distSq = temp;
+					result = surface;
+
+					if (closest)
+						closest->setVector(p);
+				}
+			}
+		}
+		else
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				OctreeNode* child = node->child_[i];
+
+				if (!child)
+					continue;
+
+				double temp = Mathtools::pointAABBSquaredDistance(point, child->center_, child->size_);
+
+				if (temp < *distSq)
+					queue.push(NodeDistance(temp, child));
+			}
+		}
+	}
+
+	return result;
+}
+
+
+void OctreeNode::surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result)
+{
+	if (!Mathtools::AABBOverlap(center_, size_, center, size))
+		return;
+
+	if (isLeaf())
+	{
+		result.insert(result.end(), list_.begin(), list_.end());
+		return;
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (child_[i])
+			child_[i]->surfacesInBox(center, size, result);
+	}
+}
+
+
+void OctreeNode::surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result)
+{
+	if (Mathtools::pointAABBSquaredDistance(center, center_, size_) > radius * radius)
+		return;
+
+	if (isLeaf())
+	{
+		result.insert(result.end(), list_.begin(), list_.end());
+		return;
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (child_[i])
+			child_[i]->surfacesInSphere(center, radius, result);
+	}
+}
+
+
+bool OctreeNode::overlap(OctreeNode* a, OctreeNode* b)
+{
+	return Mathtools::AABBOverlap(a->center_, a->size_, b->center_, b->size_);
+}
+
+
+bool OctreeNode::splitPair(OctreeNode* a, OctreeNode* b, std::vector<NodePair>& pairs)
+{
+	bool splitA = !a->isLeaf();
+	bool splitB = !b->isLeaf();
+
+	if (!splitA && !splitB)
+		return false;
+
+	// split the larger one if both have children
+	if (splitA && splitB)
+	{
+		if (a->size_.length() >= b->size_.length())
+			splitB = false;
+		else
+			splitA = false;
+	}
+
+	OctreeNode* node = splitA ? a : b;
+
+	for (int i = 0; i < 8; i++)
+	{
+		OctreeNode* child = node->child_[i];
+
+		if (!child)
+			continue;
+
+		NodePair pair = splitA ? NodePair(child, b) : NodePair(a, child);
+
+		if (overlap(pair.first, pair.second))
+			pairs.push_back(pair);
+	}
+
+	return true;
+}
+
+
+void OctreeNode::collide(OctreeNode* a, OctreeNode* b, std::vector<SurfacePair>& contacts, bool anyContact, std::atomic<bool>& found)
+{
+	if (anyContact && found)
+		return;
+
+	std::vector<NodePair> pairs;
+
+	if (!splitPair(a, b, pairs))
+	{
+		collideLeaves(a, b, contacts, anyContact, found);
+		return;
+	}
+
+	for (NodePair& pair : pairs)
+	{
+		collide(pair.first, pair.second, contacts, anyContact, found);
+	}
+}
+
+
+void OctreeNode::collideLeaves(OctreeNode* a, OctreeNode* b, std::vector<SurfacePair>& contacts, bool anyContact, std::atomic<bool>& found)
+{
+	for (Surface3D* sa : a->list_)
+	{
+		Vector3D& a0 = *sa->getP0();
+		Vector3D& a1 = *sa->getP1();
+		Vector3D& a2 = *sa->getP2();
+
+		// triangle outside of other leaf can't touch its triangles there
+		// (other parts are tested in other leaf pairs)
+		if (!Mathtools::triangleInsideAABB(a0, a1, a2, b->center_, b->size_))
+			continue;
+
+		for (Surface3D* sb : b->list_)
+		{
+			if (Mathtools::triangleTriangleIntersection(a0, a1, a2, *sb->getP0(), *sb->getP1(), *sb->getP2()))
+			{
+				contacts.push_back(SurfacePair(sa, sb));
+
+				if (anyContact)
+				{
+					found = true;
+					return;
+				}
+			}
+		}
+	}
+}
+
+
+void OctreeNode::buildProxies(std::vector<Surface3D*>& surfaces)
+{
+	std::vector<Surface3D*> own;
+
+	if (!limitReached_ || level_ == levelMax_)
+	{
+		own = list_;
+	}
+	else
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			if (child_[i])
+				child_[i]->buildProxies(own);
+		}
+
+		// children share triangles, each one should be counted once
+		std::sort(own.begin(), own.end());
+		own.erase(std::unique(own.begin(), own.end()), own.end());
+	}
+
+	if (proxy_)
+		delete proxy_;
+
+	proxy_ = own.empty() ? 0 : new VoxelProxy(own, center_, size_);
+
+	surfaces.insert(surfaces.end(), own.begin(), own.end());
+}
+
+
+void OctreeNode::capLevels(unsigned int levelMax)
+{
+	levelMax_ = levelMax;
+}
+
+
+unsigned long long OctreeNode::getMemorySize()
+{
+	unsigned long long size = sizeof(OctreeNode) + list_.capacity() * sizeof(Surface3D*);
+
+	// proxies own two triangles
+	if (proxy_)
+		size += sizeof(VoxelProxy) + 2 * sizeof(Surface3D);
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (child_[i])
+			size += child_[i]->getMemorySize();
+	}
+
+	return size;
+}
+
+
+bool OctreeNode::tightBounds(double* min, double* max)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		min[a] = Mathtools::INF;
+		max[a] = -Mathtools::INF;
+	}
+
+	bool found = false;
+
+	if (isLeaf())
+	{
+		found = !list_.empty();
+
+		for (Surface3D* surface : list_)
+		{
+			Vector3D* points[3] = { surface->getP0(), surface->getP1(), surface->getP2() };
+
+			for (Vector3D* p : points)
+			{
+				double v[3] = { p->getX(), p->getY(), p->getZ() };
+
+				for (int a = 0; a < 3; a++)
+				{
+					min[a] = Mathtools::min(min[a], v[a]);
+					max[a] = Mathtools::max(max[a], v[a]);
+				}
+			}
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			if (!child_[i])
+				continue;
+
+			double childMin[3], childMax[3];
+
+			if (!child_[i]->tightBounds(childMin, childMax))
+				continue;
+
+			found = true;
+
+			for (int a = 0; a < 3; a++)
+			{
+				min[a] = Mathtools::min(min[a], childMin[a]);
+				max[a] = Mathtools::max(max[a], childMax[a]);
+			}
+		}
+	}
+
+	// triangle parts outside of the cube are found in neighbour nodes
+	double center[3] = { center_.getX(), center_.getY(), center_.getZ() };
+	double size[3] = { size_.getX(), size_.getY(), size_.getZ() };
+
+	// no triangles: a point instead of infinite bounds (they can't be quantized)
+	if (!found)
+	{
+		for (int a = 0; a < 3; a++)
+			min[a] = max[a] = center[a];
+
+		return false;
+	}
+
+	for (int a = 0; a < 3; a++)
+	{
+		min[a] = Mathtools::max(min[a], center[a] - size[a]) - Mathtools::EPSILON;
+		max[a] = Mathtools::min(max[a], center[a] + size[a]) + Mathtools::EPSILON;
+
+		if (min[a] > max[a])
+			max[a] = min[a];
+	}
+
+	return true;
+}
+
+
+void OctreeNode::pack(std::vector<Packed>& nodes, unsigned int index, double* min, double* max, std::vector<Surface3D*>& surfaces)
+{
+	nodes[index].childCount = 0;
+	nodes[index].children = 0;
+	nodes[index].first = 0;
+	nodes[index].count = 0;
+
+	if (isLeaf())
+	{
+		nodes[index].first = surfaces.size();
+		nodes[index].count = list_.size();
+		surfaces.insert(surfaces.end(), list_.begin(), list_.end());
+		return;
+	}
+
+	// children with triangles and their bounds
+	std::vector<OctreeNode*> children;
+	std::vector<double> bounds;
+
+	for (int i = 0; i < 8; i++)
+	{
+		double childMin[3], childMax[3];
+
+		if (!child_[i] || !child_[i]->tightBounds(childMin, childMax))
+			continue;
+
+		children.push_back(child_[i]);
+		bounds.insert(bounds.end(), childMin, childMin + 3);
+		bounds.insert(bounds.end(), childMax, childMax + 3);
+	}
+
+	unsigned int first = nodes.size();
+	nodes.resize(first + children.size());
+
+	nodes[index].children = first;
+	nodes[index].childCount = static_cast<unsigned char>(children.size());
+
+	double step[3];
+
+	for (int a = 0; a < 3; a++)
+		step[a] = (max[a] - min[a]) / 255.0;
+
+	for (unsigned int c = 0; c < children.size(); c++)
+	{
+		double* childMin = &bounds[6 * c];
+		double* childMax = &bounds[6 * c + 3];
+
+		double decodedMin[3], decodedMax[3];
+
+		for (int a = 0; a < 3; a++)
+		{
+			int low = 0;
+			int high = 255;
+
+			if (step[a] > 0.0)
+			{
+				low = static_cast<int>(floor((childMin[a] - min[a]) / step[a]));
+				high = static_cast<int>(ceil((childMax[a] - min[a]) / step[a]));
+
+				low = std::max(0, std::min(255, low));
+				high = std::max(0, std::min(255, high));
+
+				// decoded bounds must contain the exact ones
+				while (low > 0 && min[a] + low * step[a] > childMin[a])
+					low--;
+
+				while (high < 255 && min[a] + high * step[a] < childMax[a])
+					high++;
+			}
+
+			nodes[index].bounds[c][a] = static_cast<unsigned char>(low);
+			nodes[index].bounds[c][3 + a] = static_cast<unsigned char>(high);
+
+			decodedMin[a] = min[a] + low * step[a];
+			decodedMax[a] = min[a] + high * step[a];
+		}
+
+		children[c]->pack(nodes, first + c, decodedMin, decodedMax, surfaces);
+	}
+}
+
+
+unsigned int OctreeNode::getLevelMax()
+{
+	return LEVEL_MAX;
+}
+
+
 void OctreeNode::setLevelMax(unsigned int levelMax)
 {
-	LEVEL_MAX = levelMax;
+	LEVEL_MAX = levelMax < LEVEL_MAX_LIMIT ? levelMax : LEVEL_MAX_LIMIT;
 }
 
 
@@ -2,11 +2,15 @@
 #define OCTREENODE_H_
 
 #include <vector>
+#include <atomic>
 
 #include "Mathtools.h"
+#include "Surface3D.h"
 
-class Surface3D;
 class Ray;
+class Vector3D;
+class Mailbox;
+class VoxelProxy;
 
 /*
 An Octree node is an AABB (Axis-Aligned Bounding Box).
@@ -21,11 +25,50 @@ this node's level_ is equal to LEVEL_MAX, then LIMIT_MAX is ignored
 If LIMIT_MAX is reached, limitReached_ will become true and distributes list_'s
 content to the 8 child nodes according to their positionings.
 
-A Surface3D can be stored in more than one child node if the size is too large
+A Surface3D can be stored in more than one child node if the size is too large.
+intersection() can get a Mailbox to skip these duplicates within one ray
+
+With buildProxies(), every node stores a VoxelProxy of all its triangles. A
+ray with a cone (Ray::getSpread) stops at the first node which is smaller
+than the cone's footprint and hits the proxy instead of the triangles.
+
+Proximity queries: nearestSurface() visits nodes best first (closest node to
+the point first) and stops as soon as the next node is farther away than the
+closest triangle found so far. Range queries collect the triangles of all
+leaves touching a box or sphere (duplicates included).
+All queries only read the tree, so they can run in parallel.
+
+Collision detection descends two trees at the same time: only pairs of
+overlapping nodes are followed (the larger node is split first) and only
+triangles of two overlapping leaves are tested against each other.
+
+pack() writes the tree into Packed nodes of 64 bytes (one cache line) for
+ray traversal. A packed node stores the bounds of its children's triangles
+(clipped to the child's cube) with 8 bits per axis, relative to its own
+bounds and rounded outwards. Empty parts of a cube are skipped that way,
+children without triangles are left out.
 */
 
 class OctreeNode
 {
+public:
+	typedef std::pair<OctreeNode*, OctreeNode*> NodePair;
+
+	// deepest level setLevelMax accepts: packed traversal keeps up to 7 siblings
+	// of each level on a fixed stack (see Octree::intersection)
+	static const unsigned int LEVEL_MAX_LIMIT = 32;
+
+	// children's bounds: parent min + q * (parent max - parent min) / 255
+	struct Packed
+	{
+		unsigned char bounds[8][6];    // min x, y, z, max x, y, z
+		unsigned int children;         // index of first child, the others follow
+		unsigned int first;            // leaf: triangles first to first + count - 1
+		unsigned int count;
+		unsigned char childCount;      // 0 = leaf
+		unsigned char unused[3];
+	};
+
 private:
 	static unsigned int LEVEL_MAX;
 	static unsigned int LIMIT_MAX;
@@ -37,17 +80,67 @@ private:
 
 	unsigned int level_;
 	OctreeNode* parent_;
+
+	// LEVEL_MAX unless the tree was capped (see capLevels)
+	unsigned int levelMax_;
 	OctreeNode* child_[8];
 
 	bool limitReached_;
 	std::vector<Surface3D*> list_;
+
+	// prefiltered triangles of this node and all children (optional)
+	VoxelProxy* proxy_;
+
+	// leaf nodes store triangles, other nodes only children
+	bool isLeaf();
+
+	// test all triangles of two leaves
+	static void collideLeaves(OctreeNode* a, OctreeNode* b, std::vector<SurfacePair>& contacts, bool anyContact, std::atomic<bool>& found);
 public:
 	OctreeNode(Vector3D& center, Vector3D& size, unsigned int level, OctreeNode* parent = 0);
 	virtual ~OctreeNode();
 
-	Surface3D* intersection(Ray& ray, double *dist);
+	// anyHit: return first hit closer than dist, not the closest one
+	Surface3D* intersection(Ray& ray, double *dist, Mailbox* mailbox = 0, bool anyHit = false);
 	void addSurface(Surface3D* surface);
 
+	// closest triangle to point, distSq: max squared distance, returns squared distance
+	// closest: point on triangle (optional)
+	Surface3D* nearestSurface(Vector3D& point, double* distSq, Vector3D* closest = 0, Mailbox* mailbox = 0);
+
+	// triangles of leaves touching the box (center, size = half edge length) or sphere
+	void surfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result);
+	void surfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result);
+
+	// replace node pair by its overlapping child pairs (split larger node)
+	// returns false if both nodes are leaves (nothing added)
+	static bool splitPair(OctreeNode* a, OctreeNode* b, std::vector<NodePair>& pairs);
+
+	// dual traversal, adds touching triangles of a and b to contacts
+	// any contact: stop all traversals as soon as "found" is true
+	static void collide(OctreeNode* a, OctreeNode* b, std::vector<SurfacePair>& contacts, bool anyContact, std::atomic<bool>& found);
+
+	static bool overlap(OctreeNode* a, OctreeNode* b);
+
+	// build proxies bottom up, adds all triangles of this node to "surfaces"
+	void buildProxies(std::vector<Surface3D*>& surfaces);
+
+	// root only, before surfaces are added: fewer levels than LEVEL_MAX
+	void capLevels(unsigned int levelMax);
+
+	// bytes of this node and all children (with proxies)
+	unsigned long long getMemorySize();
+
+	// bounds of this node's triangles, clipped to its cube
+	// false if the subtree has no triangles (min = max = center)
+	bool tightBounds(double* min, double* max);
+
+	// write subtree to nodes[index] (already added), min/max: decoded bounds of this node
+	// leaves' triangles are appended to "surfaces"
+	void pack(std::vector<Packed>& nodes, unsigned int index, double* min, double* max, std::vector<Surface3D*>& surfaces);
+
+	static unsigned int getLevelMax();
+	// at most LEVEL_MAX_LIMIT
 	static void setLevelMax(unsigned int levelMax);
 	static void setLimitMax(unsigned int limitMax);
 };
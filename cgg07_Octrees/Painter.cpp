@@ -4,7 +4,8 @@
 #include "Mathtools.h"
 
 
-Painter::Painter(Renderer* renderer) : renderer_(renderer), fill_(false)
+Painter::Painter(Renderer* renderer) : renderer_(renderer), fill_(false), clip_(false),
+clipX0_(0), clipY0_(0), clipX1_(0), clipY1_(0)
 {
 }
 
@@ -52,6 +53,29 @@ void Painter::setFiller(bool fill)
 	fill_ = fill;
 }
 
+void Painter::setClipArea(int x0, int y0, int x1, int y1)
+{
+	clip_ = true;
+	clipX0_ = x0;
+	clipY0_ = y0;
+	clipX1_ = x1;
+	clipY1_ = y1;
+}
+
+void Painter::removeClipArea()
+{
+	clip_ = false;
+}
+
+
+void Painter::colorPixel(int x, int y, Color& color)
+{
+	if (clip_ && (x < clipX0_ || x >= clipX1_ || y < clipY0_ || y >= clipY1_))
+		return;
+
+	renderer_->colorPixel(x, y, color);
+}
+
 // line drawing method which uses a color input
 // Bresenham's algorithm
 
@@ -96,7 +120,7 @@ void Painter::bresenham(int x1, int y1, int x2, int y2, Color color)
 	x = x1;
 	y = y1;
 	err = es / 2;
-	renderer_->colorPixel(x, y, color);
+	colorPixel(x, y, color);
 
 	/* calculate pixel */
 	for (t = 0; t < es; ++t) /* t zaehlt die Pixel, el ist auch Anzahl */
@@ -117,7 +141,7 @@ void Painter::bresenham(int x1, int y1, int x2, int y2, Color color)
 			x += pdx;
 			y += pdy;
 		}
-		renderer_->colorPixel(x, y, color);
+		colorPixel(x, y, color);
 	}
 }
 
@@ -212,10 +236,10 @@ void Painter::drawEllipse(int mx, int my, int rx, int ry)
 			lastDy = dy;
 		}
 
-		renderer_->colorPixel(mx + dx, my + dy, lineColor_);
-		renderer_->colorPixel(mx - dx, my + dy, lineColor_);
-		renderer_->colorPixel(mx - dx, my - dy, lineColor_);
-		renderer_->colorPixel(mx + dx, my - dy, lineColor_);
+		colorPixel(mx + dx, my + dy, lineColor_);
+		colorPixel(mx - dx, my + dy, lineColor_);
+		colorPixel(mx - dx, my - dy, lineColor_);
+		colorPixel(mx + dx, my - dy, lineColor_);
 
 		e2 = 2 * err;
 
@@ -234,8 +258,8 @@ void Painter::drawEllipse(int mx, int my, int rx, int ry)
 
 	while (dx++ < rx)
 	{
-		renderer_->colorPixel(mx + dx, my, lineColor_);
-		renderer_->colorPixel(mx - dx, my, lineColor_);
+		colorPixel(mx + dx, my, lineColor_);
+		colorPixel(mx - dx, my, lineColor_);
 	}
 }
 
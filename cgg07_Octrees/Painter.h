@@ -17,6 +17,14 @@ private:
 	Color fillColor_;
 	bool fill_;
 
+	// optional clip area (in pixels), nothing outside will be drawn
+	// used if several painters share one Renderer (i.e. one painter per tile)
+	bool clip_;
+	int clipX0_, clipY0_, clipX1_, clipY1_;
+
+	// color pixel if it's inside of clip area
+	void colorPixel(int x, int y, Color& color);
+
 	// method which draws lines with an color input
 	// Bresenham's algorithm
 	void bresenham(int x1, int y1, int x2, int y2, Color color);
@@ -35,6 +43,10 @@ public:
 
 	void setFiller(bool fill);
 
+	// x1 and y1 are exclusive
+	void setClipArea(int x0, int y0, int x1, int y1);
+	void removeClipArea();
+
 	// drawing a line
 	void drawLine(int x1, int y1, int x2, int y2);
 	void drawLine(Vector2D& p1, Vector2D& p2);
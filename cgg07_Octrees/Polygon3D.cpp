@@ -25,5 +25,5 @@ void Polygon3D::addPoint(Vector3D* point)
 
 void Polygon3D::addSurface(Surface3D* surface)
 {
-	triangles_.push_back(surface);
+	addTriangle(surface);
 }
\ No newline at end of file
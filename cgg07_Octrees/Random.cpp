@@ -0,0 +1,66 @@
+#include "Random.h"
+
+
+Random::Random(unsigned long long seed, unsigned long long stream)
+{
+	this->seed(seed, stream);
+}
+
+
+Random::Random(const Random& src) : state_(src.state_), increment_(src.increment_)
+{
+}
+
+
+Random::~Random()
+{
+}
+
+
+void Random::seed(unsigned long long seed, unsigned long long stream)
+{
+	// increment has to be odd
+	state_ = 0;
+	increment_ = (stream << 1) | 1;
+
+	nextUInt();
+	state_ += seed;
+	nextUInt();
+}
+
+
+unsigned long long Random::mix(unsigned long long a, unsigned long long b)
+{
+	unsigned long long z = a * 0x9e3779b97f4a7c15ULL + b;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z = z ^ (z >> 31);
+
+	// a second round, so a and b don't just add up
+	z = (z + a) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+}
+
+
+unsigned int Random::nextUInt()
+{
+	unsigned long long old = state_;
+	state_ = old * 6364136223846793005ULL + increment_;
+
+	// output permutation: xorshift and random rotation
+	unsigned int xorshifted = static_cast<unsigned int>(((old >> 18) ^ old) >> 27);
+	unsigned int rotation = static_cast<unsigned int>(old >> 59);
+
+	return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+
+double Random::nextDouble()
+{
+	// 2^-32
+	return nextUInt() * (1.0 / 4294967296.0);
+}
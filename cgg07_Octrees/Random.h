@@ -0,0 +1,38 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+/*
+Small and fast pseudo random number generator (PCG32, www.pcg-random.org)
+
+Each generator has its own state, so every pixel or thread can use its own
+one. The same seed and stream always give the same numbers, so renderings
+don't depend on the number of threads or the order of tiles.
+
+mix() combines two numbers into one seed (i.e. seed and pass), so nearby
+pairs like (1, 0) and (0, 1) still give unrelated sequences.
+*/
+
+class Random
+{
+private:
+	unsigned long long state_;
+	unsigned long long increment_;
+
+public:
+	// stream: independent sequences for the same seed (i.e. pixel index)
+	Random(unsigned long long seed = 0, unsigned long long stream = 0);
+	Random(const Random& src);
+	virtual ~Random();
+
+	void seed(unsigned long long seed, unsigned long long stream = 0);
+
+	// hash of a and b (SplitMix64 finalizer)
+	static unsigned long long mix(unsigned long long a, unsigned long long b);
+
+	unsigned int nextUInt();
+
+	// uniform in [0, 1)
+	double nextDouble();
+};
+
+#endif
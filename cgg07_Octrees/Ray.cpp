@@ -1,18 +1,18 @@
 #include "Ray.h"
 
 
-Ray::Ray()
+Ray::Ray() : spread_(0.0)
 {
 	direction_.setVector(0.0, 0.0, 1.0);
 }
 
 
-Ray::Ray(Vector3D& start, Vector3D& direction) : start_(start), direction_(direction)
+Ray::Ray(Vector3D& start, Vector3D& direction) : start_(start), direction_(direction), spread_(0.0)
 {
 }
 
 
-Ray::Ray(const Ray& src) : start_(src.start_), direction_(src.direction_)
+Ray::Ray(const Ray& src) : start_(src.start_), direction_(src.direction_), spread_(src.spread_)
 {
 }
 
@@ -51,6 +51,24 @@ Vector3D Ray::getDirection()
 }
 
 
+void Ray::setSpread(double spread)
+{
+	spread_ = spread;
+}
+
+
+double Ray::getSpread()
+{
+	return spread_;
+}
+
+
+double Ray::getFootprint(double t)
+{
+	return spread_ * t;
+}
+
+
 Vector3D Ray::getPoint(double t)
 {
 	return start_ + t * direction_;
@@ -6,6 +6,9 @@
 /*
 A ray is mainly used in Raycasting and Raytracing, but also finds usage in
 other rendering tools like Radiosity and Pathtracing
+
+A ray can optionally describe a cone (i.e. the part of the scene a pixel sees),
+spread is the cone's diameter per unit distance along the ray (0 = thin ray)
 */
 
 class Ray
@@ -13,6 +16,7 @@ class Ray
 private:
 	Vector3D start_;
 	Vector3D direction_;
+	double spread_;
 public:
 	Ray();
 	Ray(Vector3D& start, Vector3D& direction);
@@ -29,6 +33,12 @@ public:
 	Vector3D getStart();
 	Vector3D getDirection();
 
+	void setSpread(double spread);
+	double getSpread();
+
+	// cone diameter at distance t
+	double getFootprint(double t);
+
 	// calculate point by factor t
 	// point = start_ + t * direction_
 	Vector3D getPoint(double t);
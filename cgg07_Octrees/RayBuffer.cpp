@@ -0,0 +1,217 @@
+#include "RayBuffer.h"
+#include "Mathtools.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+unsigned int RayBuffer::GRID = 16;
+unsigned int RayBuffer::BATCH_SIZE = 256;
+
+
+RayBuffer::RayBuffer() : reordering_(true)
+{
+}
+
+
+RayBuffer::RayBuffer(const RayBuffer& src)
+{
+}
+
+
+RayBuffer::~RayBuffer()
+{
+}
+
+
+void RayBuffer::setGridSize(unsigned int grid)
+{
+	// the histogram has one counter per bin (8 * GRID^3)
+	if (grid > MAX_GRID)
+	{
+		std::cout << "RayBuffer: grid size " << grid << " is too large, at most " << MAX_GRID << std::endl;
+		return;
+	}
+
+	// Morton codes of cells have to stay below GRID^3: use power of 2
+	unsigned int size = 1;
+
+	while (size * 2 <= grid)
+		size *= 2;
+
+	GRID = size;
+}
+
+
+void RayBuffer::setBatchSize(unsigned int size)
+{
+	BATCH_SIZE = size > 0 ? size : 1;
+}
+
+
+void RayBuffer::setReordering(bool reordering)
+{
+	reordering_ = reordering;
+}
+
+
+void RayBuffer::addRay(Ray& ray, unsigned int owner)
+{
+	rays_.push_back(ray);
+	owners_.push_back(owner);
+}
+
+
+void RayBuffer::clear()
+{
+	rays_.clear();
+	owners_.clear();
+	hits_.clear();
+}
+
+
+unsigned int RayBuffer::getSize()
+{
+	return rays_.size();
+}
+
+
+void RayBuffer::createBatches(std::vector<unsigned int>& order, std::vector<unsigned int>& batches)
+{
+	unsigned int count = rays_.size();
+
+	// bounding box of all origins
+	double inf = static_cast<double>(INFINITY);
+	double min[3] = { inf, inf, inf };
+	double max[3] = { -inf, -inf, -inf };
+
+	for (Ray& ray : rays_)
+	{
+		Vector3D start = ray.getStart();
+		double p[3] = { start.getX(), start.getY(), start.getZ() };
+
+		for (int i = 0; i < 3; i++)
+		{
+			min[i] = Mathtools::min(min[i], p[i]);
+			max[i] = Mathtools::max(max[i], p[i]);
+		}
+	}
+
+	double scale[3];
+
+	for (int i = 0; i < 3; i++)
+		scale[i] = max[i] > min[i] ? (GRID - 0.5) / (max[i] - min[i]) : 0.0;
+
+	// bin = direction octant and Morton code of origin cell
+	unsigned int cells = GRID * GRID * GRID;
+	std::vector<unsigned int> bin(count);
+	std::vector<unsigned int> binSize(8 * cells + 1, 0);
+
+	for (unsigned int r = 0; r < count; r++)
+	{
+		Vector3D start = rays_[r].getStart();
+		Vector3D dir = rays_[r].getDirection();
+
+		unsigned int x = static_cast<unsigned int>((start.getX() - min[0]) * scale[0]);
+		unsigned int y = static_cast<unsigned int>((start.getY() - min[1]) * scale[1]);
+		unsigned int z = static_cast<unsigned int>((start.getZ() - min[2]) * scale[2]);
+
+		unsigned int octant = (dir.getX() < 0.0 ? 4 : 0) | (dir.getY() < 0.0 ? 2 : 0) | (dir.getZ() < 0.0 ? 1 : 0);
+
+		bin[r] = octant * cells + Mathtools::mortonCode(x, y, z);
+		binSize[bin[r] + 1]++;
+	}
+
+	// counting sort: first index of each bin
+	for (unsigned int b = 1; b < binSize.size(); b++)
+		binSize[b] += binSize[b - 1];
+
+	std::vector<unsigned int> next(binSize.begin(), binSize.end() - 1);
+	order.resize(count);
+
+	for (unsigned int r = 0; r < count; r++)
+		order[next[bin[r]]++] = r;
+
+	// batches: neighbouring bins put together until there are BATCH_SIZE rays
+	// (larger runs are split into parts of BATCH_SIZE rays)
+	batches.clear();
+	unsigned int batchStart = 0;
+
+	for (unsigned int b = 1; b < binSize.size(); b++)
+	{
+		unsigned int binEnd = binSize[b];
+
+		if (binEnd - batchStart >= BATCH_SIZE)
+		{
+			for (unsigned int start = batchStart; start < binEnd; start += BATCH_SIZE)
+				batches.push_back(start);
+
+			batchStart = binEnd;
+		}
+	}
+
+	if (batchStart < count)
+		batches.push_back(batchStart);
+}
+
+
+void RayBuffer::trace(Scene3D& scene, Scene3D::RayQuery query, double maxDist)
+{
+	unsigned int count = rays_.size();
+	hits_.resize(count);
+
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> batches;
+
+	if (reordering_)
+	{
+		createBatches(order, batches);
+	}
+	else
+	{
+		order.resize(count);
+
+		for (unsigned int r = 0; r < count; r++)
+			order[r] = r;
+
+		for (unsigned int r = 0; r < count; r += BATCH_SIZE)
+			batches.push_back(r);
+	}
+
+	WorkerPool::run(batches.size(), [&](unsigned int batch, unsigned int worker)
+	{
+		unsigned int end = batch + 1 < batches.size() ? batches[batch + 1] : count;
+
+		for (unsigned int i = batches[batch]; i < end; i++)
+		{
+			unsigned int index = order[i];
+			double dist = maxDist;
+			Surface3D* surface;
+
+			if (query == Scene3D::ANY_HIT)
+				surface = scene.getAnySurfaceAtRay(rays_[index], &dist);
+			else
+				surface = scene.getClosestSurfaceAtRay(rays_[index], &dist);
+
+			hits_[index].setHit(surface, dist);
+		}
+	});
+}
+
+
+Ray& RayBuffer::getRay(unsigned int index)
+{
+	return rays_[index];
+}
+
+
+unsigned int RayBuffer::getOwner(unsigned int index)
+{
+	return owners_[index];
+}
+
+
+RayHit& RayBuffer::getHit(unsigned int index)
+{
+	return hits_[index];
+}
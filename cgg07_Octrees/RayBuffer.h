@@ -0,0 +1,70 @@
+#ifndef RAYBUFFER_H_
+#define RAYBUFFER_H_
+
+#include <vector>
+
+#include "Ray.h"
+#include "RayHit.h"
+#include "Scene3D.h"
+
+/*
+A RayBuffer collects secondary rays (reflections, ambient occlusion, bounces)
+and traces all of them at once
+
+Secondary rays point in all directions. Traced in pixel order, two rays
+after each other visit different parts of the octrees. trace() sorts the rays
+into bins first: same direction octant and same origin cell (the origins'
+bounding box is split into GRID x GRID x GRID cells, ordered by Morton code).
+Neighbouring bins are put together into batches of about BATCH_SIZE rays,
+and the WorkerPool traces the batches in parallel.
+
+Each ray has an owner (i.e. a pixel index) to find out where the hit belongs.
+Hits are stored in the order the rays were added.
+*/
+
+class RayBuffer
+{
+private:
+	// origin cells per axis (power of 2, at most MAX_GRID)
+	static unsigned int GRID;
+
+	// 8 octants x 64^3 cells: 2M bins, 8 MB of counters per trace()
+	static const unsigned int MAX_GRID = 64;
+	static unsigned int BATCH_SIZE;
+
+	std::vector<Ray> rays_;
+	std::vector<unsigned int> owners_;
+	std::vector<RayHit> hits_;
+
+	bool reordering_;
+
+	// ray indices sorted by bin, batches[i] is first ray of batch i
+	void createBatches(std::vector<unsigned int>& order, std::vector<unsigned int>& batches);
+
+	RayBuffer(const RayBuffer& src);
+
+public:
+	RayBuffer();
+	virtual ~RayBuffer();
+
+	// rounded down to a power of 2, sizes above MAX_GRID are rejected
+	static void setGridSize(unsigned int grid);
+	static void setBatchSize(unsigned int size);
+
+	// off: trace rays in the order they were added (i.e. to compare)
+	void setReordering(bool reordering);
+
+	void addRay(Ray& ray, unsigned int owner);
+	void clear();
+
+	unsigned int getSize();
+
+	// trace all rays, results with getHit()
+	void trace(Scene3D& scene, Scene3D::RayQuery query = Scene3D::CLOSEST_HIT, double maxDist = static_cast<double>(INFINITY));
+
+	Ray& getRay(unsigned int index);
+	unsigned int getOwner(unsigned int index);
+	RayHit& getHit(unsigned int index);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "RayHit.h"
+#include "Mathtools.h"
+
+
+RayHit::RayHit() : surface_(0), distance_(Mathtools::INF)
+{
+}
+
+
+RayHit::RayHit(Surface3D* surface, double distance) : surface_(surface), distance_(distance)
+{
+}
+
+
+RayHit::RayHit(const RayHit& src) : surface_(src.surface_), distance_(src.distance_)
+{
+}
+
+
+RayHit::~RayHit()
+{
+}
+
+
+void RayHit::operator=(const RayHit& src)
+{
+	surface_ = src.surface_;
+	distance_ = src.distance_;
+}
+
+
+void RayHit::setHit(Surface3D* surface, double distance)
+{
+	surface_ = surface;
+	distance_ = distance;
+}
+
+
+bool RayHit::isHit()
+{
+	return surface_ != 0;
+}
+
+
+Surface3D* RayHit::getSurface()
+{
+	return surface_;
+}
+
+
+double RayHit::getDistance()
+{
+	return distance_;
+}
@@ -0,0 +1,34 @@
+#ifndef RAYHIT_H_
+#define RAYHIT_H_
+
+class Surface3D;
+
+/*
+Result of a ray query: the surface which was hit and the distance along the
+ray (in units of the ray's direction). If nothing was hit, surface is NULL and
+distance is the query's max distance.
+*/
+
+class RayHit
+{
+private:
+	Surface3D* surface_;
+	double distance_;
+
+public:
+	RayHit();
+	RayHit(Surface3D* surface, double distance);
+	RayHit(const RayHit& src);
+	virtual ~RayHit();
+
+	void operator=(const RayHit& src);
+
+	void setHit(Surface3D* surface, double distance);
+
+	bool isHit();
+
+	Surface3D* getSurface();
+	double getDistance();
+};
+
+#endif
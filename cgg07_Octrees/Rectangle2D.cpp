@@ -41,4 +41,57 @@ void Rectangle2D::initialize()
 
 	triangles_.push_back(new Surface2D(points_[0], points_[1], points_[3], &fillColor_));
 	triangles_.push_back(new Surface2D(points_[1], points_[2], points_[3], &fillColor_));
-}
\ No newline at end of file
+}
+
+
+// analytic shape -------------------------------------------------------------
+
+bool Rectangle2D::isAnalytic()
+{
+	return true;
+}
+
+
+void Rectangle2D::getLocalBounds(double* minX, double* minY, double* maxX, double* maxY)
+{
+	*minX = -width_ / 2.0;
+	*minY = -height_ / 2.0;
+	*maxX = width_ / 2.0;
+	*maxY = height_ / 2.0;
+}
+
+
+// clip line against both slabs -w/2 <= x <= w/2 and -h/2 <= y <= h/2
+
+bool Rectangle2D::getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax)
+{
+	double o[2] = { origin.getX(), origin.getY() };
+	double d[2] = { step.getX(), step.getY() };
+	double half[2] = { width_ / 2.0, height_ / 2.0 };
+
+	*tMin = -Mathtools::INF;
+	*tMax = Mathtools::INF;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (d[i] == 0.0)
+		{
+			// parallel to slab, completely inside or outside
+			if (o[i] < -half[i] || o[i] > half[i])
+				return false;
+
+			continue;
+		}
+
+		double t0 = (-half[i] - o[i]) / d[i];
+		double t1 = ( half[i] - o[i]) / d[i];
+
+		if (t0 > t1)
+			std::swap(t0, t1);
+
+		*tMin = Mathtools::max(*tMin, t0);
+		*tMax = Mathtools::min(*tMax, t1);
+	}
+
+	return *tMin <= *tMax;
+}
@@ -8,6 +8,8 @@ A rectangle has 2 edges of length "width" and 2 edges of length "height"
 they are perpendicular to the anchored edges
 
 initialize creates 4 points and 4 edges
+
+analytic shape: |x| <= width / 2 and |y| <= height / 2 (object space)
 */
 
 class Rectangle2D : public Object2D
@@ -25,6 +27,11 @@ public:
 	Rectangle2D();
 	Rectangle2D(double width, double height);
 	virtual ~Rectangle2D();
+
+	// analytic shape description
+	virtual bool isAnalytic();
+	virtual void getLocalBounds(double* minX, double* minY, double* maxX, double* maxY);
+	virtual bool getLocalSpan(Vector2D& origin, Vector2D& step, double* tMin, double* tMax);
 };
 
 #endif
\ No newline at end of file
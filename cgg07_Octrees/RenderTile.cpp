@@ -0,0 +1,49 @@
+#include "RenderTile.h"
+
+
+RenderTile::RenderTile(int x0, int y0, int x1, int y1) : x0_(x0), y0_(y0), x1_(x1), y1_(y1)
+{
+}
+
+
+RenderTile::~RenderTile()
+{
+}
+
+
+int RenderTile::getX0()
+{
+	return x0_;
+}
+
+int RenderTile::getY0()
+{
+	return y0_;
+}
+
+int RenderTile::getX1()
+{
+	return x1_;
+}
+
+int RenderTile::getY1()
+{
+	return y1_;
+}
+
+
+int RenderTile::getWidth()
+{
+	return x1_ - x0_;
+}
+
+int RenderTile::getHeight()
+{
+	return y1_ - y0_;
+}
+
+
+bool RenderTile::contains(int x, int y)
+{
+	return x >= x0_ && x < x1_ && y >= y0_ && y < y1_;
+}
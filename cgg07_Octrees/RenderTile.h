@@ -0,0 +1,33 @@
+#ifndef RENDERTILE_H_
+#define RENDERTILE_H_
+
+/*
+A render tile is a rectangular part of the screen (in pixels)
+
+Renderers split their screen into tiles and let the WorkerPool draw them in
+parallel. Tiles never overlap, so each pixel belongs to exactly one tile.
+x1 and y1 are exclusive (first column/row which doesn't belong to the tile).
+*/
+
+class RenderTile
+{
+private:
+	int x0_, y0_;
+	int x1_, y1_;
+
+public:
+	RenderTile(int x0, int y0, int x1, int y1);
+	virtual ~RenderTile();
+
+	int getX0();
+	int getY0();
+	int getX1();
+	int getY1();
+
+	int getWidth();
+	int getHeight();
+
+	bool contains(int x, int y);
+};
+
+#endif
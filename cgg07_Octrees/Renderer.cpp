@@ -2,16 +2,21 @@
 #include "Color.h"
 #include "Image.h"
 #include "Mathtools.h"
+#include "WorkerPool.h"
 
 #include <iostream>
+#include <algorithm>
+#include <new>
 
+bool Renderer::PLANAR_COLORS = false;
 
-Renderer::Renderer() : buffer_(0), width_(640), height_(480)
+
+Renderer::Renderer(bool tiled) : tiled_(tiled), buffer_(0), width_(640), height_(480), planes_(0)
 {
 	initBuffer();
 }
 
-Renderer::Renderer(const int width, const int height) : buffer_(0), width_(std::abs(width)), height_(std::abs(height))
+Renderer::Renderer(const int width, const int height, bool tiled) : tiled_(tiled), buffer_(0), width_(std::abs(width)), height_(std::abs(height)), planes_(0)
 {
 	initBuffer();
 }
@@ -19,17 +24,16 @@ Renderer::Renderer(const int width, const int height) : buffer_(0), width_(std::
 
 Renderer::~Renderer()
 {
-	delete[] buffer_;
+	freeBuffer();
 }
 
+// rows follow each other: one span covers the whole buffer
+
 void Renderer::setBackgroundColor(Color& color)
 {
 	backgroundColor_.setColor(color);
 
-	for (int i = 0; i < width_*height_; i++)
-	{
-		buffer_[i].setColor(color);
-	}
+	fillSpan(0, 0, width_ * height_, backgroundColor_);
 }
 
 
@@ -37,10 +41,7 @@ void Renderer::setBackgroundColor(float r, float g, float b)
 {
 	backgroundColor_.setColor(r, g, b);
 
-	for (int i = 0; i < width_*height_; i++)
-	{
-		buffer_[i].setColor(r, g, b);
-	}
+	fillSpan(0, 0, width_ * height_, backgroundColor_);
 }
 
 
@@ -48,19 +49,72 @@ void Renderer::setBackgroundColor(int colorcode)
 {
 	backgroundColor_.setColor(colorcode);
 
-	for (int i = 0; i < width_*height_; i++)
+	fillSpan(0, 0, width_ * height_, backgroundColor_);
+}
+
+
+void Renderer::initBuffer()
+{
+	freeBuffer();
+
+	int pixels = width_ * height_;
+
+	// memory only, pages are placed when they are written first
+	if (PLANAR_COLORS)
+		planes_ = new float[3 * pixels];
+	else
+		buffer_ = static_cast<Color*>(::operator new(pixels * sizeof(Color)));
+
+	// planes start black like Colors
+	touchRows([&](int y)
 	{
-		buffer_[i].setColor(colorcode);
+		int first = Mathtools::pixelIndex(width_, y, 0);
+
+		if (buffer_)
+		{
+			for (int x = 0; x < width_; x++)
+				new (buffer_ + first + x) Color();
+
+			return;
+		}
+
+		for (int c = 0; c < 3; c++)
+			std::fill(planes_ + c * pixels + first, planes_ + c * pixels + first + width_, 0.0f);
+	});
+}
+
+
+void Renderer::touchRows(std::function<void(int)> touch)
+{
+	if (!tiled_)
+	{
+		for (int y = 0; y < height_; y++)
+			touch(y);
+
+		return;
 	}
+
+	WorkerPool::run(height_, [&](unsigned int y, unsigned int worker)
+	{
+		touch(y);
+	});
 }
 
 
-void Renderer::initBuffer()
+void Renderer::freeBuffer()
 {
 	if (buffer_)
-		delete[] buffer_;
+	{
+		for (int i = 0; i < width_ * height_; i++)
+			buffer_[i].~Color();
+
+		::operator delete(buffer_);
+	}
+
+	delete[] planes_;
 
-	buffer_ = new Color[width_*height_];
+	buffer_ = 0;
+	planes_ = 0;
 }
 
 
@@ -69,20 +123,154 @@ void Renderer::colorPixel(int x, int y, Color color)
 	if (x < 0 || x >= width_ || y < 0 || y >= height_)
 		return;
 
-	getColor(x, y)->setColor(color);
+	writeSpan(x, y, 1, &color);
 }
 
 
 Color* Renderer::getColor(int x, int y)
 {
-	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	if (!buffer_ || x < 0 || x >= width_ || y < 0 || y >= height_)
 		return 0;
 
 	return &buffer_[Mathtools::pixelIndex(width_, y, x)];
 }
 
 
+void Renderer::writeSpan(int x, int y, int count, Color* colors)
+{
+	int first = Mathtools::pixelIndex(width_, y, x);
+
+	if (buffer_)
+	{
+		Color* row = buffer_ + first;
+
+		for (int i = 0; i < count; i++)
+			row[i].setColor(colors[i]);
+
+		return;
+	}
+
+	int pixels = width_ * height_;
+	float* red = planes_ + first;
+	float* green = red + pixels;
+	float* blue = green + pixels;
+
+	for (int i = 0; i < count; i++)
+	{
+		red[i] = colors[i].getRed();
+		green[i] = colors[i].getGreen();
+		blue[i] = colors[i].getBlue();
+	}
+}
+
+
+void Renderer::fillSpan(int x, int y, int count, Color& color)
+{
+	int first = Mathtools::pixelIndex(width_, y, x);
+
+	if (buffer_)
+	{
+		Color* row = buffer_ + first;
+
+		for (int i = 0; i < count; i++)
+			row[i].setColor(color);
+
+		return;
+	}
+
+	int pixels = width_ * height_;
+	float channels[3] = { color.getRed(), color.getGreen(), color.getBlue() };
+
+	for (int c = 0; c < 3; c++)
+	{
+		float* plane = planes_ + c * pixels + first;
+
+		for (int i = 0; i < count; i++)
+			plane[i] = channels[c];
+	}
+}
+
+
+void Renderer::readSpan(int x, int y, int count, Color* colors)
+{
+	int first = Mathtools::pixelIndex(width_, y, x);
+
+	if (buffer_)
+	{
+		for (int i = 0; i < count; i++)
+			colors[i].setColor(buffer_[first + i]);
+
+		return;
+	}
+
+	int pixels = width_ * height_;
+	float* red = planes_ + first;
+	float* green = red + pixels;
+	float* blue = green + pixels;
+
+	// not clamped, like the Colors of the interleaved buffer
+	for (int i = 0; i < count; i++)
+	{
+		float channels[3] = { red[i], green[i], blue[i] };
+		colors[i].setColor(channels);
+	}
+}
+
+
+Color* Renderer::getRow(int y)
+{
+	return buffer_ ? buffer_ + Mathtools::pixelIndex(width_, y, 0) : 0;
+}
+
+
+float* Renderer::getPlaneRow(int channel, int y)
+{
+	return planes_ ? planes_ + channel * width_ * height_ + Mathtools::pixelIndex(width_, y, 0) : 0;
+}
+
+
+void Renderer::setPlanarColors(bool planar)
+{
+	PLANAR_COLORS = planar;
+}
+
+
+bool Renderer::isPlanar()
+{
+	return planes_ != 0;
+}
+
+
+std::vector<RenderTile> Renderer::createTiles(int size)
+{
+	std::vector<RenderTile> tiles;
+
+	for (int y = 0; y < height_; y += size)
+	{
+		for (int x = 0; x < width_; x += size)
+		{
+			int x1 = x + size < width_ ? x + size : width_;
+			int y1 = y + size < height_ ? y + size : height_;
+
+			tiles.push_back(RenderTile(x, y, x1, y1));
+		}
+	}
+
+	return tiles;
+}
+
+
 Image Renderer::createImage()
 {
-	return Image(width_, height_, buffer_);
+	if (buffer_)
+		return Image(width_, height_, buffer_);
+
+	Color* colors = new Color[width_ * height_];
+	readSpan(0, 0, width_ * height_, colors);
+
+	Image img(width_, height_, colors);
+
+	delete[] colors;
+
+	return img;
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define RENDERER_H_
 
 #include "Color.h"
+#include "RenderTile.h"
+
+#include <vector>
+#include <functional>
 
 class Image;
 
@@ -12,21 +16,54 @@ We use this class to create our image output. A color buffer (W x H) lets us
 draw everything we want. What is drawn can be described in overloaded
 render() method. Width and Height is set in constructor and can't be changed
 afterwards (it would destroy our image)
+
+colorPixel() checks every pixel, so it is meant for single pixels (i.e. the
+Painter). Renderers write runs of pixels with writeSpan()/fillSpan() or the row
+pointers, which don't check anything: the whole span has to be inside of the
+buffer. Rows follow each other, so a span may go on in the next row.
+
+Colors are interleaved (one Color per pixel) by default. With planar colors
+(setPlanarColors, before the renderer is created) red, green and blue are
+stored in three float planes, 12 instead of 24 bytes per pixel. Only the span
+functions and getPlaneRow() work with both layouts.
+
+Renderers which render tiles on the WorkerPool (2D, pathtracing) are created
+"tiled": each row of their buffers is first written by a WorkerPool job of
+that row. On more than one NUMA node its pages then land on the node whose
+workers take the tiles of that row first (tiles and rows are split between
+nodes the same way), stolen tiles read remote memory. Other renderers draw
+on the calling thread, which writes their rows first as well.
 */
 
 class Renderer
 {
 private:
+	// color layout of new renderers
+	static bool PLANAR_COLORS;
+
 	// initialize our color buffer where we want to draw
 	void initBuffer();
+	void freeBuffer();
 protected:
+	// renders tiles on the WorkerPool, see touchRows
+	bool tiled_;
+
+	// touch(y) for every row, on the WorkerPool if tiled (first write places pages)
+	void touchRows(std::function<void(int)> touch);
+
 	// color buffer and size of buffer
 	Color backgroundColor_;
 	Color* buffer_;
 	int width_, height_;
+
+	// planar colors instead of buffer_: red, green and blue plane (width * height each)
+	float* planes_;
+
+	// split screen into tiles of size x size pixels (smaller at right and bottom border)
+	std::vector<RenderTile> createTiles(int size);
 public:
-	Renderer();
-	Renderer(const int width, const int height);
+	Renderer(bool tiled = false);
+	Renderer(const int width, const int height, bool tiled = false);
 	virtual ~Renderer();
 
 	// set background color
@@ -40,8 +77,21 @@ public:
 	// color pixel coordinate
 	void colorPixel(int x, int y, Color color);
 
+	// interleaved colors only (0 if planar or outside)
 	Color* getColor(int x, int y);
 
+	// spans without any checks, count pixels starting at x, y
+	void writeSpan(int x, int y, int count, Color* colors);
+	void fillSpan(int x, int y, int count, Color& color);
+	void readSpan(int x, int y, int count, Color* colors);
+
+	// row pointers without checks, 0 if the buffer has the other layout
+	Color* getRow(int y);
+	float* getPlaneRow(int channel, int y);
+
+	static void setPlanarColors(bool planar);
+	bool isPlanar();
+
 	// create an Image
 
 	Image createImage();
@@ -5,11 +5,16 @@
 #include "Object2D.h"
 #include "Surface2D.h"
 #include "Line2D.h"
+#include "Texture.h"
 #include "Mathtools.h"
+#include "WorkerPool.h"
 
 #include <iostream>
 
-Renderer2D::Renderer2D() : Renderer()
+int Renderer2D::TILE_SIZE = 64;
+bool Renderer2D::ANALYTIC_SHAPES = true;
+
+Renderer2D::Renderer2D() : Renderer(true)
 {
 	std::cout << "Renderer2D constructor" << std::endl;
 	std::cout << "Prepare Camera" << std::endl;
@@ -24,7 +29,7 @@ Renderer2D::Renderer2D() : Renderer()
 	std::cout << "Scene with " << scene_->getObjectSize() << " objects created" << std::endl;
 }
 
-Renderer2D::Renderer2D(Camera2D& camera) : Renderer(camera.getScreenWidth(), camera.getScreenHeight())
+Renderer2D::Renderer2D(Camera2D& camera) : Renderer(camera.getScreenWidth(), camera.getScreenHeight(), true)
 {
 	std::cout << "Renderer2D constructor" << std::endl;
 	std::cout << "Prepare Camera" << std::endl;
@@ -40,12 +45,26 @@ Renderer2D::Renderer2D(Camera2D& camera) : Renderer(camera.getScreenWidth(), cam
 
 Renderer2D::~Renderer2D()
 {
+	clearDrawList();
+
 	delete camera_;
 	delete scene_;
 }
 
 
-void Renderer2D::rasterization(Surface2D* triangle)
+void Renderer2D::setTileSize(int size)
+{
+	TILE_SIZE = size < 1 ? 1 : size;
+}
+
+
+void Renderer2D::setAnalyticShapes(bool analytic)
+{
+	ANALYTIC_SHAPES = analytic;
+}
+
+
+void Renderer2D::rasterization(Surface2D* triangle, RenderTile& tile)
 {
 	// copy triangle points
 	Vector3D p0(triangle->getP0()->toVector3D());
@@ -125,12 +144,15 @@ void Renderer2D::rasterization(Surface2D* triangle)
 		mEdgeR = 0;
 	}
 
-	xl = (y - p0.getY())*mEdgeL + p0.getX();
-	xr = (y - p0.getY())*mEdgeR + p0.getX();
-
 	// start drawing first part
-	for (; y < p1.getY(); y = y + 1.0)
+	// edges are computed per row, so rows above our tile are skipped
+	y = Mathtools::max(y, tile.getY0() + 0.5);
+
+	for (; y < p1.getY() && static_cast<int>(y) < tile.getY1(); y = y + 1.0)
 	{
+		xl = (y - p0.getY())*mEdgeL + p0.getX();
+		xr = (y - p0.getY())*mEdgeR + p0.getX();
+
 		double x;
 		if ((xl - floor(xl)) <= 0.5)
 		{
@@ -143,17 +165,12 @@ void Renderer2D::rasterization(Surface2D* triangle)
 			x = ceil(xl) + 0.5;
 		}
 
-		while (x < xr)
-		{
-			if ((x >= xl) && (x <= xr))
-			{
-				colorPixel(static_cast<int>(x), static_cast<int>(y), triangle->getColor(x, y));
-			}
-			x = x + 1.0;
-		}
+		// skip pixels left of our tile, x stays at a pixel center
+		// (x = -0.5 would be truncated to column 0 and sample it twice)
+		if (x < tile.getX0() + 0.5)
+			x = tile.getX0() + 0.5;
 
-		xl = xl + mEdgeL;
-		xr = xr + mEdgeR;
+		rasterizeSpan(triangle, tile, x, y, xl, xr);
 	}
 
 	// prepare settings for second part
@@ -170,6 +187,10 @@ void Renderer2D::rasterization(Surface2D* triangle)
 	}
 
 	// next stage depends on direction of triangle
+	// base points of left and right edge
+	Vector3D bl = p0;
+	Vector3D br = p0;
+
 	if (dir < 0.0)
 	{
 		// looking left
@@ -183,8 +204,7 @@ void Renderer2D::rasterization(Surface2D* triangle)
 		else
 			mEdgeR = 0.0;
 
-		xl = (y - p1.getY())*mEdgeL + p1.getX();
-		xr = (y - p0.getY())*mEdgeR + p0.getX();
+		bl = p1;
 	}
 	else
 	{
@@ -199,13 +219,17 @@ void Renderer2D::rasterization(Surface2D* triangle)
 		else
 			mEdgeL = 0.0;
 
-		xl = (y - p0.getY())*mEdgeL + p0.getX();
-		xr = (y - p1.getY())*mEdgeR + p1.getX();
+		br = p1;
 	}
 
 	// start drawing second part
-	for (; y < p2.getY(); y = y + 1.0)
+	y = Mathtools::max(y, tile.getY0() + 0.5);
+
+	for (; y < p2.getY() && static_cast<int>(y) < tile.getY1(); y = y + 1.0)
 	{
+		xl = (y - bl.getY())*mEdgeL + bl.getX();
+		xr = (y - br.getY())*mEdgeR + br.getX();
+
 		double x;
 		if ((xl - floor(xl)) <= 0.5)
 		{
@@ -218,30 +242,251 @@ void Renderer2D::rasterization(Surface2D* triangle)
 			x = ceil(xl) + 0.5;
 		}
 
-		while (x < xr)
+		// skip pixels left of our tile, x stays at a pixel center
+		// (x = -0.5 would be truncated to column 0 and sample it twice)
+		if (x < tile.getX0() + 0.5)
+			x = tile.getX0() + 0.5;
+
+		rasterizeSpan(triangle, tile, x, y, xl, xr);
+	}
+}
+
+
+// pixel (col, row) is sampled at its center (col + 0.5, row + 0.5), in object
+// space this is "origin + col * step" for each row, so the shape only needs to
+// tell us where this line enters and leaves it. Texture coordinates are linear
+// in screen space as well.
+
+void Renderer2D::fillShape(DrawItem& item, RenderTile& tile)
+{
+	Object2D* shape = item.shape;
+	Texture* texture = shape->getTexture();
+	Color fillColor = shape->getFillColor();
+
+	// screen space -> texture coordinates
+	TransformMatrix2D toTexture = shape->getTextureMatrix() * item.toObject;
+
+	// change per column (no translation)
+	Vector2D step(item.toObject.at(0, 0), item.toObject.at(1, 0));
+	Vector2D uvStep(toTexture.at(0, 0), toTexture.at(1, 0));
+
+	int row0 = static_cast<int>(Mathtools::max(floor(item.minY), tile.getY0()));
+	int row1 = static_cast<int>(Mathtools::min(ceil(item.maxY), tile.getY1() - 1.0));
+
+	for (int row = row0; row <= row1; row++)
+	{
+		Vector2D center(0.5, row + 0.5);
+		Vector2D origin = item.toObject * center;
+
+		double tMin, tMax;
+		if (!shape->getLocalSpan(origin, step, &tMin, &tMax))
+			continue;
+
+		// clip span to tile before casting to int
+		tMin = Mathtools::max(ceil(tMin), tile.getX0());
+		tMax = Mathtools::min(floor(tMax), tile.getX1() - 1.0);
+
+		int col0 = static_cast<int>(tMin);
+		int col1 = static_cast<int>(tMax);
+
+		if (!texture)
+		{
+			fillSpan(col0, row, col1 - col0 + 1, fillColor);
+			continue;
+		}
+
+		// evaluate u and v per column (no summing up), so results don't depend on tile borders
+		Vector2D uv = toTexture * center;
+
+		// sample texture in packets of columns
+		const int PACKET = 64;
+		double u[PACKET], v[PACKET];
+		Color colors[PACKET];
+
+		for (int first = col0; first <= col1; first += PACKET)
 		{
-			if ((x >= xl) && (x <= xr))
+			int count = Mathtools::min(PACKET, col1 - first + 1);
+
+			for (int i = 0; i < count; i++)
 			{
-				colorPixel(static_cast<int>(x), static_cast<int>(y), triangle->getColor(x, y));
+				u[i] = uv.getX() + (first + i) * uvStep.getX();
+				v[i] = uv.getY() + (first + i) * uvStep.getY();
 			}
 
-			x = x + 1.0;
+			texture->getColors(count, u, v, colors);
+
+			if (!texture->isRepeatMode())
+			{
+				for (int i = 0; i < count; i++)
+				{
+					if (u[i] < 0.0 || u[i] > 1.0 || v[i] < 0.0 || v[i] > 1.0)
+						colors[i] = fillColor;
+				}
+			}
+
+			writeSpan(first, row, count, colors);
 		}
+	}
+}
+
+
+void Renderer2D::rasterizeSpan(Surface2D* triangle, RenderTile& tile, double x, double y, double xl, double xr)
+{
+	int row = static_cast<int>(y);
+
+	// covered pixels in a row are collected and written at once
+	const int RUN = 64;
+	Color colors[RUN];
+	int first = 0;
+	int count = 0;
 
+	while (x < xr && static_cast<int>(x) < tile.getX1())
+	{
+		int col = static_cast<int>(x);
+
+		if ((x >= xl) && (x <= xr))
+		{
+			if (count == 0)
+				first = col;
+
+			colors[count++] = triangle->getColor(x, y);
+
+			if (count == RUN)
+			{
+				writeSpan(first, row, count, colors);
+				count = 0;
+			}
+		}
+		else if (count > 0)
+		{
+			writeSpan(first, row, count, colors);
+			count = 0;
+		}
 
-		xl = xl + mEdgeL;
-		xr = xr + mEdgeR;
+		x = x + 1.0;
 	}
+
+	if (count > 0)
+		writeSpan(first, row, count, colors);
 }
 
 
-void Renderer2D::render()
+void Renderer2D::addTriangle(Vector2D& p0, Vector2D& p1, Vector2D& p2, Surface2D* triangle)
+{
+	Vector2D* t0 = new Vector2D(p0);
+	Vector2D* t1 = new Vector2D(p1);
+	Vector2D* t2 = new Vector2D(p2);
+
+	drawPoints_.push_back(t0);
+	drawPoints_.push_back(t1);
+	drawPoints_.push_back(t2);
+
+	Color color(triangle->getColor());
+
+	DrawItem item;
+	item.triangle = new Surface2D(t0, t1, t2, &color, triangle->getTexture());
+	item.triangle->setTextureAnchorPoints(triangle->getT0(), triangle->getT1(), triangle->getT2());
+	item.line = 0;
+	item.shape = 0;
+
+	item.minX = Mathtools::min(Mathtools::min(p0.getX(), p1.getX()), p2.getX());
+	item.minY = Mathtools::min(Mathtools::min(p0.getY(), p1.getY()), p2.getY());
+	item.maxX = Mathtools::max(Mathtools::max(p0.getX(), p1.getX()), p2.getX());
+	item.maxY = Mathtools::max(Mathtools::max(p0.getY(), p1.getY()), p2.getY());
+
+	drawList_.push_back(item);
+}
+
+
+void Renderer2D::addLine(Vector2D& p1, Vector2D& p2, Color color)
+{
+	Vector2D* t1 = new Vector2D(p1);
+	Vector2D* t2 = new Vector2D(p2);
+
+	drawPoints_.push_back(t1);
+	drawPoints_.push_back(t2);
+
+	DrawItem item;
+	item.triangle = 0;
+	item.line = new Line2D(t1, t2, &color);
+	item.shape = 0;
+
+	// Painter truncates line coordinates
+	double x1 = static_cast<int>(p1.getX());
+	double y1 = static_cast<int>(p1.getY());
+	double x2 = static_cast<int>(p2.getX());
+	double y2 = static_cast<int>(p2.getY());
+
+	item.minX = Mathtools::min(x1, x2);
+	item.minY = Mathtools::min(y1, y2);
+	item.maxX = Mathtools::max(x1, x2);
+	item.maxY = Mathtools::max(y1, y2);
+
+	drawList_.push_back(item);
+}
+
+
+void Renderer2D::addShape(Object2D* shape, TransformMatrix2D& transform)
 {
+	DrawItem item;
+	item.triangle = 0;
+	item.line = 0;
+	item.shape = shape;
+
+	// object space -> screen space
+	TransformMatrix2D toScreen = transform * shape->getTransformMatrix();
+
+	item.toObject = toScreen;
+	item.toObject.inverse();
+
+	// screen bounding box of the transformed object space box
+	double minX, minY, maxX, maxY;
+	shape->getLocalBounds(&minX, &minY, &maxX, &maxY);
+
+	Vector2D corner[4] = { Vector2D(minX, minY), Vector2D(maxX, minY), Vector2D(maxX, maxY), Vector2D(minX, maxY) };
+
+	for (int i = 0; i < 4; i++)
+	{
+		Vector2D p = toScreen * corner[i];
+
+		item.minX = i == 0 ? p.getX() : Mathtools::min(item.minX, p.getX());
+		item.minY = i == 0 ? p.getY() : Mathtools::min(item.minY, p.getY());
+		item.maxX = i == 0 ? p.getX() : Mathtools::max(item.maxX, p.getX());
+		item.maxY = i == 0 ? p.getY() : Mathtools::max(item.maxY, p.getY());
+	}
+
+	drawList_.push_back(item);
+}
+
+
+void Renderer2D::clearDrawList()
+{
+	for (DrawItem& item : drawList_)
+	{
+		if (item.triangle)
+			delete item.triangle;
+
+		if (item.line)
+			delete item.line;
+	}
+
+	for (Vector2D* point : drawPoints_)
+		delete point;
+
+	drawList_.clear();
+	drawPoints_.clear();
+}
+
+
+void Renderer2D::createDrawList()
+{
+	clearDrawList();
+
 	// get Transform Matrix from camera, we need to transform each point before drawing it
 	TransformMatrix2D transform = camera_->getTransformMatrix();
 
-	// Painter to draw coordinate and border lines
-	Painter painter(this);
+	// coordinate and border lines are drawn in black (like Painter's default line color)
+	Color lineColor;
 
 	// coordinate lines, so that we have a clue where our points are
 	Vector2D center = camera_->getCenter();
@@ -258,12 +503,12 @@ void Renderer2D::render()
 	Vector2D start = transform * xBegin;
 	Vector2D end = transform * xEnd;
 
-	painter.drawLine(start, end);
+	addLine(start, end, lineColor);
 
 	start = transform * yBegin;
 	end = transform * yEnd;
 
-	painter.drawLine(start, end);
+	addLine(start, end, lineColor);
 
 	// x-axis
 	for (int x = static_cast<int>(xBegin.getX()); x <= static_cast<int>(xEnd.getX()); x++)
@@ -274,7 +519,7 @@ void Renderer2D::render()
 
 		temp1 = transform * temp1;
 		temp2 = transform * temp2;
-		painter.drawLine(temp1, temp2);
+		addLine(temp1, temp2, lineColor);
 	}
 
 	// y-axis
@@ -286,10 +531,10 @@ void Renderer2D::render()
 
 		temp1 = transform * temp1;
 		temp2 = transform * temp2;
-		painter.drawLine(temp1, temp2);
+		addLine(temp1, temp2, lineColor);
 	}
 
-	// draw objects, first triangles, then border lines
+	// objects, first triangles, then border lines
 
 	for (size_t i = 0; i < scene_->getObjectSize(); i++)
 	{
@@ -297,9 +542,12 @@ void Renderer2D::render()
 
 		if (obj)
 		{
-			if (obj->isFilled())
+			if (obj->isFilled() && obj->isAnalytic() && ANALYTIC_SHAPES)
+			{
+				addShape(obj, transform);
+			}
+			else if (obj->isFilled())
 			{
-				// draw triangles using rasterization
 				for (unsigned int index = 0; index < obj->getTriangleSize(); index++)
 				{
 					Surface2D* triangle = obj->getTriangle(index);
@@ -307,31 +555,97 @@ void Renderer2D::render()
 					Vector2D p1 = transform * (*(triangle->getP1()));
 					Vector2D p2 = transform * (*(triangle->getP2()));
 
-					Color color(triangle->getColor());
-
-					Surface2D transformedTriangle(p0, p1, p2, &color, triangle->getTexture());
-					transformedTriangle.setTextureAnchorPoints(triangle->getT0(), triangle->getT1(), triangle->getT2());
-
-					rasterization(&transformedTriangle);
+					addTriangle(p0, p1, p2, triangle);
 				}
 			}
-			// draw border lines
+
 			if (obj->isLined())
 			{
-				// draw border lines
 				for (unsigned int index = 0; index < obj->getLineSize(); index++)
 				{
 					Line2D* line = obj->getLine(index);
 					Vector2D p1 = transform * (*(line->getP1()));
 					Vector2D p2 = transform * (*(line->getP2()));
 
-					Color color(line->getColor());
+					addLine(p1, p2, line->getColor());
+				}
+			}
+		}
+	}
+}
+
 
-					Line2D transformedLine(p1, p2, &color);
+void Renderer2D::binDrawList(std::vector<RenderTile>& tiles, std::vector< std::vector<unsigned int> >& bins)
+{
+	// tiles are created row by row
+	int tilesX = (width_ + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (height_ + TILE_SIZE - 1) / TILE_SIZE;
 
-					painter.drawLine(transformedLine);
-				}
+	bins.assign(tiles.size(), std::vector<unsigned int>());
+
+	for (unsigned int i = 0; i < drawList_.size(); i++)
+	{
+		DrawItem& item = drawList_[i];
+
+		double minX = item.minX, minY = item.minY;
+		double maxX = item.maxX, maxY = item.maxY;
+
+		// skip everything outside of screen
+		if (maxX < -1.0 || maxY < -1.0 || minX > width_ || minY > height_)
+			continue;
+
+		// one extra pixel around, pixel centers are truncated to pixel indices
+		int tx0 = static_cast<int>(Mathtools::max(floor(minX) - 1.0, 0.0)) / TILE_SIZE;
+		int ty0 = static_cast<int>(Mathtools::max(floor(minY) - 1.0, 0.0)) / TILE_SIZE;
+		int tx1 = static_cast<int>(Mathtools::min(ceil(maxX) + 1.0, width_ - 1.0)) / TILE_SIZE;
+		int ty1 = static_cast<int>(Mathtools::min(ceil(maxY) + 1.0, height_ - 1.0)) / TILE_SIZE;
+
+		for (int ty = ty0; ty <= ty1 && ty < tilesY; ty++)
+		{
+			for (int tx = tx0; tx <= tx1 && tx < tilesX; tx++)
+			{
+				bins[ty * tilesX + tx].push_back(i);
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+
+void Renderer2D::drawTile(RenderTile& tile, std::vector<unsigned int>& items)
+{
+	// every tile has its own Painter, which draws only inside of this tile
+	Painter painter(this);
+	painter.setClipArea(tile.getX0(), tile.getY0(), tile.getX1(), tile.getY1());
+
+	for (unsigned int index : items)
+	{
+		DrawItem& item = drawList_[index];
+
+		if (item.triangle)
+			rasterization(item.triangle, tile);
+		else if (item.shape)
+			fillShape(item, tile);
+		else
+			painter.drawLine(*item.line);
+	}
+}
+
+
+void Renderer2D::render()
+{
+	// transform everything into screen coordinates
+	createDrawList();
+
+	std::vector<RenderTile> tiles = createTiles(TILE_SIZE);
+	std::vector< std::vector<unsigned int> > bins;
+
+	binDrawList(tiles, bins);
+
+	// draw tiles in parallel
+	WorkerPool::run(tiles.size(), [&](unsigned int index, unsigned int worker)
+	{
+		drawTile(tiles[index], bins[index]);
+	});
+
+	clearDrawList();
+}
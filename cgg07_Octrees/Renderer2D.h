@@ -2,32 +2,106 @@
 #define RENDERER2D_H_
 
 #include "Renderer.h"
+#include "TransformMatrix2D.h"
+
+#include <vector>
 
 class Camera2D;
 class Scene2D;
 class Surface2D;
+class Line2D;
+class Vector2D;
+class Object2D;
+
+/*
+Renderer2D draws coordinate lines and all Object2Ds of a Scene2D
+
+render() works in 2 steps:
+ 1. transform all triangles and lines into screen coordinates (drawing order)
+    and sort them into the screen tiles they touch. Filled analytic shapes
+    (Object2D::isAnalytic) are not split into triangles, they are filled
+    row by row with the shape's span equation
+ 2. draw all tiles in parallel, each tile draws its own list in drawing order
+
+Each pixel is drawn by exactly one tile and in the same order as drawing
+everything one after another, so the image is the same.
+
+Analytic shapes follow the exact outline, their triangles only approximate
+it: pixel centers right at the border of an ellipse may be filled by one and
+not by the other. setAnalyticShapes(false) fills them with their triangles
+again (i.e. to compare, see "CGG 2d" in main.cpp).
+*/
 
 class Renderer2D : public Renderer
 {
 private:
+	// tile size in pixels
+	static int TILE_SIZE;
+
+	// fill analytic shapes with their span equation (otherwise with triangles)
+	static bool ANALYTIC_SHAPES;
+
 	// most important elements in our Renderer
 	Camera2D* camera_;
 	Scene2D* scene_;
 
+	// transformed triangle, line or analytic shape, only one of them is set
+	struct DrawItem
+	{
+		Surface2D* triangle;
+		Line2D* line;
+		Object2D* shape;
+
+		// screen space -> object space (analytic shapes only)
+		TransformMatrix2D toObject;
+
+		// bounding box in screen space
+		double minX, minY, maxX, maxY;
+	};
+
+	// transformed points, triangles and lines in drawing order
+	std::vector<Vector2D*> drawPoints_;
+	std::vector<DrawItem> drawList_;
+
 	// no copy constructor
 	Renderer2D(const Renderer2D& src);
 
 	// the actual drawing algorithm: rasterization
 	// no need to use Painter
-	void rasterization(Surface2D* triangle);
+	// only pixels inside of tile will be drawn
+	void rasterization(Surface2D* triangle, RenderTile& tile);
+
+	// one row of a triangle inside of the tile, covered pixels are written in runs
+	void rasterizeSpan(Surface2D* triangle, RenderTile& tile, double x, double y, double xl, double xr);
+
+	// fill analytic shape with its span equation in each pixel row
+	void fillShape(DrawItem& item, RenderTile& tile);
+
+	// add transformed triangle or line to draw list
+	void addTriangle(Vector2D& p0, Vector2D& p1, Vector2D& p2, Surface2D* triangle);
+	void addLine(Vector2D& p1, Vector2D& p2, Color color);
+	void addShape(Object2D* shape, TransformMatrix2D& transform);
+
+	// transform coordinate lines and scene into draw list
+	void createDrawList();
+	void clearDrawList();
+
+	// sort draw list items into the tiles they touch
+	void binDrawList(std::vector<RenderTile>& tiles, std::vector< std::vector<unsigned int> >& bins);
+
+	// draw everything of one tile
+	void drawTile(RenderTile& tile, std::vector<unsigned int>& items);
 
 public:
 	Renderer2D();
 	Renderer2D(Camera2D& camera);
 	virtual ~Renderer2D();
 
+	static void setTileSize(int size);
+	static void setAnalyticShapes(bool analytic);
+
 	// override render method
 	virtual void render();
 };
 
-#endif
\ No newline at end of file
+#endif
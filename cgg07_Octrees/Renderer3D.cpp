@@ -5,9 +5,12 @@
 #include "Image.h"
 
 #include <iostream>
+#include <algorithm>
 
-Renderer3D::Renderer3D() : depthBuffer_(0), Renderer()
+Renderer3D::Renderer3D(bool tiled) : depthBuffer_(0), Renderer(tiled)
 {
+	resetCropWindow();
+
 	std::cout << "Renderer3D: Create Camera" << std::endl;
 	camera_ = new Camera3D();
 
@@ -21,8 +24,10 @@ Renderer3D::Renderer3D() : depthBuffer_(0), Renderer()
 }
 
 
-Renderer3D::Renderer3D(Camera3D& camera) : depthBuffer_(0), Renderer(camera.getScreenWidth(), camera.getScreenHeight())
+Renderer3D::Renderer3D(Camera3D& camera, bool tiled) : depthBuffer_(0), Renderer(camera.getScreenWidth(), camera.getScreenHeight(), tiled)
 {
+	resetCropWindow();
+
 	std::cout << "Renderer3D: Create Camera" << std::endl;
 	camera_ = new Camera3D(camera);
 
@@ -50,12 +55,38 @@ void Renderer3D::initDepthBuffer(double value)
 
 	depthBuffer_ = new double[width_*height_];
 
-	for (int i = 0; i < width_*height_; i++)
+	// rows are first written where they are rendered (see Renderer)
+	touchRows([&](int y)
 	{
-		depthBuffer_[i] = value;
-	}
+		double* row = getDepthRow(y);
+		std::fill(row, row + width_, value);
+	});
+}
+
+Scene3D* Renderer3D::getScene()
+{
+	return scene_;
+}
+
+
+Camera3D* Renderer3D::getCamera()
+{
+	return camera_;
 }
 
+
+double* Renderer3D::getDepthRow(int y)
+{
+	return depthBuffer_ + Mathtools::pixelIndex(width_, y, 0);
+}
+
+
+void Renderer3D::writeDepthSpan(int x, int y, int count, double* depths)
+{
+	std::copy(depths, depths + count, depthBuffer_ + Mathtools::pixelIndex(width_, y, x));
+}
+
+
 double Renderer3D::getDepth(int x, int y)
 {
 	if (x < 0 || x >= width_ || y < 0 || y >= height_)
@@ -76,8 +107,52 @@ void Renderer3D::setDepth(int x, int y, double depth)
 
 void Renderer3D::setMaxDepth(double value)
 {
-	for (int i = 0; i < width_*height_; i++)
-		depthBuffer_[i] = value;
+	// outside of crop window depth belongs to last rendering
+	for (int y = cropY0_; y < cropY1_; y++)
+	{
+		double* row = getDepthRow(y);
+		std::fill(row + cropX0_, row + cropX1_, value);
+	}
+}
+
+
+void Renderer3D::setCropWindow(int x0, int y0, int x1, int y1)
+{
+	cropX0_ = std::max(x0, 0);
+	cropY0_ = std::max(y0, 0);
+	cropX1_ = std::min(x1, width_);
+	cropY1_ = std::min(y1, height_);
+
+	// empty window: render whole screen
+	if (cropX0_ >= cropX1_ || cropY0_ >= cropY1_)
+		resetCropWindow();
+}
+
+
+void Renderer3D::resetCropWindow()
+{
+	cropX0_ = 0;
+	cropY0_ = 0;
+	cropX1_ = width_;
+	cropY1_ = height_;
+}
+
+
+Image Renderer3D::createCropImage()
+{
+	int width = cropX1_ - cropX0_;
+	int height = cropY1_ - cropY0_;
+
+	Color* crop = new Color[width * height];
+
+	for (int y = 0; y < height; y++)
+		readSpan(cropX0_, cropY0_ + y, width, &crop[Mathtools::pixelIndex(width, y, 0)]);
+
+	Image img(width, height, crop);
+
+	delete[] crop;
+
+	return img;
 }
 
 
@@ -174,6 +249,10 @@ void Renderer3D::rasterization(Surface3D* triangle)
 		y = ceil(p0.getY()) + 0.5;
 	}
 
+	// skip rows above crop window
+	if (y < cropY0_ + 0.5)
+		y = cropY0_ + 0.5;
+
 	if (dl.getX() != 0.0)
 	{
 		mEdgeL = ml;
@@ -196,7 +275,7 @@ void Renderer3D::rasterization(Surface3D* triangle)
 	xr = (y - p0.getY())*mEdgeR + p0.getX();
 
 	// start drawing first part
-	for (; y < p1.getY(); y = y + 1.0)
+	for (; y < p1.getY() && y < cropY1_; y = y + 1.0)
 	{
 		double x;
 		if ((xl - floor(xl)) <= 0.5)
@@ -210,30 +289,11 @@ void Renderer3D::rasterization(Surface3D* triangle)
 			x = ceil(xl) + 0.5;
 		}
 
-		while (x < xr)
-		{
-			// calculate z like in ray-plane intersection
-			// t = - ((N*P) + d) / (N*v)
-			// d = -(N*P0) or -(N*P1) or (N*P2) = constant
-			//
-			// t = - ((N*P) - (N*P0)) / (N*v)
-			//
-			// P  = (x/y/0)
-			// N  = normal
-			// p0 = Vector3D p0
-			// v  = (0/0/1)
-			//
-			// z  = P_z + t * v_z = t
-
-			double z = -((normal.getX() * x + normal.getY() * y + constant) / (normal.getZ()));
-
-			if ((x >= xl) && (x <= xr) && (z >= 0.0) && (z < getDepth(static_cast<int>(x),static_cast<int>(y))))
-			{
-				setDepth(static_cast<int>(x), static_cast<int>(y), z);
-				colorPixel(static_cast<int>(x), static_cast<int>(y), triangle->getColor(x, y, z));
-			}
-			x = x + 1.0;
-		}
+		// skip pixels left of crop window
+		if (x < cropX0_ + 0.5)
+			x = cropX0_ + 0.5;
+
+		rasterizeSpan(triangle, x, y, xl, xr, normal, constant);
 
 		xl = xl + mEdgeL;
 		xr = xr + mEdgeR;
@@ -252,6 +312,9 @@ void Renderer3D::rasterization(Surface3D* triangle)
 		y = ceil(p1.getY()) + 0.5;
 	}
 
+	if (y < cropY0_ + 0.5)
+		y = cropY0_ + 0.5;
+
 	// next stage depends on direction of triangle
 	if (dir < 0.0)
 	{
@@ -287,7 +350,7 @@ void Renderer3D::rasterization(Surface3D* triangle)
 	}
 
 	// start drawing second part
-	for (; y < p2.getY(); y = y + 1.0)
+	for (; y < p2.getY() && y < cropY1_; y = y + 1.0)
 	{
 		double x;
 		if ((xl - floor(xl)) <= 0.5)
@@ -301,33 +364,71 @@ void Renderer3D::rasterization(Surface3D* triangle)
 			x = ceil(xl) + 0.5;
 		}
 
-		while (x < xr)
+		// skip pixels left of crop window
+		if (x < cropX0_ + 0.5)
+			x = cropX0_ + 0.5;
+
+		rasterizeSpan(triangle, x, y, xl, xr, normal, constant);
+
+
+		xl = xl + mEdgeL;
+		xr = xr + mEdgeR;
+	}
+}
+
+
+void Renderer3D::rasterizeSpan(Surface3D* triangle, double x, double y, double xl, double xr, Vector3D& normal, double constant)
+{
+	// visible pixels in a row are collected and written at once
+	const int RUN = 64;
+	Color colors[RUN];
+	int first = 0;
+	int count = 0;
+
+	int row = static_cast<int>(y);
+	double* depthRow = getDepthRow(row);
+
+	while (x < xr && x < cropX1_)
+	{
+		// calculate z like in ray-plane intersection
+		// t = - ((N*P) + d) / (N*v)
+		// d = -(N*P0) or -(N*P1) or (N*P2) = constant
+		//
+		// t = - ((N*P) - (N*P0)) / (N*v)
+		//
+		// P  = (x/y/0)
+		// N  = normal
+		// p0 = Vector3D p0
+		// v  = (0/0/1)
+		//
+		// z  = P_z + t * v_z = t
+
+		double z = -((normal.getX() * x + normal.getY() * y + constant) / (normal.getZ()));
+		int col = static_cast<int>(x);
+
+		if ((x >= xl) && (x <= xr) && (z >= 0.0) && (z < depthRow[col]))
 		{
-			// calculate z like in ray-plane intersection
-			// t = - ((N*P) + d) / (N*v)
-			// d = -(N*P0) or -(N*P1) or (N*P2) = constant
-			//
-			// t = - ((N*P) - (N*P0)) / (N*v)
-			//
-			// P  = (x/y/0)
-			// N  = normal
-			// p0 = Vector3D p0
-			// v  = (0/0/1)
-			//
-			// z  = P_z + t * v_z = t
-
-			double z = -((normal.getX() * x + normal.getY() * y + constant) / (normal.getZ()));
-
-			if ((x >= xl) && (x <= xr) && (z >= 0.0) && (z < getDepth(static_cast<int>(x), static_cast<int>(y))))
+			if (count == 0)
+				first = col;
+
+			depthRow[col] = z;
+			colors[count++] = triangle->getColor(x, y, z);
+
+			if (count == RUN)
 			{
-				setDepth(static_cast<int>(x), static_cast<int>(y), z);
-				colorPixel(static_cast<int>(x), static_cast<int>(y), triangle->getColor(x, y, z));
+				writeSpan(first, row, count, colors);
+				count = 0;
 			}
-			x = x + 1.0;
+		}
+		else if (count > 0)
+		{
+			writeSpan(first, row, count, colors);
+			count = 0;
 		}
 
-
-		xl = xl + mEdgeL;
-		xr = xr + mEdgeR;
+		x = x + 1.0;
 	}
-}
\ No newline at end of file
+
+	if (count > 0)
+		writeSpan(first, row, count, colors);
+}
@@ -13,6 +13,11 @@ contains standard rasterization algorithm which can also be used for
 radiosity
 
 contains depth buffer of size W*H
+
+A crop window limits rendering to a rectangle of the screen (raycasting and
+rasterization). Projection stays the same as for the whole screen, pixels
+outside of the window keep what they had before, so a crop can be composited
+into the last full rendering or saved on its own with createCropImage().
 */
 
 class Renderer3D : public Renderer
@@ -23,9 +28,17 @@ protected:
 	Camera3D* camera_;
 	Scene3D* scene_;
 
+	// crop window in pixels, x1 and y1 exclusive (whole screen by default)
+	int cropX0_, cropY0_;
+	int cropX1_, cropY1_;
+
 	// this function will be used in "rasterization" and "radiosity"
 	void rasterization(Surface3D* triangle);
 
+	// one row of a triangle: pixel centers x, x + 1, ... left of xr and of the crop window
+	// depth tested pixels are written in runs
+	void rasterizeSpan(Surface3D* triangle, double x, double y, double xl, double xr, Vector3D& normal, double constant);
+
 	// init depth buffer
 
 	void initDepthBuffer(double value);
@@ -33,17 +46,36 @@ protected:
 	void setMaxDepth(double max);
 
 public:
-	Renderer3D();
-	Renderer3D(Camera3D& camera);
+	// tiled: renders tiles on the WorkerPool (see Renderer)
+	Renderer3D(bool tiled = false);
+	Renderer3D(Camera3D& camera, bool tiled = false);
 	virtual ~Renderer3D();
 
 	// abstract
 	virtual void render() = 0;
 	
+	// scene can be changed before render() (i.e. materials)
+	Scene3D* getScene();
+
+	// renderer works with its own copy of the camera
+	// move it between render() calls for camera sequences
+	Camera3D* getCamera();
+
 	double getDepth(int x, int y);
 	void setDepth(int x, int y, double depth);
 
+	// without checks, like the color spans
+	double* getDepthRow(int y);
+	void writeDepthSpan(int x, int y, int count, double* depths);
+
 	Image createDepthImage();
+
+	// render only pixels inside of x0 <= x < x1 and y0 <= y < y1
+	void setCropWindow(int x0, int y0, int x1, int y1);
+	void resetCropWindow();
+
+	// pixels of crop window only
+	Image createCropImage();
 };
 
 #endif
\ No newline at end of file
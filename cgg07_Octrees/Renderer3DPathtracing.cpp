@@ -0,0 +1,468 @@
+#include "Renderer3DPathtracing.h"
+#include "Scene3D.h"
+#include "Surface3D.h"
+#include "Material.h"
+#include "Mathtools.h"
+#include "Ray.h"
+#include "Light.h"
+#include "Shader.h"
+#include "Random.h"
+#include "WorkerPool.h"
+#include "Denoiser.h"
+#include "MemoryBudget.h"
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+int Renderer3DPathtracing::TILE_SIZE = 32;
+
+// distance to move new rays away from the surface
+static const double OFFSET = 0.0001;
+
+
+Renderer3DPathtracing::Renderer3DPathtracing() : Renderer3D(true),
+minSamples_(16), maxSamples_(256), samplesPerPass_(4), noiseThreshold_(0.02),
+maxBounces_(8), rouletteDepth_(3), seed_(0), denoising_(false), pixels_(0)
+{
+}
+
+
+Renderer3DPathtracing::Renderer3DPathtracing(Camera3D& camera) : Renderer3D(camera, true),
+minSamples_(16), maxSamples_(256), samplesPerPass_(4), noiseThreshold_(0.02),
+maxBounces_(8), rouletteDepth_(3), seed_(0), denoising_(false), pixels_(0)
+{
+}
+
+
+Renderer3DPathtracing::Renderer3DPathtracing(const Renderer3DPathtracing& src)
+{
+}
+
+
+Renderer3DPathtracing::~Renderer3DPathtracing()
+{
+	delete[] pixels_;
+}
+
+
+void Renderer3DPathtracing::setTileSize(int size)
+{
+	TILE_SIZE = size > 0 ? size : 1;
+}
+
+
+void Renderer3DPathtracing::setSamples(unsigned int minSamples, unsigned int maxSamples)
+{
+	minSamples_ = minSamples > 0 ? minSamples : 1;
+	maxSamples_ = maxSamples > minSamples_ ? maxSamples : minSamples_;
+}
+
+
+void Renderer3DPathtracing::setSamplesPerPass(unsigned int samples)
+{
+	samplesPerPass_ = samples > 0 ? samples : 1;
+}
+
+
+void Renderer3DPathtracing::setNoiseThreshold(double threshold)
+{
+	noiseThreshold_ = threshold;
+}
+
+
+void Renderer3DPathtracing::setMaxBounces(unsigned int bounces)
+{
+	maxBounces_ = bounces;
+}
+
+
+void Renderer3DPathtracing::setRouletteDepth(unsigned int depth)
+{
+	rouletteDepth_ = depth;
+}
+
+
+void Renderer3DPathtracing::setSeed(unsigned long long seed)
+{
+	seed_ = seed;
+}
+
+
+void Renderer3DPathtracing::setDenoising(bool denoising)
+{
+	denoising_ = denoising;
+}
+
+
+void Renderer3DPathtracing::directLight(Vector3D& point, Vector3D& normal, Vector3D& viewDir, Surface3D* surface, double throughput[3], double rgb[3])
+{
+	Vector3D start = point + normal * OFFSET;
+
+	for (Light* light : lights_)
+	{
+		Vector3D toLight = light->getPosition() - point;
+		double distance = toLight.length();
+
+		// light behind surface
+		if (Mathtools::dot(toLight, normal) <= 0.0)
+			continue;
+
+		toLight.normalize();
+
+		// shadow ray: anything between point and light?
+		Ray shadowRay(start, toLight);
+		double dist = distance - OFFSET;
+
+		if (scene_->getAnySurfaceAtRay(shadowRay, &dist))
+			continue;
+
+		Color color = Shader::directLight(point, normal, viewDir, surface, light);
+
+		rgb[0] += throughput[0] * color.getRed();
+		rgb[1] += throughput[1] * color.getGreen();
+		rgb[2] += throughput[2] * color.getBlue();
+	}
+}
+
+
+void Renderer3DPathtracing::radiance(Ray& ray, Random& random, double rgb[3], double* depth, Vector3D* firstNormal, double albedo[3])
+{
+	double throughput[3] = { 1.0, 1.0, 1.0 };
+	Ray current(ray);
+
+	for (unsigned int bounce = 0; bounce <= maxBounces_; bounce++)
+	{
+		double dist = camera_->getMaxDepth();
+		Surface3D* surface = scene_->getClosestSurfaceAtRay(current, &dist);
+
+		if (bounce == 0)
+		{
+			*depth = dist;
+
+			// no hit: background is its own albedo
+			*firstNormal = Vector3D(0.0, 0.0, 0.0);
+			albedo[0] = albedo[1] = albedo[2] = 1.0;
+		}
+
+		if (!surface)
+		{
+			rgb[0] += throughput[0] * backgroundColor_.getRed();
+			rgb[1] += throughput[1] * backgroundColor_.getGreen();
+			rgb[2] += throughput[2] * backgroundColor_.getBlue();
+			return;
+		}
+
+		Vector3D point = current.getPoint(dist);
+		Vector3D dir = current.getDirection();
+		dir.normalize();
+		Vector3D viewDir = -dir;
+
+		// normal facing the incoming ray, refractive indices at both sides
+		Material* material = surface->getMaterial();
+		double index = material ? material->getRefractiveIndex() : 1.0;
+		double eta = 1.0 / index;
+
+		Vector3D normal = surface->getNormal(point);
+
+		if (Mathtools::dot(normal, dir) > 0.0)
+		{
+			normal = -normal;
+			eta = index;
+		}
+
+		if (bounce == 0)
+		{
+			*firstNormal = normal;
+
+			if (material)
+			{
+				Color color = surface->getColor(point) * material->getDiffuseColor();
+
+				albedo[0] = color.getRed();
+				albedo[1] = color.getGreen();
+				albedo[2] = color.getBlue();
+			}
+		}
+
+		double reflection = material ? material->getReflection() : 0.0;
+		double transparency = material ? material->getTransparency() : 0.0;
+
+		// choose mirror, refraction or diffuse bounce by material weights
+		double choice = random.nextDouble();
+		Vector3D next;
+
+		if (choice < reflection + transparency)
+		{
+			if (choice >= reflection && Mathtools::refract(dir, normal, eta, &next))
+			{
+				Vector3D start = point - normal * OFFSET;
+				current.setStart(start);
+			}
+			else
+			{
+				// mirror or total internal reflection
+				next = Mathtools::reflect(dir, normal);
+				Vector3D start = point + normal * OFFSET;
+				current.setStart(start);
+			}
+		}
+		else
+		{
+			directLight(point, normal, viewDir, surface, throughput, rgb);
+
+			if (!material)
+				return;
+
+			// diffuse bounce: cosine weighted sampling cancels cosine and pdf
+			Color albedo = surface->getColor(point) * material->getDiffuseColor();
+
+			throughput[0] *= albedo.getRed();
+			throughput[1] *= albedo.getGreen();
+			throughput[2] *= albedo.getBlue();
+
+			next = Mathtools::cosineHemisphereDirection(normal, random.nextDouble(), random.nextDouble());
+			Vector3D start = point + normal * OFFSET;
+			current.setStart(start);
+		}
+
+		current.setDirection(next);
+
+		// Russian roulette
+		if (bounce >= rouletteDepth_)
+		{
+			double survive = Mathtools::min(Mathtools::max(Mathtools::max(throughput[0], throughput[1]), throughput[2]), 0.95);
+
+			if (survive <= 0.0 || random.nextDouble() >= survive)
+				return;
+
+			for (int c = 0; c < 3; c++)
+				throughput[c] /= survive;
+		}
+	}
+}
+
+
+bool Renderer3DPathtracing::samplePixel(int x, int y, unsigned int pass)
+{
+	int index = Mathtools::pixelIndex(width_, y, x);
+	PixelState& pixel = pixels_[index];
+
+	if (pixel.converged)
+		return true;
+
+	// own random stream for each pixel and pass, seed and pass hashed together
+	// (seed + pass would give seed s, pass p + 1 the numbers of seed s + 1, pass p)
+	Random random(Random::mix(seed_, pass), index);
+
+	for (unsigned int s = 0; s < samplesPerPass_ && pixel.samples < maxSamples_; s++)
+	{
+		// random position inside of pixel
+		double px = leftEdge_ + (x + random.nextDouble()) * stepX_;
+		double py = topEdge_ - (y + random.nextDouble()) * stepY_;
+
+		Vector3D start(0.0, 0.0, 0.0);
+		Vector3D dir(px, py, camera_->getNearPlane());
+		dir.normalize();
+
+		Ray ray(start, dir);
+
+		double rgb[3] = { 0.0, 0.0, 0.0 };
+		double depth = camera_->getMaxDepth();
+		double albedo[3];
+		Vector3D normal;
+
+		radiance(ray, random, rgb, &depth, &normal, albedo);
+
+		pixel.depth += depth;
+		pixel.normal[0] += normal.getX();
+		pixel.normal[1] += normal.getY();
+		pixel.normal[2] += normal.getZ();
+
+		double luminance = 0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+
+		for (int c = 0; c < 3; c++)
+		{
+			pixel.sum[c] += rgb[c];
+			pixel.albedo[c] += albedo[c];
+		}
+
+		pixel.sumSquares += luminance * luminance;
+		pixel.samples++;
+	}
+
+	double n = static_cast<double>(pixel.samples);
+	double mean[3] = { pixel.sum[0] / n, pixel.sum[1] / n, pixel.sum[2] / n };
+
+	Color color(mean[0], mean[1], mean[2]);
+	writeSpan(x, y, 1, &color);
+
+	// mean depth, between both sides at edges like the mean normal
+	getDepthRow(y)[x] = pixel.depth / n;
+
+	// standard error of mean luminance
+	double meanLuminance = 0.2126 * mean[0] + 0.7152 * mean[1] + 0.0722 * mean[2];
+	double variance = Mathtools::max(pixel.sumSquares / n - meanLuminance * meanLuminance, 0.0);
+	double error = sqrt(variance / n);
+
+	// dark pixels: relative error would never get small
+	double brightness = Mathtools::max(meanLuminance, 0.05);
+
+	if (pixel.samples >= maxSamples_ || (pixel.samples >= minSamples_ && error <= noiseThreshold_ * brightness))
+		pixel.converged = true;
+
+	return pixel.converged;
+}
+
+
+void Renderer3DPathtracing::render()
+{
+	// no surfaces or textures of the last frame are used anymore
+	MemoryBudget::nextFrame();
+	scene_->trimDecoded();
+
+	// transform objects in scene
+	TransformMatrix3D transform = camera_->getLookatMatrix();
+	scene_->transform(transform);
+
+	// light bounces everywhere, octrees need all triangles
+	scene_->buildOctrees();
+
+	lights_ = scene_->getLightList();
+
+	// create the viewplane
+	double aspect = static_cast<double>(width_) / static_cast<double>(height_);
+
+	topEdge_ = camera_->getNearPlane() * Mathtools::TAN(camera_->getFov() / 2.0);
+	leftEdge_ = -topEdge_ * aspect;
+
+	stepX_ = 2.0 * (-leftEdge_) / static_cast<double>(width_);
+	stepY_ = 2.0 * topEdge_ / static_cast<double>(height_);
+
+	std::vector<RenderTile> tiles = createTiles(TILE_SIZE);
+
+	PixelState empty = { { 0.0, 0.0, 0.0 }, 0.0, 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, 0, false };
+	int pixels = width_ * height_;
+
+	// written first by the jobs of the tiles, pages end up on their nodes
+	delete[] pixels_;
+	pixels_ = new PixelState[pixels];
+
+	WorkerPool::run(tiles.size(), [&](unsigned int index, unsigned int worker)
+	{
+		RenderTile& tile = tiles[index];
+
+		for (int y = tile.getY0(); y < tile.getY1(); y++)
+		{
+			PixelState* row = pixels_ + Mathtools::pixelIndex(width_, y, 0);
+			std::fill(row + tile.getX0(), row + tile.getX1(), empty);
+		}
+	});
+
+	WorkerPool::resetStatistics();
+	unsigned int passes = (maxSamples_ + samplesPerPass_ - 1) / samplesPerPass_;
+	unsigned long long samples = 0;
+
+	for (unsigned int pass = 0; pass < passes; pass++)
+	{
+		std::atomic<int> active(0);
+
+		WorkerPool::run(tiles.size(), [&](unsigned int index, unsigned int worker)
+		{
+			RenderTile& tile = tiles[index];
+			int tileActive = 0;
+
+			for (int y = tile.getY0(); y < tile.getY1(); y++)
+			{
+				for (int x = tile.getX0(); x < tile.getX1(); x++)
+				{
+					if (!samplePixel(x, y, pass))
+						tileActive++;
+				}
+			}
+
+			active += tileActive;
+		});
+
+		samples = 0;
+
+		for (int i = 0; i < pixels; i++)
+			samples += pixels_[i].samples;
+
+		std::cout << "\rPathtracing...\tpass " << pass + 1 << ", " << active << " pixels left, ";
+		std::cout << static_cast<double>(samples) / pixels << " samples per pixel\t\t" << std::flush;
+
+		if (active == 0)
+			break;
+	}
+
+	std::cout << std::endl;
+
+	unsigned long long local = WorkerPool::getLocalJobCount();
+	unsigned long long stolen = WorkerPool::getStolenJobCount();
+
+	if (local + stolen > 0)
+	{
+		std::cout << "NUMA: " << WorkerPool::getNodeCount() << " nodes, " << local << " tiles rendered on their own node, ";
+		std::cout << stolen << " stolen (" << static_cast<double>(stolen * 100) / static_cast<double>(local + stolen) << "%)" << std::endl;
+	}
+
+	if (denoising_)
+		denoise();
+}
+
+
+void Renderer3DPathtracing::denoise()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Denoiser denoiser(width_, height_);
+
+	for (int y = 0; y < height_; y++)
+	{
+		for (int x = 0; x < width_; x++)
+		{
+			PixelState& pixel = pixels_[Mathtools::pixelIndex(width_, y, x)];
+			double n = static_cast<double>(pixel.samples);
+
+			double rgb[3], albedo[3];
+
+			for (int c = 0; c < 3; c++)
+			{
+				rgb[c] = pixel.sum[c] / n;
+				albedo[c] = pixel.albedo[c] / n;
+			}
+
+			// mean normal, shorter at edges and creases
+			Vector3D normal(pixel.normal[0] / n, pixel.normal[1] / n, pixel.normal[2] / n);
+
+			// variance of mean luminance
+			double luminance = 0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+			double variance = Mathtools::max(pixel.sumSquares / n - luminance * luminance, 0.0) / n;
+
+			denoiser.setPixel(x, y, rgb, variance, getDepth(x, y), normal, albedo);
+		}
+	}
+
+	denoiser.denoise();
+
+	std::vector<Color> row(width_);
+
+	for (int y = 0; y < height_; y++)
+	{
+		for (int x = 0; x < width_; x++)
+		{
+			double rgb[3];
+
+			denoiser.getPixel(x, y, rgb);
+			row[x].setColor(rgb[0], rgb[1], rgb[2]);
+		}
+
+		writeSpan(0, y, width_, row.data());
+	}
+
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Denoising: " << time.count() << " seconds" << std::endl;
+}
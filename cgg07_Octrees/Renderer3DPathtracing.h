@@ -0,0 +1,125 @@
+#ifndef RENDERER3DPATHTRACING_H_
+#define RENDERER3DPATHTRACING_H_
+
+#include "Renderer3D.h"
+
+#include <vector>
+
+class Ray;
+class Random;
+class Light;
+class Vector3D;
+
+/*
+Pathtracing for global illumination
+
+Every sample follows one path through the scene:
+ - at each diffuse hit, all lights are sampled directly (next event
+   estimation): a shadow ray to each Light, visible lights add their
+   Phong diffuse and specular light (Shader::directLight)
+ - the path goes on in a cosine weighted random direction (diffuse bounce),
+   or as mirror/refraction ray with the material's reflection/transparency
+   as probability
+ - after a few bounces, paths with low throughput are stopped randomly
+   (Russian roulette), surviving paths get more weight to stay unbiased
+
+Rendering is progressive: each pass adds some samples to every pixel which
+isn't converged yet, then the image is updated. A pixel converges when the
+standard error of its mean luminance is below the noise threshold (relative
+to its brightness) after the min number of samples.
+
+With denoising, the final image is filtered by the edge-aware Denoiser,
+guided by the mean depth, normal and albedo of each pixel's first hits,
+so far fewer samples are needed for a smooth image.
+
+Passes are rendered in tiles on all worker threads. Each pixel and pass has
+its own random stream, so images don't depend on thread count or order.
+The running sums of a tile are first written by the job of that tile, so they
+stay on the NUMA node whose workers prefer the tile (see WorkerPool).
+*/
+
+class Renderer3DPathtracing : public Renderer3D
+{
+private:
+	static int TILE_SIZE;
+
+	// sampling settings
+	unsigned int minSamples_;
+	unsigned int maxSamples_;
+	unsigned int samplesPerPass_;
+	double noiseThreshold_;
+
+	// path settings
+	unsigned int maxBounces_;
+	unsigned int rouletteDepth_;
+
+	unsigned long long seed_;
+
+	bool denoising_;
+
+	// running sums of a pixel (colors without clamping)
+	struct PixelState
+	{
+		double sum[3];
+		double sumSquares;
+
+		// first hits: guides for the denoiser
+		double depth;
+		double normal[3];
+		double albedo[3];
+		unsigned int samples;
+		bool converged;
+	};
+
+	// width * height, allocated by render()
+	PixelState* pixels_;
+
+	// viewplane, same as raycasting
+	double leftEdge_, topEdge_;
+	double stepX_, stepY_;
+
+	std::vector<Light*> lights_;
+
+	// one path, adds its light to rgb
+	// depth, normal, albedo: first hit
+	void radiance(Ray& ray, Random& random, double rgb[3], double* depth, Vector3D* normal, double albedo[3]);
+
+	// next event estimation: light of all visible lights at point
+	void directLight(Vector3D& point, Vector3D& normal, Vector3D& viewDir, Surface3D* surface, double throughput[3], double rgb[3]);
+
+	// add samples to one pixel, returns true if it is converged
+	bool samplePixel(int x, int y, unsigned int pass);
+
+	// filter final image
+	void denoise();
+
+	Renderer3DPathtracing(const Renderer3DPathtracing& src);
+
+public:
+	Renderer3DPathtracing();
+	Renderer3DPathtracing(Camera3D& camera);
+	virtual ~Renderer3DPathtracing();
+
+	static void setTileSize(int size);
+
+	// samples per pixel: at least min, at most max
+	void setSamples(unsigned int minSamples, unsigned int maxSamples);
+	void setSamplesPerPass(unsigned int samples);
+
+	// relative standard error of pixel luminance to stop sampling
+	void setNoiseThreshold(double threshold);
+
+	// max path length and first bounce with Russian roulette
+	void setMaxBounces(unsigned int bounces);
+	void setRouletteDepth(unsigned int depth);
+
+	// different seed = different noise
+	void setSeed(unsigned long long seed);
+
+	// edge-aware filter after last pass
+	void setDenoising(bool denoising);
+
+	virtual void render();
+};
+
+#endif
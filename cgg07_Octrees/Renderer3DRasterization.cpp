@@ -2,6 +2,7 @@
 #include "Scene3D.h"
 #include "Surface3D.h"
 #include "Mathtools.h"
+#include "MemoryBudget.h"
 
 #include <vector>
 #include <iostream>
@@ -28,6 +29,9 @@ Renderer3DRasterization::~Renderer3DRasterization()
 
 void Renderer3DRasterization::render()
 {
+	// textures of the last frame may be evicted
+	MemoryBudget::nextFrame();
+
 	setMaxDepth(1.0);
 
 	TransformMatrix3D lookat = camera_->getLookatMatrix();
@@ -36,15 +40,34 @@ void Renderer3DRasterization::render()
 
 	TransformMatrix3D transform = screen * proj * lookat;
 
-	std::vector<Surface3D*> list = scene_->getTriangleList();
-
-	std::cout << "Renderer3DRasterization: Found " << list.size() << " triangles" << std::endl;
-
 	int counter = 0;
-	int max = list.size();
+	int max = scene_->getTriangleSize();
+
+	std::cout << "Renderer3DRasterization: Found " << max << " triangles" << std::endl;
 
-	for (Surface3D* triangle : list)
+	// every triangle is used once, compressed objects don't keep them decoded
+	scene_->visitTriangles([&](Surface3D* triangle)
 	{
+		Vector3D p0 = transform * *(triangle->getP0());
+		Vector3D p1 = transform * *(triangle->getP1());
+		Vector3D p2 = transform * *(triangle->getP2());
+
+		// in case we used perspective projection: divide by homogeneous coordinate "w"
+		p0.homogeneousDivide();
+		p1.homogeneousDivide();
+		p2.homogeneousDivide();
+
+		std::cout << "\rRendering... Triangle " << ++counter << " of " << max << "\t\t";
+
+		// triangle outside of crop window: nothing to draw
+		double minX = Mathtools::min(p0.getX(), Mathtools::min(p1.getX(), p2.getX()));
+		double maxX = Mathtools::max(p0.getX(), Mathtools::max(p1.getX(), p2.getX()));
+		double minY = Mathtools::min(p0.getY(), Mathtools::min(p1.getY(), p2.getY()));
+		double maxY = Mathtools::max(p0.getY(), Mathtools::max(p1.getY(), p2.getY()));
+
+		if (maxX < cropX0_ || minX > cropX1_ || maxY < cropY0_ || minY > cropY1_)
+			return;
+
 		Color color = triangle->getColor();
 
 		// color shading according to Lambert
@@ -65,23 +88,11 @@ void Renderer3DRasterization::render()
 		Material material;
 		material.setColor(color);
 
-		Vector3D p0 = transform * *(triangle->getP0());
-		Vector3D p1 = transform * *(triangle->getP1());
-		Vector3D p2 = transform * *(triangle->getP2());
-
-		// in case we used perspective projection: divide by homogeneous coordinate "w"
-		p0.homogeneousDivide();
-		p1.homogeneousDivide();
-		p2.homogeneousDivide();
-
-		
 		Surface3D transformedTriangle(p0, p1, p2, &material, triangle->getTexture());
 		transformedTriangle.setTextureAnchorPoints(triangle->getT0(), triangle->getT1(), triangle->getT2());
 
 		rasterization(&transformedTriangle);
-
-		std::cout << "\rRendering... Triangle " << ++counter << " of " << max << "\t\t";
-	}
+	});
 
 	std::cout << std::endl;
 }
\ No newline at end of file
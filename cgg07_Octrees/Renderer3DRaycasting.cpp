@@ -6,16 +6,34 @@
 #include "Object3D.h"
 #include "Shader.h"
 #include "Light.h"
+#include "Mailbox.h"
+#include "Octree.h"
+#include "RayBuffer.h"
+#include "Random.h"
+#include "AOVBuffer.h"
+#include "MemoryBudget.h"
+#include "Denoiser.h"
 
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
 
 
-Renderer3DRaycasting::Renderer3DRaycasting() : Renderer3D()
+Renderer3DRaycasting::Renderer3DRaycasting() : Renderer3D(), frustumCulling_(false), frustumMargin_(0.0), levelOfDetail_(false),
+occlusionSamples_(0), occlusionDistance_(1.0), occlusionDenoising_(false), rayReordering_(true),
+rayDepth_(5), minRayWeight_(0.01), rayBudget_(16), shadingRate_(1), shadingNormalCos_(1.0), shadingDepthStep_(0.02), shadingContrast_(0.02),
+reprojection_(false), reprojectionTolerance_(0.05), sceneInViewSpace_(false), aovPasses_(0), aovBuffer_(0),
+secondaryRays_(0), prunedRays_(0), shadedPixels_(0), reprojectedPixels_(0)
 {
 }
 
 
-Renderer3DRaycasting::Renderer3DRaycasting(Camera3D& camera) : Renderer3D(camera)
+Renderer3DRaycasting::Renderer3DRaycasting(Camera3D& camera) : Renderer3D(camera), frustumCulling_(false), frustumMargin_(0.0), levelOfDetail_(false),
+occlusionSamples_(0), occlusionDistance_(1.0), occlusionDenoising_(false), rayReordering_(true),
+rayDepth_(5), minRayWeight_(0.01), rayBudget_(16), shadingRate_(1), shadingNormalCos_(1.0), shadingDepthStep_(0.02), shadingContrast_(0.02),
+reprojection_(false), reprojectionTolerance_(0.05), sceneInViewSpace_(false), aovPasses_(0), aovBuffer_(0),
+secondaryRays_(0), prunedRays_(0), shadedPixels_(0), reprojectedPixels_(0)
 {
 }
 
@@ -27,70 +45,861 @@ Renderer3DRaycasting::Renderer3DRaycasting(const Renderer3DRaycasting& src)
 
 Renderer3DRaycasting::~Renderer3DRaycasting()
 {
+	if (aovBuffer_)
+		delete aovBuffer_;
 }
 
 
-Color Renderer3DRaycasting::raycasting(Ray& ray, double* dist)
+void Renderer3DRaycasting::setFrustumCulling(bool culling, double margin)
+{
+	frustumCulling_ = culling;
+	frustumMargin_ = margin;
+}
+
+
+void Renderer3DRaycasting::setLevelOfDetail(bool levelOfDetail)
+{
+	levelOfDetail_ = levelOfDetail;
+}
+
+
+void Renderer3DRaycasting::setAmbientOcclusion(unsigned int samples, double distance)
+{
+	occlusionSamples_ = samples;
+	occlusionDistance_ = distance;
+}
+
+
+void Renderer3DRaycasting::setOcclusionDenoising(bool denoising)
+{
+	occlusionDenoising_ = denoising;
+}
+
+
+void Renderer3DRaycasting::setRayReordering(bool reordering)
+{
+	rayReordering_ = reordering;
+}
+
+
+void Renderer3DRaycasting::setRayDepth(unsigned int depth)
+{
+	rayDepth_ = depth;
+}
+
+
+void Renderer3DRaycasting::setMinRayWeight(double weight)
+{
+	minRayWeight_ = weight;
+}
+
+
+void Renderer3DRaycasting::setRayBudget(unsigned int rays)
+{
+	rayBudget_ = rays;
+}
+
+
+void Renderer3DRaycasting::setShadingRate(unsigned int rate, double maxNormalAngle, double maxDepthStep, double maxContrast)
+{
+	// blocks are split in halves: powers of 2 only
+	shadingRate_ = rate >= 4 ? 4 : (rate >= 2 ? 2 : 1);
+	shadingNormalCos_ = Mathtools::COS(maxNormalAngle);
+	shadingDepthStep_ = maxDepthStep;
+	shadingContrast_ = maxContrast;
+}
+
+
+void Renderer3DRaycasting::setTemporalReprojection(bool reprojection, double tolerance)
+{
+	reprojection_ = reprojection;
+	reprojectionTolerance_ = tolerance;
+
+	lastSurfaces_.clear();
+	lastPoints_.clear();
+}
+
+
+void Renderer3DRaycasting::setAOVPasses(unsigned int passes)
+{
+	aovPasses_ = passes;
+}
+
+
+AOVBuffer* Renderer3DRaycasting::getAOVBuffer()
+{
+	return aovBuffer_;
+}
+
+
+void Renderer3DRaycasting::collectObjectIDs()
+{
+	objectIDs_.clear();
+
+	std::vector<Object3D*> objects = scene_->getObjectList();
+
+	for (unsigned int o = 0; o < objects.size(); o++)
+		objectIDs_[objects[o]] = o;
+}
+
+
+void Renderer3DRaycasting::writeAOVs(int x, int y, Ray& ray, Surface3D* surface, double dist)
+{
+	if (!surface)
+		return;
+
+	Vector3D point = ray.getPoint(dist);
+	int objectID = -1;
+	int triangleID = -1;
+
+	if (!objectIDs_.empty())
+	{
+		std::unordered_map<Object3D*, int>::iterator it = objectIDs_.find(surface->getObject());
+
+		if (it != objectIDs_.end())
+		{
+			objectID = it->second;
+			triangleID = surface->getIndex();
+		}
+	}
+
+	// primary rays have unit length direction: dist is the distance to the camera
+	aovBuffer_->setHit(x, y, surface, point, dist, objectID, triangleID);
+}
+
+
+TransformMatrix3D Renderer3DRaycasting::transformScene()
+{
+	TransformMatrix3D view = camera_->getLookatMatrix();
+	TransformMatrix3D motion = view;
+
+	// scene is still in view space of last frame: undo last view first
+	// view matrices only rotate and translate, inverse = transposed rotation
+	if (sceneInViewSpace_)
+	{
+		TransformMatrix3D undo;
+
+		for (int r = 0; r < 3; r++)
+		{
+			undo.at(r, 3) = 0.0;
+
+			for (int c = 0; c < 3; c++)
+			{
+				undo.at(r, c) = lastView_.at(c, r);
+				undo.at(r, 3) -= lastView_.at(c, r) * lastView_.at(c, 3);
+			}
+		}
+
+		motion = view * undo;
+	}
+
+	scene_->transform(motion);
+
+	// without sequence mode every render() transforms the scene like before
+	sceneInViewSpace_ = reprojection_;
+	lastView_ = view;
+
+	return motion;
+}
+
+
+void Renderer3DRaycasting::reproject(TransformMatrix3D& motion)
+{
+	reprojectedSurfaces_.assign(width_ * height_, 0);
+	reprojectedDists_.assign(width_ * height_, camera_->getMaxDepth());
+
+	// no last frame or screen size changed
+	if (lastSurfaces_.size() != reprojectedSurfaces_.size())
+		return;
+
+	double near = camera_->getNearPlane();
+
+	for (unsigned int pixel = 0; pixel < lastSurfaces_.size(); pixel++)
+	{
+		if (!lastSurfaces_[pixel])
+			continue;
+
+		Vector3D point = motion * lastPoints_[pixel];
+
+		// behind camera
+		if (point.getZ() < near)
+			continue;
+
+		// project onto viewplane, then into pixels
+		double px = point.getX() * near / point.getZ();
+		double py = point.getY() * near / point.getZ();
+
+		int x = static_cast<int>(std::floor((px - leftEdge_) / stepX_));
+		int y = static_cast<int>(std::floor((topEdge_ - py) / stepY_));
+
+		if (x < 0 || x >= width_ || y < 0 || y >= height_)
+			continue;
+
+		// camera is at the origin: distance along primary ray
+		double dist = point.length();
+		int target = Mathtools::pixelIndex(width_, y, x);
+
+		if (dist < reprojectedDists_[target])
+		{
+			reprojectedSurfaces_[target] = lastSurfaces_[pixel];
+			reprojectedDists_[target] = dist;
+		}
+	}
+}
+
+
+Surface3D* Renderer3DRaycasting::reprojectedSurface(Ray& ray, int x, int y, double* dist)
+{
+	Surface3D* result = 0;
+	double closest = *dist;
+	double nearest = camera_->getMaxDepth();
+
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			if (x + dx < 0 || x + dx >= width_ || y + dy < 0 || y + dy >= height_)
+				continue;
+
+			int pixel = Mathtools::pixelIndex(width_, y + dy, x + dx);
+			Surface3D* surface = reprojectedSurfaces_[pixel];
+
+			if (!surface)
+				continue;
+
+			double expected = reprojectedDists_[pixel];
+			nearest = Mathtools::min(nearest, expected);
+
+			// only own pixel and 4 neighbours are candidates
+			if (dx != 0 && dy != 0)
+				continue;
+
+			double hit = closest;
+
+			if (surface->intersection(ray, &hit) && std::fabs(hit - expected) <= reprojectionTolerance_ * expected)
+			{
+				closest = hit;
+				result = surface;
+			}
+		}
+	}
+
+	// a closer point right next to it: may cover this pixel now
+	if (!result || closest > nearest * (1.0 + reprojectionTolerance_))
+		return 0;
+
+	*dist = closest;
+	return result;
+}
+
+
+Ray Renderer3DRaycasting::primaryRay(int x, int y)
+{
+	double px = leftEdge_ + stepX_ / 2.0 + static_cast<int>(x) * stepX_;
+	double py = topEdge_ - stepY_ / 2.0 - static_cast<int>(y) * stepY_;
+	double pz = camera_->getNearPlane();
+
+	Vector3D start(0.0, 0.0, 0.0);
+	Vector3D dir(px, py, pz);
+	dir.normalize();
+
+	Ray ray(start, dir);
+	ray.setSpread(spread_);
+
+	return ray;
+}
+
+
+void Renderer3DRaycasting::ambientOcclusion(std::vector<Surface3D*>& surfaces, std::vector<Vector3D>& points)
+{
+	RayBuffer buffer;
+	buffer.setReordering(rayReordering_);
+
+	for (unsigned int pixel = 0; pixel < surfaces.size(); pixel++)
+	{
+		if (!surfaces[pixel])
+			continue;
+
+		// normal on the side of the camera
+		Vector3D normal = surfaces[pixel]->getNormal(points[pixel]);
+		Vector3D toCamera = -points[pixel];
+
+		if (Mathtools::dot(normal, toCamera) < 0.0)
+			normal = -normal;
+
+		// move start a bit away from surface, otherwise it hits itself
+		Vector3D start = points[pixel] + normal * 0.0001;
+
+		// same random numbers for each pixel in every rendering
+		Random random(0, pixel);
+
+		for (unsigned int s = 0; s < occlusionSamples_; s++)
+		{
+			Vector3D dir = Mathtools::cosineHemisphereDirection(normal, random.nextDouble(), random.nextDouble());
+			Ray ray(start, dir);
+			buffer.addRay(ray, pixel);
+		}
+	}
+
+	std::cout << "Ambient occlusion: tracing " << buffer.getSize() << " rays..." << std::flush;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	buffer.trace(*scene_, Scene3D::ANY_HIT, occlusionDistance_);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << " finished in " << seconds << "s (" << buffer.getSize() / seconds << " rays/s";
+	std::cout << (rayReordering_ ? ", reordered)" : ", unsorted)") << std::endl;
+
+	std::vector<unsigned int> occluded(surfaces.size(), 0);
+
+	for (unsigned int i = 0; i < buffer.getSize(); i++)
+	{
+		if (buffer.getHit(i).isHit())
+			occluded[buffer.getOwner(i)]++;
+	}
+
+	std::vector<double> visibility(surfaces.size(), 1.0);
+
+	for (unsigned int pixel = 0; pixel < surfaces.size(); pixel++)
+	{
+		if (surfaces[pixel])
+			visibility[pixel] = 1.0 - static_cast<double>(occluded[pixel]) / static_cast<double>(occlusionSamples_);
+	}
+
+	if (occlusionDenoising_)
+		denoiseOcclusion(surfaces, points, visibility);
+
+	// darken row by row, spans work with both buffer layouts
+	std::vector<Color> row(width_);
+
+	for (int y = 0; y < height_; y++)
+	{
+		readSpan(0, y, width_, row.data());
+
+		for (int x = 0; x < width_; x++)
+		{
+			int pixel = Mathtools::pixelIndex(width_, y, x);
+
+			if (!surfaces[pixel])
+				continue;
+
+			row[x] = row[x] * visibility[pixel];
+		}
+
+		writeSpan(0, y, width_, row.data());
+	}
+}
+
+
+void Renderer3DRaycasting::denoiseOcclusion(std::vector<Surface3D*>& surfaces, std::vector<Vector3D>& points, std::vector<double>& visibility)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Denoiser denoiser(width_, height_);
+
+	// only the occlusion is filtered: grey color, white albedo
+	double albedo[3] = { 1.0, 1.0, 1.0 };
+	double samples = static_cast<double>(occlusionSamples_);
+
+	for (int y = 0; y < height_; y++)
+	{
+		for (int x = 0; x < width_; x++)
+		{
+			int pixel = Mathtools::pixelIndex(width_, y, x);
+			double visible = visibility[pixel];
+			double rgb[3] = { visible, visible, visible };
+
+			if (!surfaces[pixel])
+			{
+				// background: far away, never mixed into surfaces
+				Vector3D normal(0.0, 0.0, 1.0);
+				denoiser.setPixel(x, y, rgb, 0.0, camera_->getMaxDepth(), normal, albedo);
+				continue;
+			}
+
+			Vector3D normal = surfaces[pixel]->getNormal(points[pixel]);
+			Vector3D toCamera = -points[pixel];
+
+			if (Mathtools::dot(normal, toCamera) < 0.0)
+				normal = -normal;
+
+			// binomial variance of the mean of the occlusion rays
+			double variance = visible * (1.0 - visible) / samples;
+
+			denoiser.setPixel(x, y, rgb, variance, points[pixel].length(), normal, albedo);
+		}
+	}
+
+	denoiser.denoise();
+
+	for (int y = 0; y < height_; y++)
+	{
+		for (int x = 0; x < width_; x++)
+		{
+			int pixel = Mathtools::pixelIndex(width_, y, x);
+
+			if (!surfaces[pixel])
+				continue;
+
+			double rgb[3];
+			denoiser.getPixel(x, y, rgb);
+			visibility[pixel] = Mathtools::min(Mathtools::max(rgb[0], 0.0), 1.0);
+		}
+	}
+
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Occlusion denoising: " << time.count() << " seconds" << std::endl;
+}
+
+
+Color Renderer3DRaycasting::raycasting(Ray& ray, double* dist, Surface3D** hit)
+{
+	unsigned int budget = rayBudget_;
+
+	return trace(ray, dist, 0, 1.0, &budget, hit);
+}
+
+
+Color Renderer3DRaycasting::trace(Ray& ray, double* dist, unsigned int depth, double weight, unsigned int* budget, Surface3D** hit)
 {
 	Surface3D* surface = scene_->getClosestSurfaceAtRay(ray, dist);
 
+	if (hit)
+		*hit = surface;
+
 	if (surface == NULL)
 	{
 		return backgroundColor_;
 	}
-	
-	Vector3D P = ray.getPoint(*dist);
 
-	return Shader::phong(P, surface, scene_->getLightList());
+	return shade(ray, surface, *dist, depth, weight, budget);
+}
+
+
+Color Renderer3DRaycasting::shade(Ray& ray, Surface3D* surface, double dist, unsigned int depth, double weight, unsigned int* budget)
+{
+	Vector3D P = ray.getPoint(dist);
+	Vector3D dir = ray.getDirection();
+	dir.normalize();
+
+	Vector3D viewDir = -dir;
+	std::vector<Light*> lights = scene_->getLightList();
+	Color local = Shader::phong(P, viewDir, surface, lights);
+
+	Material* material = surface->getMaterial();
+	double reflection = material ? material->getReflection() : 0.0;
+	double transparency = material ? material->getTransparency() : 0.0;
+
+	if (depth >= rayDepth_ || (reflection <= 0.0 && transparency <= 0.0))
+		return local;
+
+	// normal against incoming ray, refractive indices at both sides
+	Vector3D normal = surface->getNormal(P);
+	double inside = material->getRefractiveIndex();
+	double outside = 1.0;
+
+	if (Mathtools::dot(normal, dir) > 0.0)
+	{
+		normal = -normal;
+		inside = 1.0;
+		outside = material->getRefractiveIndex();
+	}
+
+	Vector3D reflected = Mathtools::reflect(dir, normal);
+	Vector3D refracted;
+
+	// total internal reflection: all light is reflected
+	if (transparency > 0.0 && !Mathtools::refract(dir, normal, outside / inside, &refracted))
+	{
+		reflection += transparency;
+		transparency = 0.0;
+	}
+
+	// branches, larger one first (it gets the budget first)
+	Vector3D directions[2] = { reflected, refracted };
+	Vector3D starts[2] = { P + normal * 0.0001, P - normal * 0.0001 };
+	double factors[2] = { reflection, transparency };
+
+	if (factors[1] > factors[0])
+	{
+		std::swap(directions[0], directions[1]);
+		std::swap(starts[0], starts[1]);
+		std::swap(factors[0], factors[1]);
+	}
+
+	Color color = local * (1.0 - reflection - transparency);
+	double pruned = 0.0;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (factors[i] <= 0.0)
+			continue;
+
+		if (weight * factors[i] < minRayWeight_ || *budget == 0)
+		{
+			pruned += factors[i];
+			prunedRays_++;
+			continue;
+		}
+
+		(*budget)--;
+		secondaryRays_++;
+
+		Ray secondary(starts[i], directions[i]);
+		double secondaryDist = camera_->getMaxDepth();
+
+		color += trace(secondary, &secondaryDist, depth + 1, weight * factors[i], budget) * factors[i];
+	}
+
+	// pruned branches get local color
+	color += local * pruned;
+
+	return color;
+}
+
+
+bool Renderer3DRaycasting::isUniformBlock(int x0, int y0, int x1, int y1, std::vector<Surface3D*>& surfaces, std::vector<double>& dists, std::vector<Vector3D>& points)
+{
+	Surface3D* first = surfaces[Mathtools::pixelIndex(width_, y0, x0)];
+
+	// background is cheap anyway, textures and baked light change per pixel
+	if (!first || first->getTexture() || first->getNormalMap() || first->getLightmap())
+		return false;
+
+	Material* material = first->getMaterial();
+
+	// secondary rays need exact directions
+	if (!material || material->getReflection() > 0.0 || material->getTransparency() > 0.0)
+		return false;
+
+	Vector3D normal = first->getNormal(points[Mathtools::pixelIndex(width_, y0, x0)]);
+	normal.normalize();
+
+	for (int y = y0; y < y1; y++)
+	{
+		for (int x = x0; x < x1; x++)
+		{
+			int pixel = Mathtools::pixelIndex(width_, y, x);
+			Surface3D* surface = surfaces[pixel];
+
+			if (!surface || surface->getMaterial() != material)
+				return false;
+
+			if (surface->getTexture() || surface->getNormalMap() || surface->getLightmap())
+				return false;
+
+			// smooth normals may bend inside one triangle, too
+			Vector3D other = surface->getNormal(points[pixel]);
+			other.normalize();
+
+			if (Mathtools::dot(normal, other) < shadingNormalCos_)
+				return false;
+
+			// silhouette: same material and normal, but the surface behind is
+			// hit next to it (the center's color would cover its outline)
+			if (x > x0 && std::fabs(dists[pixel] - dists[pixel - 1]) > shadingDepthStep_ * dists[pixel])
+				return false;
+
+			if (y > y0 && std::fabs(dists[pixel] - dists[Mathtools::pixelIndex(width_, y - 1, x)]) > shadingDepthStep_ * dists[pixel])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+Color Renderer3DRaycasting::shadePixel(int x, int y, std::vector<Surface3D*>& surfaces, std::vector<double>& dists)
+{
+	int pixel = Mathtools::pixelIndex(width_, y, x);
+
+	if (!surfaces[pixel])
+		return backgroundColor_;
+
+	shadedPixels_++;
+
+	Ray ray = primaryRay(x, y);
+	unsigned int budget = rayBudget_;
+
+	return shade(ray, surfaces[pixel], dists[pixel], 0, 1.0, &budget);
+}
+
+
+void Renderer3DRaycasting::shadeBlock(int x0, int y0, int size, std::vector<Surface3D*>& surfaces, std::vector<double>& dists, std::vector<Vector3D>& points)
+{
+	// blocks at right and bottom border are smaller
+	int x1 = std::min(x0 + size, cropX1_);
+	int y1 = std::min(y0 + size, cropY1_);
+
+	if (size > 1 && isUniformBlock(x0, y0, x1, y1, surfaces, dists, points))
+	{
+		// shade center pixel, use its color for whole block
+		int cx = std::min(x0 + size / 2, x1 - 1);
+		int cy = std::min(y0 + size / 2, y1 - 1);
+
+		Color color = shadePixel(cx, cy, surfaces, dists);
+
+		// contrast check at two opposite corners (one of them is the center of a 2x2 block)
+		bool flat = true;
+		int corners[2][2] = { { x0, y0 }, { x1 - 1, y1 - 1 } };
+
+		for (int c = 0; c < 2 && flat; c++)
+		{
+			if (corners[c][0] == cx && corners[c][1] == cy)
+				continue;
+
+			Color corner = shadePixel(corners[c][0], corners[c][1], surfaces, dists);
+
+			flat = std::fabs(corner.getRed() - color.getRed()) <= shadingContrast_ &&
+				std::fabs(corner.getGreen() - color.getGreen()) <= shadingContrast_ &&
+				std::fabs(corner.getBlue() - color.getBlue()) <= shadingContrast_;
+		}
+
+		if (flat)
+		{
+			for (int y = y0; y < y1; y++)
+				fillSpan(x0, y, x1 - x0, color);
+
+			return;
+		}
+	}
+
+	if (size > 1)
+	{
+		int half = size / 2;
+
+		for (int y = y0; y < y1; y += half)
+		{
+			for (int x = x0; x < x1; x += half)
+				shadeBlock(x, y, half, surfaces, dists, points);
+		}
+
+		return;
+	}
+
+	Color color = shadePixel(x0, y0, surfaces, dists);
+	writeSpan(x0, y0, 1, &color);
 }
 
 
 void Renderer3DRaycasting::render()
 {
+	// textures of the last frame may be evicted
+	MemoryBudget::nextFrame();
+
+	// evicted triangles of compressed objects can't be reprojected
+	if (scene_->trimDecoded())
+	{
+		lastSurfaces_.clear();
+		lastPoints_.clear();
+	}
+
 	// transform objects in scene
-	TransformMatrix3D transform = camera_->getLookatMatrix();
-	scene_->transform(transform);
+	TransformMatrix3D motion = transformScene();
 
 	// build octrees for each Object3D
 	// delete/comment this line to see rendering without octrees
-	scene_->buildOctrees();
+	Octree::setProxies(levelOfDetail_);
+
+	if (frustumCulling_)
+	{
+		ViewFrustum frustum = camera_->getViewFrustum(frustumMargin_);
+		scene_->buildOctrees(&frustum);
+	}
+	else
+	{
+		scene_->buildOctrees();
+	}
 
 	// create the viewplane
 	double aspect = static_cast<double>(width_) / static_cast<double>(height_);
 	
-	double topEdge = camera_->getNearPlane() * Mathtools::TAN(camera_->getFov() / 2.0);
-	double leftEdge = -topEdge * aspect;
+	topEdge_ = camera_->getNearPlane() * Mathtools::TAN(camera_->getFov() / 2.0);
+	leftEdge_ = -topEdge_ * aspect;
 
-	double step_x = 2.0*(-leftEdge) / static_cast<double>(width_);
-	double step_y = 2.0*topEdge / static_cast<double>(height_);
+	stepX_ = 2.0*(-leftEdge_) / static_cast<double>(width_);
+	stepY_ = 2.0*topEdge_ / static_cast<double>(height_);
 
-	// shoot through every
+	// pixel cone: size of a pixel on the viewplane per unit distance
+	spread_ = levelOfDetail_ ? stepY_ / camera_->getNearPlane() : 0.0;
 
-	for (int y = 0; y < height_; y++)
+	// pixels inside of crop window
+	int pixels = (cropX1_ - cropX0_) * (cropY1_ - cropY0_);
+
+	Mailbox::resetStatistics();
+	secondaryRays_ = 0;
+	prunedRays_ = 0;
+	shadedPixels_ = 0;
+	reprojectedPixels_ = 0;
+
+	if (reprojection_)
+		reproject(motion);
+
+	if (aovPasses_)
 	{
-		for (int x = 0; x < width_; x++)
+		if (!aovBuffer_ || aovBuffer_->getPasses() != aovPasses_ || aovBuffer_->getWidth() != width_ || aovBuffer_->getHeight() != height_)
 		{
-			// prepare ray
-			double px = leftEdge + step_x / 2.0 + static_cast<int>(x) * step_x;
-			double py = topEdge - step_y / 2.0 - static_cast<int>(y) * step_y;
-			double pz = camera_->getNearPlane();
+			delete aovBuffer_;
+			aovBuffer_ = new AOVBuffer(width_, height_, aovPasses_);
+		}
 
-			Vector3D start(0.0, 0.0, 0.0);
-			Vector3D dir(px, py, pz);
-			dir.normalize();
+		aovBuffer_->clear();
 
-			Ray ray(start, dir);
+		if (aovPasses_ & (AOVBuffer::OBJECT_ID | AOVBuffer::TRIANGLE_ID))
+			collectObjectIDs();
+	}
+
+	// primary hits for ambient occlusion, variable rate shading and the next frame
+	std::vector<Surface3D*> surfaces;
+	std::vector<Vector3D> points;
+	std::vector<double> dists;
+
+	if (occlusionSamples_ > 0 || shadingRate_ > 1 || reprojection_)
+	{
+		surfaces.resize(width_ * height_, 0);
+		points.resize(width_ * height_);
+	}
+
+	if (shadingRate_ > 1)
+		dists.resize(width_ * height_);
+
+	// colors of one row inside of the crop window, written at once
+	std::vector<Color> rowColors(cropX1_ - cropX0_);
+
+	// shoot through every
+
+	for (int y = cropY0_; y < cropY1_; y++)
+	{
+		double* depthRow = getDepthRow(y);
+
+		for (int x = cropX0_; x < cropX1_; x++)
+		{
+			// prepare ray
+			Ray ray = primaryRay(x, y);
 
 			// set max distance
 			double dist = camera_->getMaxDepth();
 
+			// sequence: try surfaces of last frame before tracing
+			Surface3D* surface = reprojection_ ? reprojectedSurface(ray, x, y, &dist) : 0;
+
+			if (surface)
+				reprojectedPixels_++;
+
+			// geometry buffers only, no shading
+			if (aovPasses_)
+			{
+				if (!surface)
+					surface = scene_->getClosestSurfaceAtRay(ray, &dist);
+
+				if (reprojection_ && surface)
+				{
+					int pixel = Mathtools::pixelIndex(width_, y, x);
+					surfaces[pixel] = surface;
+					points[pixel] = ray.getPoint(dist);
+				}
+
+				writeAOVs(x, y, ray, surface, dist);
+				depthRow[x] = dist;
+				continue;
+			}
+
+			// variable rate: visibility only, shading follows per block
+			if (shadingRate_ > 1)
+			{
+				int pixel = Mathtools::pixelIndex(width_, y, x);
+
+				if (!surface)
+					surface = scene_->getClosestSurfaceAtRay(ray, &dist);
+
+				surfaces[pixel] = surface;
+				points[pixel] = ray.getPoint(dist);
+				dists[pixel] = dist;
+
+				depthRow[x] = dist;
+				continue;
+			}
+
 			// all set, shoot ray and get a color
-			Color color = raycasting(ray, &dist);
+			Color color;
+
+			if (surface)
+			{
+				unsigned int budget = rayBudget_;
+				color = shade(ray, surface, dist, 0, 1.0, &budget);
+			}
+			else
+			{
+				color = raycasting(ray, &dist, &surface);
+			}
+
+			if ((occlusionSamples_ > 0 || reprojection_) && surface)
+			{
+				int pixel = Mathtools::pixelIndex(width_, y, x);
+				surfaces[pixel] = surface;
+				points[pixel] = ray.getPoint(dist);
+			}
+
+			rowColors[x - cropX0_] = color;
+			depthRow[x] = dist;
+		}
+
+		// variable rate shading colors blocks later, AOVs leave colors alone
+		if (!aovPasses_ && shadingRate_ <= 1)
+			writeSpan(cropX0_, y, cropX1_ - cropX0_, rowColors.data());
+
+		std::cout << "\rRendering...\t" << static_cast<float>((y+1-cropY0_) * 100) / static_cast<float>(cropY1_-cropY0_) << "%\t\t";
+	}
+	std::cout << std::endl;
 
-			colorPixel(x, y, color);
-			setDepth(x, y, dist);
+	if (shadingRate_ > 1 && !aovPasses_)
+	{
+		for (int y = cropY0_; y < cropY1_; y += shadingRate_)
+		{
+			for (int x = cropX0_; x < cropX1_; x += shadingRate_)
+				shadeBlock(x, y, shadingRate_, surfaces, dists, points);
 		}
-		std::cout << "\rRendering...\t" << static_cast<float>((y+1) * 100) / static_cast<float>(height_) << "%\t\t";
+
+		std::cout << "Variable rate shading: " << shadedPixels_ << " of " << pixels << " pixels shaded (";
+		std::cout << static_cast<double>(shadedPixels_ * 100) / static_cast<double>(pixels) << "%)" << std::endl;
 	}
+
+	unsigned long long tests = Mailbox::getTestCount();
+	unsigned long long skipped = Mailbox::getSkippedCount();
+
+	std::cout << "Octree: " << tests << " triangle tests, " << skipped << " duplicated tests skipped by mailboxing";
+	if (tests + skipped > 0)
+		std::cout << " (" << static_cast<double>(skipped * 100) / static_cast<double>(tests + skipped) << "%)";
 	std::cout << std::endl;
+
+	if (secondaryRays_ + prunedRays_ > 0)
+	{
+		std::cout << "Secondary rays: " << secondaryRays_ << " traced (" << static_cast<double>(secondaryRays_) / pixels;
+		std::cout << " per pixel), " << prunedRays_ << " pruned" << std::endl;
+	}
+
+	if (reprojection_)
+	{
+		std::cout << "Reprojection: " << reprojectedPixels_ << " of " << pixels << " pixels reused, ";
+		std::cout << pixels - reprojectedPixels_ << " primary rays traced" << std::endl;
+	}
+
+	if (occlusionSamples_ > 0 && !aovPasses_)
+		ambientOcclusion(surfaces, points);
+
+	// decoded triangles of compressed objects, bounded again at next frame
+	unsigned long long decoded = scene_->getDecodedMemorySize();
+
+	if (decoded > 0)
+		std::cout << "Compressed objects: " << decoded << " bytes decoded (peak " << scene_->getPeakDecodedMemorySize() << " bytes)" << std::endl;
+
+	// hits of this frame are reprojected into the next one
+	if (reprojection_)
+	{
+		lastSurfaces_.swap(surfaces);
+		lastPoints_.swap(points);
+	}
 }
@@ -2,14 +2,163 @@
 #define RENDERER3DRAYCASTING_H_
 
 #include "Renderer3D.h"
+#include "TransformMatrix3D.h"
+#include "Vector3D.h"
 
+#include <vector>
+#include <unordered_map>
+
+class AOVBuffer;
 class Color;
+class Object3D;
 class Ray;
+class Vector3D;
+
+/*
+Raycasting shoots one ray per pixel and shades the closest surface with Phong
+
+Reflective and transparent materials shoot secondary rays (Whitted style)
+recursively. Cost is limited in 3 ways:
+ - max depth of the ray tree
+ - min weight: a branch is only followed if its share of the pixel color is
+   large enough (product of all reflection/transparency factors on its way)
+ - ray budget: max number of secondary rays per pixel, larger branches first
+A pruned branch is replaced by the local Phong color, so the pixel keeps its
+brightness. With budget B a pixel never costs more than 1 + B rays.
+
+Optional ambient occlusion is a second stage: every visible point shoots
+random rays into its hemisphere. All of them are collected in a RayBuffer,
+reordered for coherence and traced at once. The pixel is darkened by the
+part of rays hitting something within the occlusion distance. With few
+rays the occlusion can be filtered by the Denoiser (guided by depth and
+normal of the primary hits) before the pixels are darkened.
+
+Variable rate shading resolves visibility for every pixel first, then shades
+blocks of 4x4 (or 2x2) pixels only once if they look the same: all pixels
+hit the same untextured material without reflection or transparency, their
+normals differ less than a max angle and the depth of neighbouring pixels
+doesn't jump (silhouette of an object in front of itself, like the handle of
+the lamp). The center pixel and two opposite corners are shaded, if their
+colors are close the center's color is used for the whole block (highlights
+and fast changing light fail this contrast check). Other blocks are split into 2x2 blocks, and
+those into single pixels.
+
+Temporal reprojection renders camera sequences (same renderer, camera moved
+between render() calls). The scene stays in view space of the last frame and
+is moved into the new one. All hit points of the last frame are projected
+into the new screen, the nearest one per pixel wins. A pixel tests the
+triangles which landed on it and its 4 neighbours with its own ray: a hit at
+about the same depth is accepted, unless a clearly closer point landed next
+to it (edge of an object, it may be covered now). Only the other pixels are
+traced through the octrees. Shading is always done again.
+
+AOV passes (setAOVPasses) replace the image by geometry buffers: only
+visibility is resolved, nothing is shaded or textured and no secondary or
+occlusion rays are shot. The color buffer is left as it is.
+*/
 
 class Renderer3DRaycasting : public Renderer3D
 {
 private:
-	Color raycasting(Ray& ray, double* dist);
+	// hit: surface found by ray (optional)
+	Color raycasting(Ray& ray, double* dist, Surface3D** hit = 0);
+
+	// build octrees only with triangles inside of the camera's view frustum
+	// (widened by margin), for renderings with primary rays only
+	bool frustumCulling_;
+	double frustumMargin_;
+
+	// level of detail: stop at octree nodes smaller than a pixel
+	bool levelOfDetail_;
+
+	// ambient occlusion rays per pixel (0 = off) and their length
+	unsigned int occlusionSamples_;
+	double occlusionDistance_;
+	bool occlusionDenoising_;
+
+	// sort secondary rays before tracing
+	bool rayReordering_;
+
+	// limits for reflected and refracted rays
+	unsigned int rayDepth_;
+	double minRayWeight_;
+	unsigned int rayBudget_;
+
+	// shade blocks of up to rate x rate pixels at once (1 = every pixel)
+	unsigned int shadingRate_;
+	double shadingNormalCos_;
+	double shadingDepthStep_;
+	double shadingContrast_;
+
+	// temporal reprojection: last frame's hits (view space of last frame)
+	bool reprojection_;
+	double reprojectionTolerance_;
+	bool sceneInViewSpace_;
+	TransformMatrix3D lastView_;
+	std::vector<Surface3D*> lastSurfaces_;
+	std::vector<Vector3D> lastPoints_;
+
+	// last frame's hits projected into current frame (nearest per pixel)
+	std::vector<Surface3D*> reprojectedSurfaces_;
+	std::vector<double> reprojectedDists_;
+
+	// selected passes (AOVBuffer::Pass, 0 = shaded image)
+	unsigned int aovPasses_;
+	AOVBuffer* aovBuffer_;
+
+	// index of every object in the scene (only for ID passes)
+	// triangle IDs come from the hit surface itself
+	std::unordered_map<Object3D*, int> objectIDs_;
+
+	// viewplane of current rendering
+	double leftEdge_, topEdge_;
+	double stepX_, stepY_;
+	double spread_;
+
+	// statistics of last rendering
+	unsigned long long secondaryRays_;
+	unsigned long long prunedRays_;
+	unsigned long long shadedPixels_;
+	unsigned long long reprojectedPixels_;
+
+	// primary ray through center of pixel
+	Ray primaryRay(int x, int y);
+
+	// ray tree: shade closest surface, follow reflection and refraction
+	// budget: secondary rays left for this pixel
+	Color trace(Ray& ray, double* dist, unsigned int depth, double weight, unsigned int* budget, Surface3D** hit = 0);
+
+	// color of surface hit by ray at dist (same as trace(), without intersection)
+	Color shade(Ray& ray, Surface3D* surface, double dist, unsigned int depth, double weight, unsigned int* budget);
+
+	// variable rate shading: primary hits of all pixels are known
+	// shade block of size x size pixels at once if possible, otherwise split it
+	void shadeBlock(int x0, int y0, int size, std::vector<Surface3D*>& surfaces, std::vector<double>& dists, std::vector<Vector3D>& points);
+	bool isUniformBlock(int x0, int y0, int x1, int y1, std::vector<Surface3D*>& surfaces, std::vector<double>& dists, std::vector<Vector3D>& points);
+	Color shadePixel(int x, int y, std::vector<Surface3D*>& surfaces, std::vector<double>& dists);
+
+	// move scene into view space of current camera
+	// returns transformation of last frame's view space into the new one
+	TransformMatrix3D transformScene();
+
+	// temporal reprojection: project last frame's hits into current screen
+	void reproject(TransformMatrix3D& motion);
+
+	// surface of last frame hit by ray of pixel x, y (NULL = trace it)
+	Surface3D* reprojectedSurface(Ray& ray, int x, int y, double* dist);
+
+	// second stage: darken pixels by ambient occlusion
+	// surfaces and points: primary hit of each pixel (surface NULL = no hit)
+	void ambientOcclusion(std::vector<Surface3D*>& surfaces, std::vector<Vector3D>& points);
+
+	// filter visibility (1 = nothing occluded) of all pixels with the Denoiser
+	void denoiseOcclusion(std::vector<Surface3D*>& surfaces, std::vector<Vector3D>& points, std::vector<double>& visibility);
+
+	// fill objectIDs_ with the objects of the scene
+	void collectObjectIDs();
+
+	// write AOVs of pixel x, y (surface NULL = no hit)
+	void writeAOVs(int x, int y, Ray& ray, Surface3D* surface, double dist);
 
 	Renderer3DRaycasting(const Renderer3DRaycasting& src);
 public:
@@ -17,6 +166,38 @@ public:
 	Renderer3DRaycasting(Camera3D& camera);
 	virtual ~Renderer3DRaycasting();
 
+	void setFrustumCulling(bool culling, double margin = 0.0);
+	void setLevelOfDetail(bool levelOfDetail);
+
+	// triangles outside of view frustum can't occlude, use frustum culling with margin
+	void setAmbientOcclusion(unsigned int samples, double distance);
+	// edge-aware filter of the occlusion before darkening
+	void setOcclusionDenoising(bool denoising);
+	void setRayReordering(bool reordering);
+
+	// max depth of reflections/refractions (0 = first hit only)
+	void setRayDepth(unsigned int depth);
+	// branches with smaller weight are not followed
+	void setMinRayWeight(double weight);
+	// max secondary rays per pixel
+	void setRayBudget(unsigned int rays);
+
+	// variable rate shading: rate 2 or 4 = blocks of 2x2 or 4x4 pixels, 1 = off
+	// maxNormalAngle: max angle (degrees) between normals of a shared block
+	// maxDepthStep: max relative depth difference of neighbouring pixels in a shared block
+	// maxContrast: max difference of a color channel between center and corners of a shared block
+	void setShadingRate(unsigned int rate, double maxNormalAngle = 5.0, double maxDepthStep = 0.02, double maxContrast = 0.02);
+
+	// sequence mode: reuse visibility of the last frame
+	// tolerance: max relative depth difference of an accepted pixel
+	void setTemporalReprojection(bool reprojection, double tolerance = 0.05);
+
+	// render geometry buffers only, passes: AOVBuffer::Pass flags (0 = off)
+	void setAOVPasses(unsigned int passes);
+
+	// buffers of last rendering with AOV passes (NULL before)
+	AOVBuffer* getAOVBuffer();
+
 	virtual void render();
 };
 
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <map>
+#include <string>
 
 class TransformMatrix2D;
 class Object2D;
@@ -6,9 +6,17 @@
 #include "Material.h"
 #include "Light.h"
 #include "OBJLoader.h"
+#include "Ray.h"
+#include "RayHit.h"
+#include "WorkerPool.h"
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <utility>
+
+unsigned int Scene3D::RAY_CHUNK_SIZE = 256;
+bool Scene3D::BUMP_MAP = false;
 
 Scene3D::Scene3D()
 {
@@ -77,16 +85,24 @@ void Scene3D::initMaterials()
 
 void Scene3D::initTextures()
 {
-	Image img;
+	// textures are decoded at their first sample (see Texture)
 	Texture* tex = 0;
 
-	img.load("sources/earth.ppm");
-	tex = new Texture(img);
+	tex = new Texture("sources/earth.ppm");
 	textures_["earth"] = tex;
 
 	// normal maps
-	img.load("sources/earth_normalmap.ppm");
-	tex = new Texture(img);
+	if (BUMP_MAP)
+	{
+		// heights between 0 and 1, about the slopes of the normal map
+		tex = new Texture("sources/earth_bumpmap.pgm");
+		tex->convertHeightMap(40.0);
+	}
+	else
+	{
+		tex = new Texture("sources/earth_normalmap.ppm");
+	}
+
 	textures_["earth_normal"] = tex;
 	
 }
@@ -103,6 +119,10 @@ void Scene3D::initObjects()
 	obj->rotateY(-90.0);
 	obj->translate(0.0, 0.0, 8.0);
 	objects_[obj->getID()] = obj;
+
+	// the globe is in front of the camera, decode while octrees are built
+	textures_["earth"]->prefetch();
+	textures_["earth_normal"]->prefetch();
 }
 
 void Scene3D::initLights()
@@ -143,7 +163,7 @@ Surface3D* Scene3D::getClosestSurfaceAtRay(Ray& ray, double* dist)
 {
 	Surface3D* result = 0;
 
-	for (std::pair<std::string, Object3D*> it : objects_)
+	for (const std::pair<const std::string, Object3D*>& it : objects_)
 	{
 		Object3D* object = it.second;
 		Surface3D* tempResult = object->intersect(ray, dist);
@@ -156,6 +176,185 @@ Surface3D* Scene3D::getClosestSurfaceAtRay(Ray& ray, double* dist)
 }
 
 
+Surface3D* Scene3D::getAnySurfaceAtRay(Ray& ray, double* dist)
+{
+	for (const std::pair<const std::string, Object3D*>& it : objects_)
+	{
+		Surface3D* result = it.second->intersect(ray, dist, true);
+
+		if (result)
+			return result;
+	}
+
+	return 0;
+}
+
+
+void Scene3D::sortRays(std::vector<Ray>& rays, std::vector<unsigned int>& order)
+{
+	unsigned int count = rays.size();
+
+	// bounding box of all ray origins
+	double inf = static_cast<double>(INFINITY);
+	Vector3D min(inf, inf, inf), max(-inf, -inf, -inf);
+
+	for (Ray& ray : rays)
+	{
+		Vector3D start = ray.getStart();
+		min.setVector(Mathtools::min(min.getX(), start.getX()), Mathtools::min(min.getY(), start.getY()), Mathtools::min(min.getZ(), start.getZ()));
+		max.setVector(Mathtools::max(max.getX(), start.getX()), Mathtools::max(max.getY(), start.getY()), Mathtools::max(max.getZ(), start.getZ()));
+	}
+
+	Vector3D extent = max - min;
+	double scale[3] = { extent.getX(), extent.getY(), extent.getZ() };
+
+	for (int i = 0; i < 3; i++)
+		scale[i] = scale[i] > 0.0 ? 1023.0 / scale[i] : 0.0;
+
+	// sort key: direction octant (3 bits), origin (30 bits), direction (30 bits)
+	std::vector< std::pair<unsigned long long, unsigned int> > keys(count);
+
+	WorkerPool::run((count + RAY_CHUNK_SIZE - 1) / RAY_CHUNK_SIZE, [&](unsigned int job, unsigned int worker)
+	{
+		unsigned int end = std::min(count, (job + 1) * RAY_CHUNK_SIZE);
+
+		for (unsigned int i = job * RAY_CHUNK_SIZE; i < end; i++)
+		{
+			Vector3D start = rays[i].getStart() - min;
+			Vector3D dir = rays[i].getDirection();
+			dir.normalize();
+
+			unsigned long long octant = (dir.getX() < 0.0 ? 4 : 0) | (dir.getY() < 0.0 ? 2 : 0) | (dir.getZ() < 0.0 ? 1 : 0);
+
+			unsigned long long origin = Mathtools::mortonCode(
+				static_cast<unsigned int>(start.getX() * scale[0]),
+				static_cast<unsigned int>(start.getY() * scale[1]),
+				static_cast<unsigned int>(start.getZ() * scale[2]));
+
+			// direction from [-1,1] to [0,1023]
+			unsigned long long direction = Mathtools::mortonCode(
+				static_cast<unsigned int>((dir.getX() + 1.0) * 511.5),
+				static_cast<unsigned int>((dir.getY() + 1.0) * 511.5),
+				static_cast<unsigned int>((dir.getZ() + 1.0) * 511.5));
+
+			keys[i].first = (octant << 60) | (origin << 30) | direction;
+			keys[i].second = i;
+		}
+	});
+
+	std::sort(keys.begin(), keys.end());
+
+	order.resize(count);
+
+	for (unsigned int i = 0; i < count; i++)
+		order[i] = keys[i].second;
+}
+
+
+void Scene3D::intersectRays(std::vector<Ray>& rays, std::vector<RayHit>& hits, RayQuery query, double maxDist, bool reorder)
+{
+	unsigned int count = rays.size();
+	hits.resize(count);
+
+	std::vector<unsigned int> order;
+
+	if (reorder)
+	{
+		sortRays(rays, order);
+	}
+	else
+	{
+		order.resize(count);
+
+		for (unsigned int i = 0; i < count; i++)
+			order[i] = i;
+	}
+
+	// each job takes a chunk of sorted rays, hits are written at the ray's index
+	WorkerPool::run((count + RAY_CHUNK_SIZE - 1) / RAY_CHUNK_SIZE, [&](unsigned int job, unsigned int worker)
+	{
+		unsigned int end = std::min(count, (job + 1) * RAY_CHUNK_SIZE);
+
+		for (unsigned int i = job * RAY_CHUNK_SIZE; i < end; i++)
+		{
+			unsigned int index = order[i];
+			double dist = maxDist;
+			Surface3D* surface;
+
+			if (query == ANY_HIT)
+				surface = getAnySurfaceAtRay(rays[index], &dist);
+			else
+				surface = getClosestSurfaceAtRay(rays[index], &dist);
+
+			hits[index].setHit(surface, dist);
+		}
+	});
+}
+
+
+Surface3D* Scene3D::getClosestSurfaceToPoint(Vector3D& point, double* dist, Vector3D* closest)
+{
+	Surface3D* result = 0;
+
+	for (const std::pair<const std::string, Object3D*>& it : objects_)
+	{
+		Surface3D* tempResult = it.second->nearestSurface(point, dist, closest);
+
+		if (tempResult)
+			result = tempResult;
+	}
+
+	return result;
+}
+
+
+void Scene3D::getSurfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result)
+{
+	for (const std::pair<const std::string, Object3D*>& it : objects_)
+	{
+		it.second->surfacesInBox(center, size, result);
+	}
+}
+
+
+void Scene3D::getSurfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result)
+{
+	for (const std::pair<const std::string, Object3D*>& it : objects_)
+	{
+		it.second->surfacesInSphere(center, radius, result);
+	}
+}
+
+
+void Scene3D::getCollidingObjects(std::vector< std::pair<Object3D*, Object3D*> >& result)
+{
+	std::vector<Object3D*> objects = getObjectList();
+
+	for (unsigned int i = 0; i < objects.size(); i++)
+	{
+		for (unsigned int j = i + 1; j < objects.size(); j++)
+		{
+			std::vector<SurfacePair> contacts;
+
+			if (objects[i]->collide(*objects[j], contacts, true))
+				result.push_back(std::pair<Object3D*, Object3D*>(objects[i], objects[j]));
+		}
+	}
+}
+
+
+void Scene3D::setBumpMap(bool bumpMap)
+{
+	BUMP_MAP = bumpMap;
+}
+
+
+void Scene3D::setRayChunkSize(unsigned int size)
+{
+	RAY_CHUNK_SIZE = size > 0 ? size : 1;
+}
+
+
 Object3D* Scene3D::getObject(const std::string& key)
 {
 	return objects_[key];
@@ -194,6 +393,30 @@ std::vector<Surface3D*> Scene3D::getTriangleList()
 }
 
 
+void Scene3D::visitTriangles(std::function<void(Surface3D*)> visitor)
+{
+	for (std::pair<std::string, Object3D*> obj : objects_)
+	{
+		obj.second->visitTriangles([&](unsigned int index, Surface3D* triangle)
+		{
+			visitor(triangle);
+			return true;
+		});
+	}
+}
+
+
+unsigned int Scene3D::getTriangleSize()
+{
+	unsigned int size = 0;
+
+	for (std::pair<std::string, Object3D*> obj : objects_)
+		size += obj.second->getTriangleSize();
+
+	return size;
+}
+
+
 std::vector<Light*> Scene3D::getLightList()
 {
 	std::vector<Light*> list;
@@ -230,10 +453,70 @@ void Scene3D::addNewObject(std::string& key, Object3D* object)
 	objects_[key] = object;
 }
 
-void Scene3D::buildOctrees()
+void Scene3D::addNewLight(std::string& key, Light* light)
+{
+	lights_[key] = light;
+}
+
+void Scene3D::addNewTexture(std::string& key, Texture* texture)
 {
+	Texture* old = textures_[key];
+
+	if (old && old != texture)
+		delete old;
+
+	textures_[key] = texture;
+}
+
+void Scene3D::buildOctrees(ViewFrustum* frustum)
+{
+	for (std::pair<std::string, Object3D*> object : objects_)
+	{
+		object.second->buildOctree(frustum);
+	}
+}
+
+
+void Scene3D::compressObjects()
+{
+	for (std::pair<std::string, Object3D*> object : objects_)
+	{
+		object.second->compress();
+	}
+}
+
+
+bool Scene3D::trimDecoded()
+{
+	bool evicted = false;
+
 	for (std::pair<std::string, Object3D*> object : objects_)
 	{
-		object.second->buildOctree();
+		if (object.second->trimDecoded())
+			evicted = true;
 	}
-}
\ No newline at end of file
+
+	return evicted;
+}
+
+
+unsigned long long Scene3D::getDecodedMemorySize()
+{
+	unsigned long long size = 0;
+
+	for (std::pair<std::string, Object3D*> object : objects_)
+		size += object.second->getDecodedMemorySize();
+
+	return size;
+}
+
+
+unsigned long long Scene3D::getPeakDecodedMemorySize()
+{
+	unsigned long long size = 0;
+
+	for (std::pair<std::string, Object3D*> object : objects_)
+		size += object.second->getPeakDecodedMemorySize();
+
+	return size;
+}
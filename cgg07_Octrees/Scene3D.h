@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <cmath>
+#include <functional>
 
 class TransformMatrix3D;
 class Object3D;
@@ -11,6 +14,9 @@ class Surface3D;
 class Light;
 class Material;
 class Ray;
+class ViewFrustum;
+class RayHit;
+class Vector3D;
 
 /*
 Scene2D contains a list of
@@ -21,11 +27,29 @@ Scene2D contains a list of
  - Materials
 
 We can transform each object according to a given TransformMatrix3D
+
+Besides rendering, the scene can answer ray queries (i.e. visibility tests).
+intersectRays() takes a whole array of rays: rays are sorted (same direction
+octant, then close origins and directions) and handed out in chunks to all
+worker threads. Hits are returned in the order of the input rays.
+Octrees should be built before (buildOctrees), otherwise every ray is tested
+against every triangle.
 */
 
 class Scene3D
 {
+public:
+	// closest hit: surface closest to ray start
+	// any hit: any surface closer than max distance (i.e. line of sight)
+	enum RayQuery { CLOSEST_HIT, ANY_HIT };
+
 private:
+	// rays per job in intersectRays()
+	static unsigned int RAY_CHUNK_SIZE;
+
+	// earth gets normals from its bump map instead of the normal map
+	static bool BUMP_MAP;
+
 	std::map<std::string, Object3D*> objects_;
 	std::map<std::string, Light*> lights_;
 	std::map<std::string, Texture*> textures_;
@@ -39,6 +63,9 @@ private:
 	void initLights();
 	void initTextures();
 	void initMaterials();
+
+	// ray indices sorted for coherent traversal
+	void sortRays(std::vector<Ray>& rays, std::vector<unsigned int>& order);
 public:
 	Scene3D();
 	virtual ~Scene3D();
@@ -49,6 +76,30 @@ public:
 	// find closest surface at ray
 	Surface3D* getClosestSurfaceAtRay(Ray& ray, double* dist);
 
+	// find any surface closer than dist
+	Surface3D* getAnySurfaceAtRay(Ray& ray, double* dist);
+
+	// bulk query, hits[i] belongs to rays[i], hits is resized to rays' size
+	// reorder = false keeps input order (i.e. to compare)
+	void intersectRays(std::vector<Ray>& rays, std::vector<RayHit>& hits, RayQuery query = CLOSEST_HIT,
+		double maxDist = static_cast<double>(INFINITY), bool reorder = true);
+
+	static void setRayChunkSize(unsigned int size);
+
+	// call before the scene is created (i.e. before the renderer)
+	static void setBumpMap(bool bumpMap);
+
+	// closest surface to point within dist (i.e. snapping), saves new distance
+	// closest: point on surface (optional)
+	Surface3D* getClosestSurfaceToPoint(Vector3D& point, double* dist, Vector3D* closest = 0);
+
+	// all surfaces touching a box (center, size = half edge length) or sphere
+	void getSurfacesInBox(Vector3D& center, Vector3D& size, std::vector<Surface3D*>& result);
+	void getSurfacesInSphere(Vector3D& center, double radius, std::vector<Surface3D*>& result);
+
+	// all pairs of objects which touch each other (i.e. layout validation)
+	void getCollidingObjects(std::vector< std::pair<Object3D*, Object3D*> >& result);
+
 	// get object
 	Object3D* getObject(const std::string& index);
 	unsigned int getObjectSize();
@@ -63,10 +114,34 @@ public:
 
 	void addNewMaterial(std::string& key, Material* material);
 	void addNewObject(std::string& key, Object3D* object);
+	void addNewLight(std::string& key, Light* light);
+
+	// scene owns the texture, replaces (and deletes) an old one with same key
+	void addNewTexture(std::string& key, Texture* texture);
+
+	// build octree for each object, with a view frustum only visible triangles are added
+	void buildOctrees(ViewFrustum* frustum = 0);
 
-	void buildOctrees();
+	// compress triangles of each object (see Object3D::compress), replaces octrees
+	// afterwards the scene may only be moved and rotated (i.e. by the camera)
+	void compressObjects();
 
+	// evict decoded triangles of compressed objects, call before a frame starts
+	// returns true if surfaces of the last frame may be invalid now
+	bool trimDecoded();
+
+	// bytes of decoded triangles of all compressed objects, now and the sum of their peaks
+	unsigned long long getDecodedMemorySize();
+	unsigned long long getPeakDecodedMemorySize();
+
+	// compressed objects: decodes and keeps all triangles, prefer visitTriangles
 	std::vector<Surface3D*> getTriangleList();
+
+	// visitor(triangle) for each triangle of each object
+	// triangles of compressed objects are temporary (only valid inside of visitor)
+	void visitTriangles(std::function<void(Surface3D*)> visitor);
+	unsigned int getTriangleSize();
+
 	std::vector<Light*> getLightList();
 	std::vector<Object3D*> getObjectList();
 };
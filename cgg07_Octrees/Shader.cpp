@@ -5,6 +5,15 @@
 #include "Object3D.h"
 
 Color Shader::phong(Vector3D& point, Surface3D* triangle, std::vector<Light*> lights)
+{
+	Vector3D viewDir = -point;
+	viewDir.normalize();
+
+	return phong(point, viewDir, triangle, lights);
+}
+
+
+Color Shader::phong(Vector3D& point, Vector3D& viewDir, Surface3D* triangle, std::vector<Light*>& lights)
 {
 	if (lights.size() == 0 || !triangle)
 		return Color();
@@ -15,9 +24,17 @@ Color Shader::phong(Vector3D& point, Surface3D* triangle, std::vector<Light*> li
 
 	Vector3D normal = triangle->getNormal(point);
 
+	// static light is baked: one texture lookup for ambient and diffuse of all lights
+	bool baked = triangle->getLightmap() != 0;
+
+	// clamped like the sum of all lights below
+	if (baked)
+		finalColor = triangle->getColor(point) * triangle->getLightmapColor(point) * triangle->getLightmapScale();
+
 	for (Light* light : lights)
 	{
-		finalColor += triangle->getColor(point) * material->getAmbientColor() * light->getAmbientColor();
+		if (!baked)
+			finalColor += triangle->getColor(point) * material->getAmbientColor() * light->getAmbientColor();
 
 		Vector3D lightDir = light->getPosition() - point;
 		double distance = lightDir.length(); // for attenuation
@@ -27,12 +44,11 @@ Color Shader::phong(Vector3D& point, Surface3D* triangle, std::vector<Light*> li
 
 		double attenuation = 1.0 / (light->getConstantAttenuation() + light->getLinearAttenuation() * distance + light->getQuadraticAttenuation() * distance * distance);
 
-		finalColor += triangle->getColor(point) * material->getDiffuseColor() * light->getDiffuseColor() * Mathtools::max(coeff,0.0) * attenuation;
+		if (!baked)
+			finalColor += triangle->getColor(point) * material->getDiffuseColor() * light->getDiffuseColor() * Mathtools::max(coeff,0.0) * attenuation;
 
 		if (coeff > 0.0)
 		{
-			Vector3D viewDir = -point;
-			viewDir.normalize();
 			lightDir = -lightDir;
 			Vector3D reflectedLightDir = Mathtools::reflect(lightDir, normal);
 			reflectedLightDir.normalize();
@@ -45,4 +61,36 @@ Color Shader::phong(Vector3D& point, Surface3D* triangle, std::vector<Light*> li
 	}
 
 	return finalColor;
-}
\ No newline at end of file
+}
+
+
+Color Shader::directLight(Vector3D& point, Vector3D& normal, Vector3D& viewDir, Surface3D* triangle, Light* light)
+{
+	Material* material = triangle->getMaterial();
+
+	if (!material)
+		return Color();
+
+	Vector3D lightDir = light->getPosition() - point;
+	double distance = lightDir.length();
+	lightDir.normalize();
+
+	double coeff = Mathtools::dot(normal, lightDir);
+
+	if (coeff <= 0.0)
+		return Color();
+
+	double attenuation = 1.0 / (light->getConstantAttenuation() + light->getLinearAttenuation() * distance + light->getQuadraticAttenuation() * distance * distance);
+
+	Color color = triangle->getColor(point) * material->getDiffuseColor() * light->getDiffuseColor() * coeff * attenuation;
+
+	lightDir = -lightDir;
+	Vector3D reflectedLightDir = Mathtools::reflect(lightDir, normal);
+	reflectedLightDir.normalize();
+
+	coeff = Mathtools::dot(reflectedLightDir, viewDir);
+
+	color += material->getSpecularColor() * light->getSpecularColor() * pow(Mathtools::max(coeff, 0.0), material->getShining()) * attenuation;
+
+	return color;
+}
@@ -11,7 +11,18 @@ class Vector3D;
 
 namespace Shader
 {
+	// view direction from point to camera at (0/0/0)
 	Color phong(Vector3D& point, Surface3D* triangle, std::vector<Light*> lights);
+
+	// viewDir: normalized direction from point to viewer (i.e. reflected rays)
+	// surfaces with a lightmap use its baked ambient and diffuse light,
+	// only specular light is computed
+	Color phong(Vector3D& point, Vector3D& viewDir, Surface3D* triangle, std::vector<Light*>& lights);
+
+	// diffuse and specular Phong light of a single light, without ambient light
+	// (i.e. for global illumination, where indirect light replaces ambient)
+	// normal: surface normal at point, facing viewer
+	Color directLight(Vector3D& point, Vector3D& normal, Vector3D& viewDir, Surface3D* triangle, Light* light);
 }
 
 #endif
\ No newline at end of file
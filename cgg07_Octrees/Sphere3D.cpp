@@ -84,8 +84,6 @@ void Sphere3D::initTriangles()
 				static_cast<double>(accuracy_ - r - 1) / static_cast<double>(accuracy_));
 
 			Surface3D* triangle = new Surface3D(p00, p11, p10);
-			triangle->setObject(this);
-
 			triangle->assignTexturePointToObjectPoint(p00, t00);
 			triangle->assignTexturePointToObjectPoint(p11, t11);
 			triangle->assignTexturePointToObjectPoint(p10, t10);
@@ -94,11 +92,9 @@ void Sphere3D::initTriangles()
 			triangle->assignNormalVectorToObjectPoint(p11, n11);
 			triangle->assignNormalVectorToObjectPoint(p10, n10);
 
-			triangles_.push_back(triangle);
+			addTriangle(triangle);
 
 			triangle = new Surface3D(p00, p01, p11);
-			triangle->setObject(this);
-
 			triangle->assignTexturePointToObjectPoint(p00, t00);
 			triangle->assignTexturePointToObjectPoint(p11, t11);
 			triangle->assignTexturePointToObjectPoint(p01, t01);
@@ -107,7 +103,7 @@ void Sphere3D::initTriangles()
 			triangle->assignNormalVectorToObjectPoint(p11, n11);
 			triangle->assignNormalVectorToObjectPoint(p01, n01);
 
-			triangles_.push_back(triangle);
+			addTriangle(triangle);
 		}
 	}
 
@@ -6,7 +6,7 @@
 #include "Object3D.h"
 
 
-Surface3D::Surface3D(Vector3D* p0, Vector3D* p1, Vector3D* p2, Material* material, Texture* texture) : material_(material), texture_(texture), normalMap_(0)
+Surface3D::Surface3D(Vector3D* p0, Vector3D* p1, Vector3D* p2, Material* material, Texture* texture) : material_(material), texture_(texture), normalMap_(0), lightmap_(0), lightmapScale_(1.0f), object_(0), index_(0)
 {
 	points_[0] = p0;
 	points_[1] = p1;
@@ -125,6 +125,12 @@ Object3D* Surface3D::getObject()
 	return object_;
 }
 
+
+unsigned int Surface3D::getIndex()
+{
+	return index_;
+}
+
 // Ray-Triangle-Intersection
 // Mller-Trumbore algorithm
 // https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
@@ -187,6 +193,26 @@ Texture* Surface3D::getNormalMap()
 }
 
 
+Texture* Surface3D::getLightmap()
+{
+	return lightmap_;
+}
+
+
+Color Surface3D::getLightmapColor(Vector3D& point)
+{
+	if (!lightmap_)
+		return Color();
+
+	Vector3D bary = Mathtools::planeBarycentricCoordinates(point, *points_[0], *points_[1], *points_[2]);
+
+	double u = lightmapPoints_[0].getX() * bary.getX() + lightmapPoints_[1].getX() * bary.getY() + lightmapPoints_[2].getX() * bary.getZ();
+	double v = lightmapPoints_[0].getY() * bary.getX() + lightmapPoints_[1].getY() * bary.getY() + lightmapPoints_[2].getY() * bary.getZ();
+
+	return lightmap_->getColor(u, v);
+}
+
+
 Vector3D Surface3D::getNormal()
 {
 	Vector3D v1 = *points_[1] - *points_[0];
@@ -278,6 +304,30 @@ Vector3D Surface3D::getNormal(Vector3D& point)
 	return normal;
 }
 
+Vector3D Surface3D::getVertexNormal(Vector3D& point)
+{
+	Vector3D bary = Mathtools::barycentricCoordinates(point, *points_[0], *points_[1], *points_[2]);
+
+	double temp = bary.getX() + bary.getY() + bary.getZ();
+
+	if (temp < (1.0 - Mathtools::EPSILON) || temp > (1.0 + Mathtools::EPSILON))
+		return getNormal();
+
+	Vector3D normal = normals_[0] + (normals_[1] - normals_[0]) * bary.getY() + (normals_[2] - normals_[0]) * bary.getZ();
+	normal.normalize();
+
+	return normal;
+}
+
+
+Vector2D Surface3D::getTexturePoint(Vector3D& point)
+{
+	Vector3D bary = Mathtools::planeBarycentricCoordinates(point, *points_[0], *points_[1], *points_[2]);
+
+	return texturePoints_[0] * bary.getX() + texturePoints_[1] * bary.getY() + texturePoints_[2] * bary.getZ();
+}
+
+
 Vector3D Surface3D::getCenter()
 {
 	Vector3D sum = *points_[0] + *points_[1] + *points_[2];
@@ -299,6 +349,12 @@ void Surface3D::setObject(Object3D* object)
 }
 
 
+void Surface3D::setIndex(unsigned int index)
+{
+	index_ = index;
+}
+
+
 // surface points -------------------------------------------------------------
 Vector3D* Surface3D::getP0()
 {
@@ -336,6 +392,24 @@ Vector2D& Surface3D::getT2()
 }
 
 
+Vector3D& Surface3D::getN0()
+{
+	return normals_[0];
+}
+
+
+Vector3D& Surface3D::getN1()
+{
+	return normals_[1];
+}
+
+
+Vector3D& Surface3D::getN2()
+{
+	return normals_[2];
+}
+
+
 void Surface3D::linkTexture(Texture* texture)
 {
 	texture_ = texture;
@@ -346,6 +420,25 @@ void Surface3D::linkNormalMap(Texture* normalMap)
 	normalMap_ = normalMap;
 }
 
+void Surface3D::linkLightmap(Texture* lightmap, float scale)
+{
+	lightmap_ = lightmap;
+	lightmapScale_ = scale;
+}
+
+
+float Surface3D::getLightmapScale()
+{
+	return lightmapScale_;
+}
+
+void Surface3D::setLightmapAnchorPoints(Vector2D& t0, Vector2D& t1, Vector2D& t2)
+{
+	lightmapPoints_[0].setVector(t0);
+	lightmapPoints_[1].setVector(t1);
+	lightmapPoints_[2].setVector(t2);
+}
+
 void Surface3D::setTextureAnchorPoints(Vector2D& t0, Vector2D& t1, Vector2D& t2)
 {
 	texturePoints_[0].setVector(t0);
@@ -5,6 +5,8 @@
 #include "Vector3D.h"
 #include "Vector2D.h"
 
+#include <utility>
+
 class Texture;
 class Ray;
 class Object3D;
@@ -25,7 +27,15 @@ private:
 	Texture* texture_;
 	Texture* normalMap_;
 
+	// baked diffuse light (see Lightmap), has its own texture coordinates
+	// texels store light / lightmapScale_, so light above 1 isn't clamped
+	Vector2D lightmapPoints_[3];
+	Texture* lightmap_;
+	float lightmapScale_;
+
+	// object and position in its triangle list, set when the triangle is added
 	Object3D* object_;
+	unsigned int index_;
 
 public:
 	Surface3D(Vector3D& p0, Vector3D& p1, Vector3D& p2, Material* material = 0, Texture* texture = 0);
@@ -40,15 +50,25 @@ public:
 	Material* getMaterial();
 
 	Object3D* getObject();
+	unsigned int getIndex();
 
 	double getArea();
 
 	Texture* getTexture();
 	Texture* getNormalMap();
+	Texture* getLightmap();
+
+	// baked light at point (without surface color), divided by the lightmap's scale
+	Color getLightmapColor(Vector3D& point);
+	float getLightmapScale();
 
 	// used for different shading algorithms
 	Vector3D getNormal();
 	Vector3D getNormal(Vector3D& point);
+
+	// interpolated normal without normal map, texture coordinate at point
+	Vector3D getVertexNormal(Vector3D& point);
+	Vector2D getTexturePoint(Vector3D& point);
 	Vector3D getCenter();
 
 	// is inside query
@@ -58,6 +78,7 @@ public:
 	void setMaterial(Material* material);
 
 	void setObject(Object3D* object);
+	void setIndex(unsigned int index);
 
 	// intersection with a ray
 	// returns true if ray goes through surface and intersection is closer than distance
@@ -70,6 +91,11 @@ public:
 	// set normal map
 	void linkNormalMap(Texture* normalMap);
 
+	// set lightmap and this surface's coordinates in it
+	// scale: factor of the stored light (at least 1)
+	void linkLightmap(Texture* lightmap, float scale = 1.0f);
+	void setLightmapAnchorPoints(Vector2D& t0, Vector2D& t1, Vector2D& t2);
+
 	// normally between 0 and 1, but can be larger for repeated texturing
 	void setTextureAnchorPoints(Vector2D& t0, Vector2D& t1, Vector2D& t2);
 
@@ -94,6 +120,13 @@ public:
 	Vector2D& getT0();
 	Vector2D& getT1();
 	Vector2D& getT2();
+
+	Vector3D& getN0();
+	Vector3D& getN1();
+	Vector3D& getN2();
 };
 
+// two touching surfaces of different objects (collision detection)
+typedef std::pair<Surface3D*, Surface3D*> SurfacePair;
+
 #endif
\ No newline at end of file
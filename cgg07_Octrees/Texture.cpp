@@ -1,20 +1,156 @@
 #include "Texture.h"
 #include "Mathtools.h"
+#include "WorkerPool.h"
+#include "MemoryBudget.h"
 
+#include <sstream>
 
-Texture::Texture() : repeat_(false)
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+Texture::Texture() : repeat_(false), heightStrength_(0.0), decoded_(true), sampled_(0)
 {
+	width_ = image_.getWidth();
+	height_ = image_.getHeight();
+
+	packTexels();
 }
 
 
-Texture::Texture(Image& img) : repeat_(false)
+Texture::Texture(Image& img) : repeat_(false), heightStrength_(0.0), decoded_(true), sampled_(0)
 {
 	image_.copy(img);
+
+	width_ = image_.getWidth();
+	height_ = image_.getHeight();
+
+	packTexels();
+}
+
+
+Texture::Texture(const std::string& filename) : image_(1, 1), repeat_(false), width_(1), height_(1),
+filename_(filename), heightStrength_(0.0), decoded_(false), sampled_(0)
+{
+	Image::readSize(filename_, width_, height_);
+
+	MemoryBudget::addTexture(this);
 }
 
 
 Texture::~Texture()
 {
+	if (prefetch_.joinable())
+		prefetch_.join();
+
+	if (!filename_.empty())
+		MemoryBudget::removeTexture(this);
+
+	MemoryBudget::release(MemoryBudget::TEXTURE, texels_.size() * sizeof(unsigned int));
+}
+
+
+void Texture::decode()
+{
+	std::lock_guard<std::mutex> lock(decodeMutex_);
+
+	// another thread decoded it while we were waiting
+	if (decoded_.load(std::memory_order_relaxed))
+		return;
+
+	// evict() skips textures which are being decoded, so we can't wait for each other
+	std::ostringstream reason;
+	reason << "decoding texture " << filename_;
+
+	MemoryBudget::makeRoom(static_cast<unsigned long long>(width_) * height_ * (sizeof(Color) + sizeof(unsigned int)), reason.str());
+
+	image_.load(filename_);
+
+	width_ = image_.getWidth();
+	height_ = image_.getHeight();
+
+	if (heightStrength_ > 0.0)
+		heightsToNormals(heightStrength_);
+	else
+		packTexels();
+
+	decoded_.store(true, std::memory_order_release);
+}
+
+
+void Texture::use()
+{
+	// mark first, then check: evict() clears decoded_ first, then checks the mark,
+	// so either it keeps the texture or this sample decodes it again
+	unsigned int frame = MemoryBudget::getFrame();
+
+	if (sampled_.load(std::memory_order_relaxed) != frame)
+		sampled_.store(frame);
+
+	if (!decoded_.load())
+		decode();
+}
+
+
+unsigned long long Texture::evict()
+{
+	// a prefetch still decoding may wait in makeRoom() for our caller
+	if (filename_.empty() || !decoded_.load(std::memory_order_acquire))
+		return 0;
+
+	if (prefetch_.joinable())
+		prefetch_.join();
+
+	std::unique_lock<std::mutex> lock(decodeMutex_, std::try_to_lock);
+
+	// another thread decodes it right now
+	if (!lock.owns_lock() || !decoded_.load(std::memory_order_relaxed))
+		return 0;
+
+	decoded_.store(false);
+
+	// sampled in this frame, its texels may be read right now
+	if (sampled_.load() == MemoryBudget::getFrame())
+	{
+		decoded_.store(true);
+		return 0;
+	}
+
+	unsigned long long size = getMemorySize();
+
+	Image empty(1, 1);
+	image_.copy(empty);
+
+	std::vector<unsigned int> texels;
+	setTexels(texels);
+
+	return size - getMemorySize();
+}
+
+
+unsigned long long Texture::getMemorySize()
+{
+	return static_cast<unsigned long long>(image_.getWidth()) * image_.getHeight() * sizeof(Color) + texels_.size() * sizeof(unsigned int);
+}
+
+
+std::string Texture::getFilename()
+{
+	return filename_;
+}
+
+
+void Texture::prefetch()
+{
+	if (!decoded_.load(std::memory_order_acquire) && !prefetch_.joinable())
+		prefetch_ = std::thread(&Texture::decode, this);
+}
+
+
+bool Texture::isDecoded()
+{
+	return decoded_.load(std::memory_order_acquire);
 }
 
 // texture coordinates to pixel coordinates
@@ -22,8 +158,256 @@ Texture::~Texture()
 // the real center of a pixel is half values of row and col
 // r.5 and c.5
 
+void Texture::packTexels()
+{
+	int width = image_.getWidth();
+	int height = image_.getHeight();
+
+	std::vector<unsigned int> texels(width * height);
+
+	for (int row = 0; row < height; row++)
+	{
+		for (int col = 0; col < width; col++)
+		{
+			Color color = image_.getPixel(row, col);
+			float channels[3] = { color.getRed(), color.getGreen(), color.getBlue() };
+			unsigned int texel = 0;
+
+			for (int c = 0; c < 3; c++)
+			{
+				float value = channels[c] * 255.0f;
+				float rounded = floor(value + 0.5f);
+
+				// not an 8 bit color, use reference filter
+				if (rounded < 0.0f || rounded > 255.0f || fabs(value - rounded) > 0.001f)
+				{
+					texels.clear();
+					setTexels(texels);
+					return;
+				}
+
+				texel |= static_cast<unsigned int>(rounded) << (8 * c);
+			}
+
+			texels[Mathtools::pixelIndex(width, row, col)] = texel;
+		}
+	}
+
+	setTexels(texels);
+}
+
+
+void Texture::setTexels(std::vector<unsigned int>& texels)
+{
+	MemoryBudget::release(MemoryBudget::TEXTURE, texels_.size() * sizeof(unsigned int));
+
+	// swap: memory of the old texels is freed with "texels"
+	texels_.swap(texels);
+
+	MemoryBudget::allocate(MemoryBudget::TEXTURE, texels_.size() * sizeof(unsigned int));
+}
+
+
 Color Texture::getColor(double u, double v)
 {
+	use();
+
+	// texels outside of the image are black in the reference filter
+	if (texels_.empty() || u < 0.0 || u >= 1.0 || v <= 0.0 || v > 1.0)
+		return getReferenceColor(u, v);
+
+	return sample(u, v);
+}
+
+
+void Texture::getColors(int count, const double* u, const double* v, Color* colors)
+{
+	use();
+
+	int i = 0;
+
+#ifdef __SSE2__
+	if (!texels_.empty())
+	{
+		for (; i + 1 < count; i += 2)
+		{
+			bool inside = u[i] >= 0.0 && u[i] < 1.0 && v[i] > 0.0 && v[i] <= 1.0 &&
+				u[i + 1] >= 0.0 && u[i + 1] < 1.0 && v[i + 1] > 0.0 && v[i + 1] <= 1.0;
+
+			if (inside)
+			{
+				samplePair(&u[i], &v[i], &colors[i]);
+			}
+			else
+			{
+				colors[i] = getColor(u[i], v[i]);
+				colors[i + 1] = getColor(u[i + 1], v[i + 1]);
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+		colors[i] = getColor(u[i], v[i]);
+}
+
+
+// sample() with 16 bit lanes: RGBA of the first sample, RGBA of the second
+
+void Texture::samplePair(const double* u, const double* v, Color* colors)
+{
+#ifdef __SSE2__
+	int width = image_.getWidth();
+	int height = image_.getHeight();
+
+	// both addresses at once, truncated like static_cast<int>
+	__m128i x = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(u), _mm_set1_pd(width * 256.0)), _mm_set1_pd(0.5)));
+	__m128i y = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_loadu_pd(v)), _mm_set1_pd(height * 256.0)), _mm_set1_pd(0.5)));
+
+	x = _mm_sub_epi32(x, _mm_set1_epi32(128));
+	y = _mm_sub_epi32(y, _mm_set1_epi32(128));
+
+	int xs[4], ys[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(xs), x);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(ys), y);
+
+	// left and right texels of the top and bottom row of each sample
+	unsigned int topLeft[2], topRight[2], bottomLeft[2], bottomRight[2];
+	int wx[2], wy[2];
+
+	// texels are fetched one by one, SSE2 has no gather
+	for (int s = 0; s < 2; s++)
+	{
+		int col = xs[s] >> 8;
+		int row = ys[s] >> 8;
+
+		wx[s] = xs[s] & 255;
+		wy[s] = ys[s] & 255;
+
+		int colLeft = col < 0 ? 0 : col;
+		int colRight = col + 1 > width - 1 ? width - 1 : col + 1;
+		int rowTop = row < 0 ? 0 : row;
+		int rowBottom = row + 1 > height - 1 ? height - 1 : row + 1;
+
+		topLeft[s] = texels_[rowTop * width + colLeft];
+		topRight[s] = texels_[rowTop * width + colRight];
+		bottomLeft[s] = texels_[rowBottom * width + colLeft];
+		bottomRight[s] = texels_[rowBottom * width + colRight];
+	}
+
+	__m128i zero = _mm_setzero_si128();
+
+	__m128i left0 = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(topLeft[0]), _mm_cvtsi32_si128(topLeft[1])), zero);
+	__m128i right0 = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(topRight[0]), _mm_cvtsi32_si128(topRight[1])), zero);
+	__m128i left1 = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(bottomLeft[0]), _mm_cvtsi32_si128(bottomLeft[1])), zero);
+	__m128i right1 = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(bottomRight[0]), _mm_cvtsi32_si128(bottomRight[1])), zero);
+
+	__m128i weightsLeft = _mm_set_epi16(256 - wx[1], 256 - wx[1], 256 - wx[1], 256 - wx[1], 256 - wx[0], 256 - wx[0], 256 - wx[0], 256 - wx[0]);
+	__m128i weightsRight = _mm_set_epi16(wx[1], wx[1], wx[1], wx[1], wx[0], wx[0], wx[0], wx[0]);
+	__m128i weightsTop = _mm_set_epi16(256 - wy[1], 256 - wy[1], 256 - wy[1], 256 - wy[1], 256 - wy[0], 256 - wy[0], 256 - wy[0], 256 - wy[0]);
+	__m128i weightsBottom = _mm_set_epi16(wy[1], wy[1], wy[1], wy[1], wy[0], wy[0], wy[0], wy[0]);
+
+	// horizontal: sums fit into unsigned 16 bit
+	__m128i h0 = _mm_add_epi16(_mm_mullo_epi16(left0, weightsLeft), _mm_mullo_epi16(right0, weightsRight));
+	__m128i h1 = _mm_add_epi16(_mm_mullo_epi16(left1, weightsLeft), _mm_mullo_epi16(right1, weightsRight));
+
+	// vertical: full 32 bit products
+	__m128i low0 = _mm_mullo_epi16(h0, weightsTop);
+	__m128i high0 = _mm_mulhi_epu16(h0, weightsTop);
+	__m128i low1 = _mm_mullo_epi16(h1, weightsBottom);
+	__m128i high1 = _mm_mulhi_epu16(h1, weightsBottom);
+
+	__m128i sum0 = _mm_add_epi32(_mm_unpacklo_epi16(low0, high0), _mm_unpacklo_epi16(low1, high1));
+	__m128i sum1 = _mm_add_epi32(_mm_unpackhi_epi16(low0, high0), _mm_unpackhi_epi16(low1, high1));
+
+	__m128 scale = _mm_set1_ps(1.0f / (255.0f * 65536.0f));
+
+	float channels[8];
+	_mm_storeu_ps(channels, _mm_mul_ps(_mm_cvtepi32_ps(sum0), scale));
+	_mm_storeu_ps(channels + 4, _mm_mul_ps(_mm_cvtepi32_ps(sum1), scale));
+
+	colors[0] = Color(channels[0], channels[1], channels[2]);
+	colors[1] = Color(channels[4], channels[5], channels[6]);
+#else
+	colors[0] = sample(u[0], v[0]);
+	colors[1] = sample(u[1], v[1]);
+#endif
+}
+
+
+// pixel centers at .5 like in the reference filter, 8 fractional bits
+// weights w and 256 - w: the 16 bit products of 8 bit colors don't overflow
+
+Color Texture::sample(double u, double v)
+{
+	int width = image_.getWidth();
+	int height = image_.getHeight();
+
+	int x = static_cast<int>(u * width * 256.0 + 0.5) - 128;
+	int y = static_cast<int>((1.0 - v) * height * 256.0 + 0.5) - 128;
+
+	// arithmetic shift: -1 for the left half of the first texel
+	int col = x >> 8;
+	int row = y >> 8;
+
+	int wx = x & 255;
+	int wy = y & 255;
+
+	int colLeft = col < 0 ? 0 : col;
+	int colRight = col + 1 > width - 1 ? width - 1 : col + 1;
+	int rowTop = row < 0 ? 0 : row;
+	int rowBottom = row + 1 > height - 1 ? height - 1 : row + 1;
+
+	const unsigned int* top = &texels_[rowTop * width];
+	const unsigned int* bottom = &texels_[rowBottom * width];
+
+	float channels[4];
+
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+
+	// 16 bit lanes: left texel's RGBA, right texel's RGBA
+	__m128i rowTopTexels = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(top[colLeft]), _mm_cvtsi32_si128(top[colRight])), zero);
+	__m128i rowBottomTexels = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(bottom[colLeft]), _mm_cvtsi32_si128(bottom[colRight])), zero);
+
+	__m128i weightsX = _mm_set_epi16(wx, wx, wx, wx, 256 - wx, 256 - wx, 256 - wx, 256 - wx);
+	__m128i weightsY = _mm_set_epi16(wy, wy, wy, wy, 256 - wy, 256 - wy, 256 - wy, 256 - wy);
+
+	// horizontal: sums fit into unsigned 16 bit
+	__m128i h0 = _mm_mullo_epi16(rowTopTexels, weightsX);
+	__m128i h1 = _mm_mullo_epi16(rowBottomTexels, weightsX);
+
+	h0 = _mm_add_epi16(h0, _mm_srli_si128(h0, 8));
+	h1 = _mm_add_epi16(h1, _mm_srli_si128(h1, 8));
+
+	// vertical: full 32 bit products
+	__m128i rows = _mm_unpacklo_epi64(h0, h1);
+	__m128i low = _mm_mullo_epi16(rows, weightsY);
+	__m128i high = _mm_mulhi_epu16(rows, weightsY);
+
+	__m128i sum = _mm_add_epi32(_mm_unpacklo_epi16(low, high), _mm_unpackhi_epi16(low, high));
+
+	_mm_storeu_ps(channels, _mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(1.0f / (255.0f * 65536.0f))));
+#else
+	for (int c = 0; c < 4; c++)
+	{
+		int shift = 8 * c;
+
+		unsigned int h0 = ((top[colLeft] >> shift) & 255) * (256 - wx) + ((top[colRight] >> shift) & 255) * wx;
+		unsigned int h1 = ((bottom[colLeft] >> shift) & 255) * (256 - wx) + ((bottom[colRight] >> shift) & 255) * wx;
+
+		channels[c] = (h0 * (256 - wy) + h1 * wy) * (1.0f / (255.0f * 65536.0f));
+	}
+#endif
+
+	return Color(channels[0], channels[1], channels[2]);
+}
+
+
+Color Texture::getReferenceColor(double u, double v)
+{
+	use();
+
 	if (!repeat_ && (u < 0.0 || u > 1.0 || v < 0.0 || v > 1.0))
 		return Color();
 
@@ -99,6 +483,75 @@ Color Texture::getColor(double u, double v)
 }
 
 
+// red: -dh/dx (columns), green: -dh/dy (rows, downwards), like earth_normalmap.ppm
+
+void Texture::convertHeightMap(double strength)
+{
+	// lazy textures convert again after being evicted
+	if (!filename_.empty())
+		heightStrength_ = strength;
+
+	if (decoded_.load(std::memory_order_acquire))
+		heightsToNormals(strength);
+}
+
+
+void Texture::heightsToNormals(double strength)
+{
+	int width = image_.getWidth();
+	int height = image_.getHeight();
+
+	std::vector<float> heights(width * height);
+
+	for (int row = 0; row < height; row++)
+	{
+		for (int col = 0; col < width; col++)
+			heights[Mathtools::pixelIndex(width, row, col)] = image_.getPixel(row, col).getRed();
+	}
+
+	std::vector<Color> normals(width * height);
+
+	WorkerPool::run(height, [&](unsigned int job, unsigned int worker)
+	{
+		int row = static_cast<int>(job);
+
+		// border texels are repeated
+		int rows[3] = { row > 0 ? row - 1 : 0, row, row < height - 1 ? row + 1 : height - 1 };
+
+		for (int col = 0; col < width; col++)
+		{
+			int cols[3] = { col > 0 ? col - 1 : 0, col, col < width - 1 ? col + 1 : width - 1 };
+			float h[3][3];
+
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+					h[r][c] = heights[Mathtools::pixelIndex(width, rows[r], cols[c])];
+			}
+
+			// Sobel, divided by 8: slope per texel
+			double dx = ((h[0][2] + 2.0 * h[1][2] + h[2][2]) - (h[0][0] + 2.0 * h[1][0] + h[2][0])) / 8.0;
+			double dy = ((h[2][0] + 2.0 * h[2][1] + h[2][2]) - (h[0][0] + 2.0 * h[0][1] + h[0][2])) / 8.0;
+
+			Vector3D normal(-dx * strength, -dy * strength, 1.0);
+			normal.normalize();
+
+			// 8 bit colors, so the fast sampling kernel can be used
+			Color& color = normals[Mathtools::pixelIndex(width, row, col)];
+
+			color.setRed(static_cast<unsigned char>(floor((normal.getX() * 0.5 + 0.5) * 255.0 + 0.5)));
+			color.setGreen(static_cast<unsigned char>(floor((normal.getY() * 0.5 + 0.5) * 255.0 + 0.5)));
+			color.setBlue(static_cast<unsigned char>(floor((normal.getZ() * 0.5 + 0.5) * 255.0 + 0.5)));
+		}
+	});
+
+	Image normalMap(width, height, normals.data());
+	image_.copy(normalMap);
+
+	packTexels();
+}
+
+
 void Texture::repeatMode(bool repeat)
 {
 	repeat_ = repeat;
@@ -113,10 +566,10 @@ bool Texture::isRepeatMode()
 
 int Texture::getImageWidth()
 {
-	return image_.getWidth();
+	return width_;
 }
 
 int Texture::getImageHeight()
 {
-	return image_.getHeight();
+	return height_;
 }
\ No newline at end of file
@@ -3,7 +3,44 @@
 
 #include "Image.h"
 
-// A texture can be linked with 1 or more surfaces
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/*
+A texture can be linked with 1 or more surfaces
+
+getColor() samples bilinear with fixed point: texel addresses and weights
+have 8 fractional bits and the 2x2 texels (8 bit per channel, packed RGBA)
+are blended with integer SIMD. The result differs from the reference filter
+(getReferenceColor) by less than 1/255 per channel.
+
+Only textures with 8 bit colors (loaded images) get packed texels, others
+(i.e. lightmaps) and coordinates at or outside of the image's border use the
+reference filter.
+
+getColors() samples several coordinates at once (i.e. a span of pixels). With
+SSE2 two coordinates go through the kernel together: both fixed point
+addresses are converted in one step and the texels of both samples are
+blended in the lanes of the same registers. Results are the same as
+getColor's.
+
+Bump maps: convertHeightMap() turns a height map (i.e. a PGM) into a tangent
+space normal map once (Sobel filter, rows in parallel). Link it with
+linkNormalMap, shading then needs one fetch per sample.
+
+Lazy textures (constructed with a file name) only read the file's header at
+first, the pixels are decoded by the first sample. Exactly one thread
+decodes, others wait for it. prefetch() starts decoding in the background
+for textures which will surely be needed (i.e. during scene setup). A height
+map conversion of a lazy texture is done right after decoding.
+
+Decoding makes room in the MemoryBudget first. Lazy textures can be evicted
+unless they were sampled in the current frame (see MemoryBudget), the next
+sample decodes them again.
+*/
 
 class Texture
 {
@@ -11,18 +48,84 @@ private:
 	Image image_;
 	bool repeat_;
 
+	// size known before decoding
+	int width_;
+	int height_;
+
+	// lazy textures only: file and height map strength (0 = no conversion)
+	std::string filename_;
+	double heightStrength_;
+
+	std::mutex decodeMutex_;
+	std::atomic<bool> decoded_;
+	std::thread prefetch_;
+
+	// frame of the last sample, textures sampled in the current frame stay
+	std::atomic<unsigned int> sampled_;
+
+	// load pixels once, called by the first sample or prefetch()
+	void decode();
+
+	// every sample: mark the frame, then decode if needed
+	void use();
+
+	void heightsToNormals(double strength);
+
+	// RGBA, 8 bit per channel, empty if colors don't fit into 8 bit
+	std::vector<unsigned int> texels_;
+
+	void packTexels();
+
+	// replace texels and report their memory
+	void setTexels(std::vector<unsigned int>& texels);
+
+	// fixed point kernel, u in [0, 1), v in (0, 1]
+	Color sample(double u, double v);
+
+	// same kernel for two coordinates at once (SSE2 only)
+	void samplePair(const double* u, const double* v, Color* colors);
+
 public:
 	Texture();
 	Texture(Image& img);
+
+	// lazy texture: reads only the header of the anymap
+	Texture(const std::string& filename);
 	virtual ~Texture();
 
 	Color getColor(double u, double v);
+	void getColors(int count, const double* u, const double* v, Color* colors);
+
+	// bilinear filter in floating point
+	Color getReferenceColor(double u, double v);
+
 	void repeatMode(bool repeat);
 
+	// decode in a background thread, call after convertHeightMap
+	void prefetch();
+	bool isDecoded();
+
+	// lazy textures only: free pixels until the next sample, returns freed bytes
+	// (0 if sampled in the current frame or being decoded)
+	unsigned long long evict();
+
+	// bytes of pixels and texels
+	unsigned long long getMemorySize();
+
+	// empty if not lazy
+	std::string getFilename();
+
+	// heights (red channel, 0 to 1) to normals, same encoding as normal maps
+	// strength: slope of a height difference of 1 between neighbour texels
+	// signs as in earth_normalmap.ppm: red grows where heights fall to the right,
+	// green where they fall towards the bottom row (checked by CGG bumpmap)
+	// lazy textures convert after decoding
+	void convertHeightMap(double strength);
+
 	int getImageWidth();
 	int getImageHeight();
 
 	bool isRepeatMode();
 };
 
-#endif
\ No newline at end of file
+#endif
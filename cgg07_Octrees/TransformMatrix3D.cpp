@@ -35,34 +35,20 @@ double& TransformMatrix3D::at(const int row, const int col)
 double TransformMatrix3D::det()
 {
 	double result = 0.0;
-	const int size = 4;
 
-	// sum first
+	// expansion along first row, each minor is a 3x3 determinant (rule of Sarrus)
 
-	for (int c = 0; c < size; c++)
+	for (int c = 0; c < 4; c++)
 	{
-		double product = 1.0;
+		int c0 = c == 0 ? 1 : 0;
+		int c1 = c <= 1 ? 2 : 1;
+		int c2 = c <= 2 ? 3 : 2;
 
-		for (int r = 0; r < size; r++)
-		{
-			product *= k_[r][(r + c) % size];
-		}
-
-		result += product;
-	}
-
-	// now substract
-
-	for (int c = 0; c < size; c++)
-	{
-		double product = 1.0;
-
-		for (int r = 0; r < size; r++)
-		{
-			product *= k_[r][((size - 1) - r + c) % size];
-		}
+		double minor = k_[1][c0] * (k_[2][c1] * k_[3][c2] - k_[2][c2] * k_[3][c1])
+			- k_[1][c1] * (k_[2][c0] * k_[3][c2] - k_[2][c2] * k_[3][c0])
+			+ k_[1][c2] * (k_[2][c0] * k_[3][c1] - k_[2][c1] * k_[3][c0]);
 
-		result -= product;
+		result += (c % 2 == 0 ? 1.0 : -1.0) * k_[0][c] * minor;
 	}
 
 	return result;
@@ -0,0 +1,81 @@
+#include "ViewFrustum.h"
+#include "Mathtools.h"
+
+
+ViewFrustum::ViewFrustum(double tanX, double tanY, double far, double margin) : planeCount_(0), margin_(margin)
+{
+	// side planes go through camera center, i.e. right plane: x <= z * tanX
+	setPlane(planeCount_++, -1.0, 0.0, tanX, 0.0);   // right
+	setPlane(planeCount_++,  1.0, 0.0, tanX, 0.0);   // left
+	setPlane(planeCount_++, 0.0, -1.0, tanY, 0.0);   // top
+	setPlane(planeCount_++, 0.0,  1.0, tanY, 0.0);   // bottom
+
+	// rays start at camera center, nothing behind it can be seen
+	setPlane(planeCount_++, 0.0, 0.0, 1.0, 0.0);
+
+	// z <= far
+	if (far < Mathtools::INF)
+		setPlane(planeCount_++, 0.0, 0.0, -1.0, far);
+}
+
+
+ViewFrustum::ViewFrustum(const ViewFrustum& src) : planeCount_(src.planeCount_), margin_(src.margin_)
+{
+	for (int i = 0; i < PLANES; i++)
+	{
+		normal_[i].setVector(src.normal_[i]);
+		distance_[i] = src.distance_[i];
+	}
+}
+
+
+ViewFrustum::~ViewFrustum()
+{
+}
+
+
+void ViewFrustum::setPlane(int index, double x, double y, double z, double distance)
+{
+	// normalize, so that margin is a real distance
+	Vector3D normal(x, y, z);
+	double length = normal.length();
+
+	normal_[index].setVector(x / length, y / length, z / length);
+	distance_[index] = distance / length;
+}
+
+
+double ViewFrustum::planeDistance(int index, Vector3D& point)
+{
+	return Mathtools::dot(normal_[index], point) + distance_[index];
+}
+
+
+bool ViewFrustum::isInside(Vector3D& point)
+{
+	for (int i = 0; i < planeCount_; i++)
+	{
+		if (planeDistance(i, point) < -margin_)
+			return false;
+	}
+
+	return true;
+}
+
+
+bool ViewFrustum::isTriangleVisible(Vector3D& p0, Vector3D& p1, Vector3D& p2)
+{
+	for (int i = 0; i < planeCount_; i++)
+	{
+		if (planeDistance(i, p0) < -margin_ && planeDistance(i, p1) < -margin_ && planeDistance(i, p2) < -margin_)
+			return false;
+	}
+
+	return true;
+}
+
+
+double ViewFrustum::getMargin()
+{
+	return margin_;
+}
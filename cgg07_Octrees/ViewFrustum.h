@@ -0,0 +1,51 @@
+#ifndef VIEWFRUSTUM_H_
+#define VIEWFRUSTUM_H_
+
+#include "Vector3D.h"
+
+/*
+A view frustum describes everything a camera can see, in view space (camera
+center at (0/0/0), looking along the z-axis)
+
+It consists of up to 6 planes (left, right, top, bottom, behind camera and
+far). Each plane stores its normal pointing inside and a distance value, so
+a point p is inside of a plane if dot(normal, p) + distance >= -margin.
+
+The margin (in world units) widens the frustum, so geometry slightly outside
+of view (i.e. needed for reflections or shadows) can be kept as well.
+
+Triangles are culled conservatively: only if all 3 points are outside of
+the same plane. Therefore a visible triangle is never culled.
+*/
+
+class ViewFrustum
+{
+private:
+	static const int PLANES = 6;
+
+	Vector3D normal_[PLANES];
+	double distance_[PLANES];
+
+	// planes in use (far plane is ignored for infinite far distance)
+	int planeCount_;
+
+	double margin_;
+
+	void setPlane(int index, double x, double y, double z, double distance);
+
+	// signed distance between point and plane (positive = inside)
+	double planeDistance(int index, Vector3D& point);
+
+public:
+	// tanX and tanY: tangent of half horizontal/vertical opening angle
+	ViewFrustum(double tanX, double tanY, double far, double margin = 0.0);
+	ViewFrustum(const ViewFrustum& src);
+	virtual ~ViewFrustum();
+
+	bool isInside(Vector3D& point);
+	bool isTriangleVisible(Vector3D& p0, Vector3D& p1, Vector3D& p2);
+
+	double getMargin();
+};
+
+#endif
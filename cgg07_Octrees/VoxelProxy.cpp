@@ -0,0 +1,197 @@
+#include "VoxelProxy.h"
+#include "Surface3D.h"
+#include "Mathtools.h"
+#include "Ray.h"
+
+double VoxelProxy::COVERAGE_MIN = 0.5;
+
+
+VoxelProxy::VoxelProxy(std::vector<Surface3D*>& surfaces, Vector3D& center, Vector3D& size) :
+coneCos_(1.0), coverage_(0.0), surface_(0), backSurface_(0)
+{
+	// sums of area weighted values
+	double areaSum = 0.0;
+	Vector3D normalSum;
+
+	double diffuse[3] = { 0.0, 0.0, 0.0 };
+	double ambient[3] = { 0.0, 0.0, 0.0 };
+	double specular[3] = { 0.0, 0.0, 0.0 };
+	double shining = 0.0;
+
+	for (Surface3D* surface : surfaces)
+	{
+		double area = surface->getArea();
+
+		if (!(area > 0.0))
+			continue;
+
+		Vector3D point = surface->getCenter();
+		Color color = surface->getColor(point);
+		Material* material = surface->getMaterial();
+
+		if (material)
+		{
+			Color d = color * material->getDiffuseColor();
+			Color a = color * material->getAmbientColor();
+			Color s = material->getSpecularColor();
+
+			diffuse[0] += d.getRed() * area;
+			diffuse[1] += d.getGreen() * area;
+			diffuse[2] += d.getBlue() * area;
+
+			ambient[0] += a.getRed() * area;
+			ambient[1] += a.getGreen() * area;
+			ambient[2] += a.getBlue() * area;
+
+			specular[0] += s.getRed() * area;
+			specular[1] += s.getGreen() * area;
+			specular[2] += s.getBlue() * area;
+
+			shining += material->getShining() * area;
+		}
+
+		normalSum = normalSum + surface->getNormal() * area;
+		areaSum += area;
+	}
+
+	if (areaSum <= 0.0)
+		return;
+
+	// normal cone
+	normal_ = normalSum;
+
+	if (normal_.length() > Mathtools::EPSILON)
+		normal_.normalize();
+	else
+		normal_.setVector(0.0, 0.0, 1.0);
+
+	for (Surface3D* surface : surfaces)
+	{
+		Vector3D n = surface->getNormal();
+		coneCos_ = Mathtools::min(coneCos_, Mathtools::dot(n, normal_));
+	}
+
+	// coverage: projected triangle areas compared to node's projected area
+	// a triangle can't cover more than the whole node
+	double nx = normal_.getX() < 0.0 ? -normal_.getX() : normal_.getX();
+	double ny = normal_.getY() < 0.0 ? -normal_.getY() : normal_.getY();
+	double nz = normal_.getZ() < 0.0 ? -normal_.getZ() : normal_.getZ();
+
+	double sx = size.getX(), sy = size.getY(), sz = size.getZ();
+	double crossSection = 4.0 * (sy * sz * nx + sx * sz * ny + sx * sy * nz);
+	double covered = 0.0;
+
+	for (Surface3D* surface : surfaces)
+	{
+		Vector3D n = surface->getNormal();
+		double projected = surface->getArea() * Mathtools::dot(n, normal_);
+
+		if (projected < 0.0)
+			projected = -projected;
+
+		covered += Mathtools::min(projected, crossSection);
+	}
+
+	coverage_ = crossSection > 0.0 ? Mathtools::min(covered / crossSection, 1.0) : 1.0;
+
+	// material and albedo
+	double d[3], a[3];
+
+	for (int i = 0; i < 3; i++)
+	{
+		d[i] = sqrt(diffuse[i] / areaSum);
+		a[i] = d[i] > 0.0 ? (ambient[i] / areaSum) / d[i] : 0.0;
+	}
+
+	albedo_.setColor(diffuse[0] / areaSum, diffuse[1] / areaSum, diffuse[2] / areaSum);
+
+	material_.setDiffuseColor(d[0], d[1], d[2]);
+	material_.setAmbientColor(a[0], a[1], a[2]);
+	material_.setSpecularColor(specular[0] / areaSum, specular[1] / areaSum, specular[2] / areaSum);
+	material_.setShining(shining / areaSum);
+
+	// proxy triangle around center, perpendicular to normal
+	// inner circle of triangle is larger than the node
+	Vector3D helper = nx < 0.9 ? Vector3D(1.0, 0.0, 0.0) : Vector3D(0.0, 1.0, 0.0);
+	Vector3D u = Mathtools::cross(helper, normal_);
+	u.normalize();
+	Vector3D v = Mathtools::cross(normal_, u);
+
+	double radius = 2.0 * size.length();
+
+	for (int i = 0; i < 3; i++)
+	{
+		// corners of an equilateral triangle, counter clockwise around normal
+		double angle = 90.0 + 120.0 * i;
+		Vector3D corner = u * (Mathtools::COS(angle) * 2.0 * radius) + v * (Mathtools::SIN(angle) * 2.0 * radius);
+
+		points_[i] = center + corner;
+		backPoints_[2 - i] = points_[i];
+	}
+
+	surface_ = new Surface3D(points_[0], points_[1], points_[2], &material_);
+	backSurface_ = new Surface3D(backPoints_[0], backPoints_[1], backPoints_[2], &material_);
+}
+
+
+VoxelProxy::VoxelProxy(const VoxelProxy& src)
+{
+}
+
+
+VoxelProxy::~VoxelProxy()
+{
+	delete surface_;
+	delete backSurface_;
+}
+
+
+void VoxelProxy::setCoverageMin(double coverage)
+{
+	COVERAGE_MIN = coverage;
+}
+
+
+Color VoxelProxy::getAlbedo()
+{
+	return albedo_;
+}
+
+
+Vector3D VoxelProxy::getNormal()
+{
+	return normal_;
+}
+
+
+double VoxelProxy::getNormalConeCos()
+{
+	return coneCos_;
+}
+
+
+double VoxelProxy::getCoverage()
+{
+	return coverage_;
+}
+
+
+bool VoxelProxy::isSolid()
+{
+	return surface_ && coverage_ >= COVERAGE_MIN;
+}
+
+
+Surface3D* VoxelProxy::intersection(Ray& ray, double* distance)
+{
+	if (!surface_ || !surface_->intersection(ray, distance))
+		return 0;
+
+	// wide normal cone: triangles face in all directions, show side facing the ray
+	Vector3D dir = ray.getDirection();
+
+	if (coneCos_ < 0.0 && Mathtools::dot(normal_, dir) > 0.0)
+		return backSurface_;
+
+	return surface_;
+}
@@ -0,0 +1,75 @@
+#ifndef VOXELPROXY_H_
+#define VOXELPROXY_H_
+
+#include <vector>
+
+#include "Vector3D.h"
+#include "Material.h"
+
+class Surface3D;
+class Ray;
+
+/*
+A voxel proxy is a prefiltered replacement for all triangles inside of an
+octree node, used when the whole node is smaller than a pixel
+
+It stores
+ - average albedo (area weighted surface color * diffuse color)
+ - normal cone: average normal and the cosine of the largest angle between
+   average normal and a triangle normal
+ - coverage: how much of the node's cross section (seen along the average
+   normal) is covered by triangles, 0 = empty, 1 = completely covered
+
+For shading, the proxy is a flat triangle through the node's center, facing
+along the average normal and larger than the node. Its material is chosen
+so Shader::phong returns the area weighted ambient and diffuse reflection of
+the original triangles:
+  diffuse = sqrt(average(color * diffuse))
+  ambient = average(color * ambient) / diffuse
+If the normal cone is wider than 90 degrees (i.e. a small closed object),
+the proxy can be seen from both sides, so it faces the ray.
+*/
+
+class VoxelProxy
+{
+private:
+	// minimal coverage to replace triangles by the proxy
+	static double COVERAGE_MIN;
+
+	Color albedo_;
+	Vector3D normal_;
+	double coneCos_;
+	double coverage_;
+
+	Material material_;
+
+	// front and back side of the proxy, own their points
+	Vector3D points_[3];
+	Vector3D backPoints_[3];
+	Surface3D* surface_;
+	Surface3D* backSurface_;
+
+	VoxelProxy(const VoxelProxy& src);
+
+public:
+	// surfaces: all triangles of node (each only once)
+	// center and size: node's AABB (size is half of the edge length)
+	VoxelProxy(std::vector<Surface3D*>& surfaces, Vector3D& center, Vector3D& size);
+	virtual ~VoxelProxy();
+
+	static void setCoverageMin(double coverage);
+
+	Color getAlbedo();
+	Vector3D getNormal();
+	double getNormalConeCos();
+	double getCoverage();
+
+	// true if coverage is high enough to replace the triangles
+	bool isSolid();
+
+	// intersection with proxy triangle, same as Surface3D::intersection
+	// returns proxy surface (for shading) or 0
+	Surface3D* intersection(Ray& ray, double* distance);
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "WorkerPool.h"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+unsigned int WorkerPool::THREAD_COUNT = 0;
+bool WorkerPool::AFFINITY = true;
+std::vector< std::vector<unsigned int> > WorkerPool::NODES;
+unsigned int WorkerPool::NODE_COUNT = 0;
+thread_local int WorkerPool::CURRENT_NODE = -1;
+
+static std::once_flag topologyRead;
+
+static std::atomic<unsigned long long> localJobCount(0);
+static std::atomic<unsigned long long> stolenJobCount(0);
+
+// a run() which pins its workers is running
+static std::atomic<bool> pinningRun(false);
+
+
+void WorkerPool::setThreadCount(unsigned int count)
+{
+	THREAD_COUNT = count;
+}
+
+
+unsigned int WorkerPool::getThreadCount()
+{
+	if (THREAD_COUNT > 0)
+		return THREAD_COUNT;
+
+	// hardware_concurrency() may return 0 if it's unknown
+	unsigned int count = std::thread::hardware_concurrency();
+
+	return count > 0 ? count : 1;
+}
+
+
+void WorkerPool::setAffinity(bool affinity)
+{
+	AFFINITY = affinity;
+}
+
+
+bool WorkerPool::getAffinity()
+{
+	return AFFINITY;
+}
+
+
+// cpulist of a node, i.e. "0-3,8-11"
+static std::vector<unsigned int> parseCPUList(const std::string& list)
+{
+	std::vector<unsigned int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+
+	while (std::getline(stream, range, ','))
+	{
+		unsigned int first = 0, last = 0;
+		char dash = 0;
+
+		std::stringstream values(range);
+
+		if (!(values >> first))
+			continue;
+
+		last = first;
+
+		if (values >> dash >> last && dash != '-')
+			last = first;
+
+		for (unsigned int cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+
+	return cpus;
+}
+
+
+void WorkerPool::readTopology()
+{
+	NODES.clear();
+
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	bool restricted = sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0;
+
+	// node numbers may have gaps (i.e. offline nodes), stop after a few missing ones
+	for (unsigned int node = 0, missing = 0; missing < 8; node++)
+	{
+		std::ostringstream filename;
+		filename << "/sys/devices/system/node/node" << node << "/cpulist";
+
+		std::ifstream ifs(filename.str());
+		std::string list;
+
+		if (!ifs || !std::getline(ifs, list))
+		{
+			missing++;
+			continue;
+		}
+
+		missing = 0;
+
+		std::vector<unsigned int> cpus;
+
+		for (unsigned int cpu : parseCPUList(list))
+		{
+			if (!restricted || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+				cpus.push_back(cpu);
+		}
+
+		// nodes without (usable) cores only have memory
+		if (!cpus.empty())
+			NODES.push_back(cpus);
+	}
+
+	if (NODE_COUNT > 0)
+	{
+		// fake topology: all usable cores, split into contiguous ranges
+		// (fewer cores than nodes: nodes share them)
+		std::vector<unsigned int> cpus;
+
+		for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (restricted ? CPU_ISSET(cpu, &allowed) : cpu < std::thread::hardware_concurrency())
+				cpus.push_back(cpu);
+		}
+
+		if (!cpus.empty())
+		{
+			NODES.clear();
+
+			for (unsigned int node = 0; node < NODE_COUNT; node++)
+			{
+				unsigned int first = node * cpus.size() / NODE_COUNT;
+				unsigned int last = (node + 1) * cpus.size() / NODE_COUNT;
+
+				if (last == first)
+					NODES.push_back(std::vector<unsigned int>(1, cpus[node % cpus.size()]));
+				else
+					NODES.push_back(std::vector<unsigned int>(cpus.begin() + first, cpus.begin() + last));
+			}
+		}
+	}
+#endif
+
+	// unknown topology: one node, cores are not pinned
+	if (NODES.empty())
+		NODES.push_back(std::vector<unsigned int>());
+}
+
+
+bool WorkerPool::pin(unsigned int node, int core)
+{
+	std::vector<unsigned int>& cpus = NODES[node];
+
+	if (cpus.empty())
+		return false;
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	if (core < 0)
+	{
+		for (unsigned int cpu : cpus)
+			CPU_SET(cpu, &set);
+	}
+	else
+	{
+		CPU_SET(cpus[core % cpus.size()], &set);
+	}
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0)
+		return false;
+
+	CURRENT_NODE = node;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+void WorkerPool::setNodeCount(unsigned int count)
+{
+	NODE_COUNT = count;
+}
+
+
+unsigned int WorkerPool::getNodeCount()
+{
+	std::call_once(topologyRead, readTopology);
+
+	return NODES.size();
+}
+
+
+int WorkerPool::getCurrentNode()
+{
+	return CURRENT_NODE;
+}
+
+
+void WorkerPool::run(unsigned int jobs, std::function<void(unsigned int, unsigned int)> job)
+{
+	if (jobs == 0)
+		return;
+
+	unsigned int count = getThreadCount();
+
+	if (count > jobs)
+		count = jobs;
+
+	unsigned int nodes = AFFINITY ? getNodeCount() : 1;
+
+	// one node: nothing to gain. Nested (caller pinned) or concurrent runs: the
+	// pinned run owns the cores, this one shares them unpinned
+	bool pinning = false;
+
+	if (nodes > 1 && CURRENT_NODE < 0)
+	{
+		bool running = false;
+		pinning = pinningRun.compare_exchange_strong(running, true);
+	}
+
+	if (!pinning)
+		nodes = 1;
+
+	// next free job of each node, a cache line each
+	struct Queue
+	{
+		std::atomic<unsigned int> next;
+		unsigned int end;
+		char padding[56];
+	};
+
+	std::vector<Queue> queues(nodes);
+
+	for (unsigned int node = 0; node < nodes; node++)
+	{
+		queues[node].next = static_cast<unsigned long long>(node) * jobs / nodes;
+		queues[node].end = static_cast<unsigned long long>(node + 1) * jobs / nodes;
+	}
+
+	auto worker = [&](unsigned int id)
+	{
+		unsigned int home = id % nodes;
+
+		if (pinning)
+			pin(home, id / nodes);
+
+		unsigned long long local = 0, stolen = 0;
+
+		// own node first, then help the others
+		for (unsigned int n = 0; n < nodes; n++)
+		{
+			Queue& queue = queues[(home + n) % nodes];
+
+			for (unsigned int index = queue.next++; index < queue.end; index = queue.next++)
+			{
+				job(index, id);
+
+				if (n == 0)
+					local++;
+				else
+					stolen++;
+			}
+		}
+
+		if (nodes > 1)
+		{
+			localJobCount += local;
+			stolenJobCount += stolen;
+		}
+	};
+
+	// calling thread works as well, so we only need count - 1 new threads
+	std::vector<std::thread> threads;
+
+	for (unsigned int id = 1; id < count; id++)
+		threads.push_back(std::thread(worker, id));
+
+#ifdef __linux__
+	// calling thread gets its cores back afterwards
+	cpu_set_t callerSet;
+	int callerNode = CURRENT_NODE;
+	bool restore = pinning && pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &callerSet) == 0;
+#endif
+
+	worker(0);
+
+#ifdef __linux__
+	if (restore)
+	{
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &callerSet);
+		CURRENT_NODE = callerNode;
+	}
+#endif
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (pinning)
+		pinningRun = false;
+}
+
+
+void WorkerPool::runPerNode(std::function<void(unsigned int)> job)
+{
+	unsigned int nodes = getNodeCount();
+
+	if (nodes == 1)
+	{
+		job(0);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+
+	for (unsigned int node = 0; node < nodes; node++)
+	{
+		threads.push_back(std::thread([&job, node]()
+		{
+			pin(node, -1);
+			job(node);
+		}));
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+
+unsigned long long WorkerPool::getLocalJobCount()
+{
+	return localJobCount;
+}
+
+
+unsigned long long WorkerPool::getStolenJobCount()
+{
+	return stolenJobCount;
+}
+
+
+void WorkerPool::resetStatistics()
+{
+	localJobCount = 0;
+	stolenJobCount = 0;
+}
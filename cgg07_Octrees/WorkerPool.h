@@ -0,0 +1,86 @@
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <functional>
+#include <vector>
+
+/*
+WorkerPool distributes independent jobs (i.e. screen tiles) over worker threads
+
+run(jobs, job) calls job(index, worker) for every index in [0, jobs). Jobs are
+handed out one after another, so a worker which finishes early just takes the
+next free job. "worker" is the number of the calling thread (0 to count - 1)
+and can be used to access per thread scratch memory.
+
+run() returns after all jobs are done. Jobs must not write to the same memory
+(i.e. two tiles never share a pixel).
+
+With affinity (setAffinity, on by default) on more than one NUMA node every
+worker is pinned to one core, worker w to NUMA node w % nodes. Only one run()
+pins at a time: a run() inside of a job (i.e. a lazy texture decoded by a
+tile) or next to another one (i.e. a prefetch thread) leaves its threads
+unpinned, so they don't crowd the cores of the pinned workers. The NUMA nodes and their cores are read once
+from /sys/devices/system/node (Linux only, otherwise there is one node). On
+more than one node, the jobs are split into one contiguous range per node
+(node n starts at n * jobs / nodes): workers take the jobs of their own node first and only steal
+from the other nodes when their range is empty. Memory which is first written
+inside a job of node n (i.e. rows of the color buffer) lands on node n, so
+later jobs with the same index read local memory. runPerNode() runs one
+thread on each node, i.e. to copy read-mostly data per node.
+
+setNodeCount() fakes a topology: the usable cores are split into that many
+nodes. All memory is still on the real nodes, so this only exercises the
+scheduling and the copies per node on a machine with one node (see
+"CGG numa" and numa_benchmark.sh).
+*/
+
+class WorkerPool
+{
+private:
+	// number of worker threads, 0 = use all hardware threads
+	static unsigned int THREAD_COUNT;
+
+	// pin workers to cores and prefer jobs of their own node
+	static bool AFFINITY;
+
+	// cores of each NUMA node (only the ones this process may use)
+	static std::vector< std::vector<unsigned int> > NODES;
+
+	// fake number of nodes, 0 = read the topology
+	static unsigned int NODE_COUNT;
+
+	// node of the calling thread, -1 if it isn't pinned
+	static thread_local int CURRENT_NODE;
+
+	static void readTopology();
+
+	// pin calling thread to one core (core < 0: all cores) of node
+	static bool pin(unsigned int node, int core);
+public:
+	static void setThreadCount(unsigned int count);
+	static unsigned int getThreadCount();
+
+	static void setAffinity(bool affinity);
+	static bool getAffinity();
+
+	// before the first run: split the cores into "count" nodes (0 = real topology)
+	static void setNodeCount(unsigned int count);
+	static unsigned int getNodeCount();
+
+	// node the calling thread is pinned to, -1 if it isn't (i.e. affinity off)
+	// only reads a thread local, cheap enough for every ray
+	static int getCurrentNode();
+
+	static void run(unsigned int jobs, std::function<void(unsigned int, unsigned int)> job);
+
+	// job(node) once for each node, on a thread of that node
+	static void runPerNode(std::function<void(unsigned int)> job);
+
+	// jobs of runs on more than one node since last reset
+	// local: taken by a worker of the job's node, stolen: by a worker of another node
+	static unsigned long long getLocalJobCount();
+	static unsigned long long getStolenJobCount();
+	static void resetStatistics();
+};
+
+#endif
@@ -1,36 +1,744 @@
 #include "Image.h"
 #include "Renderer3DRaycasting.h"
+#include "Renderer3DPathtracing.h"
+#include "Renderer3DRasterization.h"
+#include "Renderer2D.h"
 #include "Camera3D.h"
+#include "Scene3D.h"
+#include "Light.h"
+#include "Lightmap.h"
 #include "Mathtools.h"
+#include "WorkerPool.h"
+#include "Octree.h"
+#include "AOVBuffer.h"
+#include "MemoryBudget.h"
+#include "Texture.h"
+#include "Material.h"
 
 #include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdlib>
 #include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
 
 // Mathtools.h incluces all Vector and Transform classes
 // #include "Mathtools.h"
 
-int main(int argc, char** argv)
-{
-	clock_t start, end;
-	start = clock();
+// CGG                  raycast the 3D scene into output/image.ppm
+// CGG 2d [tessellated] draw the 2D scene into output/image2d(_tessellated).ppm
+// CGG lightmap [lights] 3D scene with more lights, live and baked shading compared
+// CGG planar           3D scene with ambient occlusion, interleaved and planar colors compared
+// CGG numa nodes affinity replication
+//                      pathtrace a fixed frame, see numa_benchmark.sh (nodes 0 = real topology)
+// CGG denoise          pathtracing and ambient occlusion with few samples, raw and denoised
+//                      into output/image_{path,ao}_{raw,denoised}.ppm
+// CGG shading          3D scene with shading rates 1, 2 and 4, time and difference to rate 1
+// CGG sequence [frames] camera path with temporal reprojection, every frame compared to a full render
+// CGG crop             crop window of raycasting and rasterization compared to a full render
+// CGG compress         3D scene with uncompressed and compressed triangles compared
+// CGG budget [MB]      compressed 3D scene rendered 3 times under a small memory budget, evictions reported
+// CGG bumpmap          normals of earth_bumpmap.pgm compared with earth_normalmap.ppm (signs and renderings)
+// CGG whitted [depth]  reflective lamp and transparent globe, ray depth 0 and depth compared
+// CGG aov              geometry passes of the 3D scene into output/passes.aov
+// CGG diff a.ppm b.ppm count differing pixels of two images
 
-	std::cout << "Computer Graphics Guide" << std::endl;
-	
-	Camera3D camera;
+static void setupCamera(Camera3D& camera)
+{
 	camera.setCenter(10, 3, 0);
 	camera.setLookat(0, 0, 3);
 	camera.setLookUp(0, 1, 0);
 
 	camera.setPerspective(60.0, 1.0, 100);
 	camera.setScreenSize(800, 600);
+}
+
+
+static void render3D()
+{
+	Camera3D camera;
+	setupCamera(camera);
 
 	Renderer3DRaycasting renderer(camera);
+
+	// we only shoot primary rays, no need to store triangles outside of view
+	renderer.setFrustumCulling(true);
 	renderer.render();
 
 	Image img = renderer.createImage();
 	Image depthImg = renderer.createDepthImage();
 
 	img.save("output/image");
+}
+
+
+static void render2D(bool tessellated)
+{
+	// analytic shapes filled with their triangles, to compare both
+	Renderer2D::setAnalyticShapes(!tessellated);
+
+	Renderer2D renderer;
+	renderer.render();
+
+	Image img = renderer.createImage();
+	img.save(tessellated ? "output/image2d_tessellated" : "output/image2d");
+}
+
+
+static Image renderLights(int lights, bool baked)
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	Scene3D* scene = renderer.getScene();
+
+	// strong lights around the lamp, together far brighter than 1
+	for (int i = 0; i < lights; i++)
+	{
+		std::ostringstream key;
+		key << "parity" << i;
+
+		Light* light = new Light();
+		light->setPosition(9.0, 6.0 * (i % 3) - 3.0, -6.0 + 2.0 * i);
+		light->setAmbientColor(0.1f, 0.1f, 0.1f);
+		light->setDiffuseColor(0.6f, 0.5f, 0.4f);
+
+		std::string name = key.str();
+		scene->addNewLight(name, light);
+	}
+
+	if (baked)
+	{
+		// the raycaster has no shadows, compare light alone
+		Lightmap lightmap(*scene);
+		lightmap.setShadows(false);
+		lightmap.bake();
+	}
+
+	renderer.render();
+
+	Image img = renderer.createImage();
+	img.save(baked ? "output/image_baked" : "output/image_live");
+
+	return img;
+}
+
+
+static int lightmapParity(int lights)
+{
+	Image live = renderLights(lights, false);
+	Image baked = renderLights(lights, true);
+
+	// lightmaps are filtered 8 bit textures
+	const int TOLERANCE = 8;
+
+	int maxDelta = 0;
+	int count = live.compare(baked, &maxDelta, TOLERANCE);
+
+	std::cout << "Lightmap parity with " << lights + 1 << " lights: " << count << " pixels differ by more than ";
+	std::cout << TOLERANCE << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	// light is interpolated between texels, large triangles with few texels
+	// differ a little where light changes fast (attenuation, angle to the
+	// light). Light summed wrong is off everywhere.
+	int allowed = live.getWidth() * live.getHeight() / 2000;
+
+	return count > allowed ? 1 : 0;
+}
+
+
+static Image renderOcclusion(bool planar)
+{
+	Renderer::setPlanarColors(planar);
+
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	renderer.setAmbientOcclusion(4, 1.0);
+	renderer.render();
+
+	Image img = renderer.createImage();
+	Renderer::setPlanarColors(false);
+
+	return img;
+}
+
+
+static int planarParity()
+{
+	Image interleaved = renderOcclusion(false);
+	Image planar = renderOcclusion(true);
+
+	int maxDelta = 0;
+	int count = interleaved.compare(planar, &maxDelta);
+
+	std::cout << "Planar colors with ambient occlusion: " << count << " pixels differ";
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	return count > 0 ? 1 : 0;
+}
+
+
+static void numaBenchmark(unsigned int nodes, bool affinity, bool replication)
+{
+	WorkerPool::setNodeCount(nodes);
+	WorkerPool::setAffinity(affinity);
+	Octree::setReplication(replication);
+
+	Camera3D camera;
+	setupCamera(camera);
+	camera.setScreenSize(320, 240);
+
+	// fixed samples and seed: every run does the same work
+	Renderer3DPathtracing renderer(camera);
+	renderer.setSamples(8, 8);
+	renderer.setSeed(1);
+
+	auto start = std::chrono::steady_clock::now();
+	renderer.render();
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "NUMA benchmark: " << WorkerPool::getNodeCount() << " nodes, affinity " << (affinity ? "on" : "off");
+	std::cout << ", replication " << (replication ? "on" : "off") << ": ";
+	std::cout << std::chrono::duration<double>(end - start).count() << " seconds" << std::endl;
+}
+
+
+static Image renderDenoising(bool pathtracing, bool denoising)
+{
+	Camera3D camera;
+	setupCamera(camera);
+	camera.setScreenSize(320, 240);
+
+	std::string name = std::string("output/image_") + (pathtracing ? "path" : "ao") + (denoising ? "_denoised" : "_raw");
+
+	if (pathtracing)
+	{
+		// few samples and a fixed seed: raw image is noisy, both get the same noise
+		Renderer3DPathtracing renderer(camera);
+		renderer.setSamples(4, 4);
+		renderer.setSeed(1);
+		renderer.setDenoising(denoising);
+		renderer.render();
+
+		Image img = renderer.createImage();
+		img.save(name);
+
+		return img;
+	}
+	else
+	{
+		Renderer3DRaycasting renderer(camera);
+		renderer.setAmbientOcclusion(4, 1.0);
+		renderer.setOcclusionDenoising(denoising);
+		renderer.render();
+
+		Image img = renderer.createImage();
+		img.save(name);
+
+		return img;
+	}
+}
+
+
+static void denoisingComparison()
+{
+	for (int pathtracing = 1; pathtracing >= 0; pathtracing--)
+	{
+		Image raw = renderDenoising(pathtracing != 0, false);
+		Image denoised = renderDenoising(pathtracing != 0, true);
+
+		int maxDelta = 0;
+		int count = raw.compare(denoised, &maxDelta);
+
+		std::cout << (pathtracing ? "Pathtracing" : "Ambient occlusion") << " denoised: " << count << " pixels changed";
+		std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+	}
+}
+
+
+static Image renderShadingRate(unsigned int rate, double* seconds)
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	renderer.setShadingRate(rate);
+
+	auto start = std::chrono::steady_clock::now();
+	renderer.render();
+	*seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream name;
+	name << "output/image_rate" << rate;
+
+	Image img = renderer.createImage();
+	img.save(name.str());
+
+	return img;
+}
+
+
+static void shadingRateComparison()
+{
+	double fullSeconds = 0.0;
+	Image full = renderShadingRate(1, &fullSeconds);
+
+	// 8 bit steps of smooth shading are fine, edges and highlights are not
+	const int TOLERANCE = 8;
+
+	for (unsigned int rate = 2; rate <= 4; rate *= 2)
+	{
+		double seconds = 0.0;
+		Image coarse = renderShadingRate(rate, &seconds);
+
+		int maxDelta = 0;
+		int count = full.compare(coarse, &maxDelta, TOLERANCE);
+
+		std::cout << "Shading rate " << rate << ": " << seconds << " seconds (rate 1: " << fullSeconds << "), ";
+		std::cout << count << " pixels differ by more than " << TOLERANCE << " (largest difference " << maxDelta << " of 255)" << std::endl;
+	}
+}
+
+
+static void moveCamera(Camera3D& camera, int frame)
+{
+	// small steps sideways and up, like a slow camera pan
+	camera.setCenter(10.0, 3.0 + 0.05 * frame, 0.1 * frame);
+}
+
+
+static int reprojectionSequence(int frames)
+{
+	// one renderer for the whole sequence, it keeps the last frame
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting sequence(camera);
+	sequence.setTemporalReprojection(true);
+
+	// a few pixels may differ: a neighbour's triangle accepted at almost the same depth
+	const int TOLERANCE = 8;
+	int worst = 0;
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		moveCamera(*sequence.getCamera(), frame);
+		sequence.render();
+
+		Image reprojected = sequence.createImage();
+
+		// reference: new renderer, nothing reused
+		Camera3D frameCamera;
+		setupCamera(frameCamera);
+		moveCamera(frameCamera, frame);
+
+		Renderer3DRaycasting single(frameCamera);
+		single.render();
+
+		Image full = single.createImage();
+
+		int maxDelta = 0;
+		int count = full.compare(reprojected, &maxDelta, TOLERANCE);
+		worst = std::max(worst, count);
+
+		std::cout << "Frame " << frame << ": " << count << " pixels differ by more than " << TOLERANCE;
+		std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+	}
+
+	int allowed = camera.getScreenWidth() * camera.getScreenHeight() / 1000;
+
+	return worst > allowed ? 1 : 0;
+}
+
+
+static int compareCrop(Renderer3D& full, Renderer3D& crop, const std::string& name)
+{
+	// across the lamp's lid and the left half of the earth
+	const int X0 = 250, Y0 = 150, X1 = 550, Y1 = 450;
+
+	full.render();
+	Image fullImg = full.createImage();
+
+	crop.setCropWindow(X0, Y0, X1, Y1);
+	crop.render();
+	Image cropImg = crop.createCropImage();
+
+	// same region of the full rendering
+	std::vector<Color> region((X1 - X0) * (Y1 - Y0));
+
+	for (int y = Y0; y < Y1; y++)
+	{
+		for (int x = X0; x < X1; x++)
+			region[Mathtools::pixelIndex(X1 - X0, y - Y0, x - X0)] = fullImg.getPixel(y, x);
+	}
+
+	Image regionImg(X1 - X0, Y1 - Y0, region.data());
+
+	int maxDelta = 0;
+	int count = regionImg.compare(cropImg, &maxDelta);
+
+	std::cout << name << " crop window: " << count << " of " << region.size() << " pixels differ";
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	return count != 0 ? 1 : 0;
+}
+
+
+static int cropParity()
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting fullRaycasting(camera);
+	Renderer3DRaycasting cropRaycasting(camera);
+	int result = compareCrop(fullRaycasting, cropRaycasting, "Raycasting");
+
+	Renderer3DRasterization fullRasterization(camera);
+	Renderer3DRasterization cropRasterization(camera);
+	result |= compareCrop(fullRasterization, cropRasterization, "Rasterization");
+
+	return result;
+}
+
+
+static Image renderCompressed(bool compressed)
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+
+	if (compressed)
+		renderer.getScene()->compressObjects();
+
+	renderer.render();
+
+	Image img = renderer.createImage();
+	img.save(compressed ? "output/image_compressed" : "output/image_uncompressed");
+
+	return img;
+}
+
+
+static int compressionParity()
+{
+	Image uncompressed = renderCompressed(false);
+	Image compressed = renderCompressed(true);
+
+	// quantized points and normals move edges and highlights a little
+	const int TOLERANCE = 8;
+
+	int maxDelta = 0;
+	int count = uncompressed.compare(compressed, &maxDelta, TOLERANCE);
+
+	std::cout << "Compressed triangles: " << count << " pixels differ by more than " << TOLERANCE;
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	// a few pixels along silhouettes, a wrong transform or decode breaks whole objects
+	int allowed = uncompressed.getWidth() * uncompressed.getHeight() / 1000;
+
+	return count > allowed ? 1 : 0;
+}
+
+
+static int budgetFrames(double megabytes)
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	// reference without budget
+	Renderer3DRaycasting unlimited(camera);
+	unlimited.getScene()->compressObjects();
+	unlimited.render();
+
+	Image reference = unlimited.createImage();
+
+	MemoryBudget::setBudget(static_cast<unsigned long long>(megabytes * 1024.0 * 1024.0));
+
+	// textures and decoded triangles are evicted between (and while) frames
+	// sequence mode: the scene stays in view space, not transformed again each frame
+	Renderer3DRaycasting renderer(camera);
+	renderer.getScene()->compressObjects();
+	renderer.setTemporalReprojection(true);
+
+	int result = 0;
+
+	for (int frame = 0; frame < 3; frame++)
+	{
+		unsigned int steps = MemoryBudget::getStepCount();
+		renderer.render();
+
+		std::cout << "Frame " << frame << ": " << MemoryBudget::getStepCount() - steps << " budget steps" << std::endl;
+		MemoryBudget::printUsage();
+
+		// evicted data is decoded again, the image must not change
+		Image img = renderer.createImage();
+		int count = reference.compare(img);
+
+		if (count != 0)
+		{
+			std::cout << "Frame " << frame << ": " << count << " pixels differ from rendering without budget" << std::endl;
+			result = 1;
+		}
+	}
+
+	MemoryBudget::setBudget(0);
+
+	return result;
+}
+
+
+static Image renderBumpMap(bool bumpMap)
+{
+	Scene3D::setBumpMap(bumpMap);
+
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	renderer.render();
+
+	Scene3D::setBumpMap(false);
+
+	Image img = renderer.createImage();
+	img.save(bumpMap ? "output/image_bumpmap" : "output/image_normalmap");
+
+	return img;
+}
+
+
+static int bumpMapParity()
+{
+	// same strength as the scene
+	Texture converted("sources/earth_bumpmap.pgm");
+	converted.convertHeightMap(40.0);
+
+	Texture reference("sources/earth_normalmap.ppm");
+
+	int width = reference.getImageWidth();
+	int height = reference.getImageHeight();
+
+	// correlation of x (red) and y (green) of both normals at every texel
+	// a flipped sign gives a negative one
+	double products[2] = { 0.0, 0.0 };
+	double squaresConverted[2] = { 0.0, 0.0 };
+	double squaresReference[2] = { 0.0, 0.0 };
+
+	for (int row = 0; row < height; row++)
+	{
+		for (int col = 0; col < width; col++)
+		{
+			double u = (col + 0.5) / width;
+			double v = (row + 0.5) / height;
+
+			Color a = converted.getReferenceColor(u, v);
+			Color b = reference.getReferenceColor(u, v);
+
+			double x[2] = { a.getRed() * 2.0 - 1.0, a.getGreen() * 2.0 - 1.0 };
+			double y[2] = { b.getRed() * 2.0 - 1.0, b.getGreen() * 2.0 - 1.0 };
+
+			for (int c = 0; c < 2; c++)
+			{
+				products[c] += x[c] * y[c];
+				squaresConverted[c] += x[c] * x[c];
+				squaresReference[c] += y[c] * y[c];
+			}
+		}
+	}
+
+	double correlation[2];
+
+	for (int c = 0; c < 2; c++)
+		correlation[c] = products[c] / sqrt(squaresConverted[c] * squaresReference[c]);
+
+	std::cout << "Bump map normals against normal map: correlation " << correlation[0] << " (red, x), ";
+	std::cout << correlation[1] << " (green, y)" << std::endl;
+
+	Image normalMap = renderBumpMap(false);
+	Image bumpMap = renderBumpMap(true);
+
+	// maps come from different sources, shading differs in details only
+	const int TOLERANCE = 16;
+
+	int maxDelta = 0;
+	int count = normalMap.compare(bumpMap, &maxDelta, TOLERANCE);
+
+	std::cout << "Rendered with bump map: " << count << " pixels differ by more than " << TOLERANCE;
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	// independent maps agree only roughly, wrong signs disagree
+	return correlation[0] > 0.5 && correlation[1] > 0.5 ? 0 : 1;
+}
+
+
+static Image renderWhitted(unsigned int depth)
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	Scene3D* scene = renderer.getScene();
+
+	// the lamp's MTL file has neither reflection nor transparency (d 1, Ni 1)
+	Material* lamp = scene->getMaterial("Material");
+	Material* globe = scene->getMaterial("metal");
+
+	if (lamp)
+		lamp->setReflection(0.4f);
+
+	if (globe)
+	{
+		globe->setTransparency(0.3f);
+		globe->setRefractiveIndex(1.3f);
+	}
+
+	renderer.setRayDepth(depth);
+	renderer.render();
+
+	std::ostringstream name;
+	name << "output/image_whitted" << depth;
+
+	Image img = renderer.createImage();
+	img.save(name.str());
+
+	return img;
+}
+
+
+static int whittedComparison(unsigned int depth)
+{
+	Image local = renderWhitted(0);
+	Image traced = renderWhitted(depth);
+
+	int maxDelta = 0;
+	int count = local.compare(traced, &maxDelta);
+
+	std::cout << "Ray depth " << depth << " against first hits only: " << count << " pixels differ";
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	// reflections and refractions have to show up
+	return depth > 0 && count == 0 ? 1 : 0;
+}
+
+
+static int renderAOVs()
+{
+	Camera3D camera;
+	setupCamera(camera);
+
+	Renderer3DRaycasting renderer(camera);
+	renderer.setAOVPasses(AOVBuffer::DEPTH | AOVBuffer::NORMAL | AOVBuffer::OBJECT_ID | AOVBuffer::TRIANGLE_ID | AOVBuffer::UV);
+	renderer.render();
+
+	AOVBuffer* aovs = renderer.getAOVBuffer();
+	aovs->save("output/passes");
+
+	// pixels per object, a pass without hits is broken
+	std::vector<int> hits(renderer.getScene()->getObjectList().size(), 0);
+	int total = 0;
+
+	for (int y = 0; y < aovs->getHeight(); y++)
+	{
+		for (int x = 0; x < aovs->getWidth(); x++)
+		{
+			int id = aovs->getObjectID(x, y);
+
+			if (id >= 0 && id < static_cast<int>(hits.size()))
+			{
+				hits[id]++;
+				total++;
+			}
+		}
+	}
+
+	std::cout << "AOV passes: " << aovs->getSize() << " bytes, " << total << " of " << aovs->getWidth() * aovs->getHeight() << " pixels hit (";
+
+	for (unsigned int i = 0; i < hits.size(); i++)
+		std::cout << (i > 0 ? ", " : "") << "object " << i << ": " << hits[i];
+
+	std::cout << ")" << std::endl;
+
+	return total > 0 ? 0 : 1;
+}
+
+
+static int diff(const std::string& first, const std::string& second)
+{
+	Image a, b;
+	a.load(first);
+	b.load(second);
+
+	int maxDelta = 0;
+	int count = a.compare(b, &maxDelta);
+
+	if (count < 0)
+	{
+		std::cout << "Images have different sizes" << std::endl;
+		return 1;
+	}
+
+	std::cout << count << " of " << a.getWidth() * a.getHeight() << " pixels differ";
+	std::cout << " (largest difference " << maxDelta << " of 255)" << std::endl;
+
+	return count > 0 ? 1 : 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string mode = argc > 1 ? argv[1] : "";
+
+	if (mode == "diff")
+	{
+		if (argc < 4)
+		{
+			std::cout << "usage: CGG diff a.ppm b.ppm" << std::endl;
+			return 2;
+		}
+
+		return diff(argv[2], argv[3]);
+	}
+
+	clock_t start, end;
+	start = clock();
+
+	std::cout << "Computer Graphics Guide" << std::endl;
+
+	int result = 0;
+
+	if (mode == "lightmap")
+		result = lightmapParity(argc > 2 ? std::atoi(argv[2]) : 6);
+	else if (mode == "planar")
+		result = planarParity();
+	else if (mode == "numa")
+		numaBenchmark(argc > 2 ? std::atoi(argv[2]) : 0, argc > 3 ? std::atoi(argv[3]) != 0 : true, argc > 4 ? std::atoi(argv[4]) != 0 : true);
+	else if (mode == "denoise")
+		denoisingComparison();
+	else if (mode == "shading")
+		shadingRateComparison();
+	else if (mode == "sequence")
+		result = reprojectionSequence(argc > 2 ? std::atoi(argv[2]) : 5);
+	else if (mode == "crop")
+		result = cropParity();
+	else if (mode == "compress")
+		result = compressionParity();
+	else if (mode == "budget")
+		result = budgetFrames(argc > 2 ? std::atof(argv[2]) : 20.0);
+	else if (mode == "bumpmap")
+		result = bumpMapParity();
+	else if (mode == "whitted")
+		result = whittedComparison(argc > 2 ? std::atoi(argv[2]) : 5);
+	else if (mode == "aov")
+		result = renderAOVs();
+	else if (mode == "2d")
+		render2D(argc > 2 && std::string(argv[2]) == "tessellated");
+	else
+		render3D();
 
 	end = clock();
 
@@ -38,5 +746,5 @@ int main(int argc, char** argv)
 
 	std::cout << "This program took " << time << " seconds" << std::endl;
 
-	return 0;
+	return result;
 }
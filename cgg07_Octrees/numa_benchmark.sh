@@ -0,0 +1,32 @@
+#!/bin/sh
+# NUMA benchmark: pathtraces the same frame with affinity and per node copies
+# of the octrees switched on and off, counted by perf.
+#
+#   ./numa_benchmark.sh [nodes]
+#
+# nodes 0 (default) reads the real topology: node-load-misses are loads served
+# by another node's memory and should drop with affinity and replication.
+# nodes > 0 fakes that many nodes on the usable cores. Memory stays where it
+# is, so misses don't change: this only checks the scheduling (tiles on their
+# own node vs stolen, printed as "NUMA: ...") on a machine with one node.
+#
+# perf needs access to hardware events (i.e. kernel.perf_event_paranoid <= 1).
+#
+# Limitation: no cross-socket numbers have been collected yet. The NUMA work
+# (affinity, first touch, octree copies per node) was only checked on one
+# node with a faked topology, which shows that tiles stay on their node but
+# not what that saves. Run this with nodes 0 on a multi-socket machine before
+# relying on it.
+
+NODES=${1:-0}
+EVENTS=node-loads,node-load-misses,cycles
+
+cd "$(dirname "$0")" || exit 1
+make -s || exit 1
+
+for CONFIG in "0 0" "1 0" "1 1"
+do
+	set -- $CONFIG
+	echo "=== affinity $1, replication $2"
+	perf stat -e $EVENTS ./CGG numa "$NODES" "$1" "$2" 2>&1 | grep -E "NUMA|node-load|cycles|elapsed"
+done